@@ -3,6 +3,41 @@
 layout(location = 0) in vec3 inColor;
 layout(location = 0) out vec4 outColor;
 
+// Specialized pipelines fold the features in when they are created, the uber pipeline reads them for every draw
+layout(constant_id = 0) const bool SPECIALIZED = false;
+layout(constant_id = 1) const uint SPECIALIZED_FEATURES = 0;
+
+const uint FEATURE_VERTEX_COLOR = 1u << 0;
+const uint FEATURE_TONEMAP = 1u << 1;
+const uint FEATURE_DITHER = 1u << 2;
+
+layout(push_constant) uniform PushConstants {
+    uint objectIndex;
+    uint textureIndex;
+    uint samplerIndex;
+    uint features;
+} pushConstants;
+
+const float BAYER[16] = float[](
+     0.0,  8.0,  2.0, 10.0,
+    12.0,  4.0, 14.0,  6.0,
+     3.0, 11.0,  1.0,  9.0,
+    15.0,  7.0, 13.0,  5.0
+);
+
 void main() {
-    outColor = vec4(inColor, 1.0);
-}
\ No newline at end of file
+    uint features = SPECIALIZED ? SPECIALIZED_FEATURES : pushConstants.features;
+
+    vec3 color = (features & FEATURE_VERTEX_COLOR) != 0 ? inColor : vec3(1.0);
+
+    if ((features & FEATURE_TONEMAP) != 0) {
+        color = color / (color + vec3(1.0));
+    }
+
+    if ((features & FEATURE_DITHER) != 0) {
+        ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+        color += (BAYER[pixel.y * 4 + pixel.x] / 16.0 - 0.5) / 255.0;
+    }
+
+    outColor = vec4(color, 1.0);
+}
@@ -5,7 +5,25 @@ layout(location = 1) in vec3 color;
 
 layout(location = 0) out vec3 fragColor;
 
+layout(set = 0, binding = 0) uniform CameraData {
+    mat4 viewProjection;
+} camera;
+
+struct ObjectData {
+    mat4 model;
+};
+
+layout(set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform PushConstants {
+    uint objectIndex;
+} pushConstants;
+
 void main() {
-    gl_Position = vec4(position, 1.0);
+    // Instanced draws of scene instances start at their instance inside the bound object window
+    gl_Position = camera.viewProjection * objects[pushConstants.objectIndex + gl_InstanceIndex].model *
+                  vec4(position, 1.0);
     fragColor = color;
 }
\ No newline at end of file
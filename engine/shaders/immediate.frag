@@ -0,0 +1,30 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+// Sized to the bindless set by the renderer, a single descriptor when descriptor indexing is unavailable
+layout(constant_id = 0) const uint TEXTURE_COUNT = 1;
+layout(constant_id = 1) const uint SAMPLER_COUNT = 1;
+
+layout(set = 1, binding = 0) uniform texture2D textures[TEXTURE_COUNT];
+layout(set = 1, binding = 2) uniform sampler samplers[SAMPLER_COUNT];
+
+layout(push_constant) uniform PushConstants {
+    mat4 transform;
+    uint textureIndex;
+    uint samplerIndex;
+} pushConstants;
+
+void main() {
+    // The indices come from push constants and are uniform across the draw, indexing with them needs
+    // shaderSampledImageArrayDynamicIndexing, which is only enabled together with descriptor indexing. The single
+    // descriptors of the classic set are addressed with constant indices, the branch is resolved at specialization.
+    if (TEXTURE_COUNT > 1 || SAMPLER_COUNT > 1) {
+        outColor = fragColor * texture(sampler2D(textures[pushConstants.textureIndex],
+                                                 samplers[pushConstants.samplerIndex]), fragUv);
+    } else {
+        outColor = fragColor * texture(sampler2D(textures[0], samplers[0]), fragUv);
+    }
+}
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 color;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec4 fragColor;
+
+layout(push_constant) uniform PushConstants {
+    mat4 transform;
+    uint textureIndex;
+    uint samplerIndex;
+} pushConstants;
+
+void main() {
+    gl_Position = pushConstants.transform * vec4(position, 1.0);
+    fragUv = uv;
+    fragColor = color;
+}
@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float falloff = 1.0 - smoothstep(0.5, 1.0, length(fragUv));
+    outColor = vec4(fragColor.rgb, fragColor.a * falloff);
+}
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Read only, writes from the vertex stage would need vertexPipelineStoresAndAtomics
+#define PARTICLE_BUFFER_ACCESS readonly
+#include "particle_common.glsl"
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec4 fragColor;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0)
+);
+
+void main() {
+    Particle particle = particles[drawList[gl_InstanceIndex].index];
+    vec2 corner = CORNERS[gl_VertexIndex];
+
+    // Expanded in clip space so the quad always faces the camera and keeps its world size at any depth
+    vec4 clip = pushConstants.viewProjection * vec4(particle.positionLife.xyz, 1.0);
+    clip.xy += corner * particle.size * pushConstants.projectionScale;
+    gl_Position = clip;
+
+    float age = 1.0 - particle.positionLife.w / particle.velocityLifetime.w;
+    fragColor = mix(unpackUnorm4x8(particle.colorStart), unpackUnorm4x8(particle.colorEnd), age);
+    fragUv = corner;
+}
@@ -0,0 +1,67 @@
+// Declarations shared by all particle shaders, the layouts have to match particle_system.cpp. Shaders that may
+// not write the buffers, like the vertex stage, define PARTICLE_BUFFER_ACCESS as readonly before including this.
+
+#ifndef PARTICLE_BUFFER_ACCESS
+#define PARTICLE_BUFFER_ACCESS
+#endif
+
+struct Particle {
+    // xyz position, w remaining life in seconds
+    vec4 positionLife;
+    // xyz velocity, w total lifetime
+    vec4 velocityLifetime;
+    uint colorStart;
+    uint colorEnd;
+    float size;
+    float padding;
+};
+
+struct DrawEntry {
+    float key;
+    uint index;
+};
+
+layout(std430, set = 0, binding = 0) PARTICLE_BUFFER_ACCESS buffer Particles {
+    Particle particles[];
+};
+
+// Two alive lists of capacity entries each, swapped every frame through pushConstants.parity
+layout(std430, set = 0, binding = 1) PARTICLE_BUFFER_ACCESS buffer AliveLists {
+    uint alive[];
+};
+
+layout(std430, set = 0, binding = 2) PARTICLE_BUFFER_ACCESS buffer DeadList {
+    uint dead[];
+};
+
+// The indirect arguments start at byte 32, 48, 64 and 80, the PARTICLE_*_OFFSET constants of particle_system.cpp
+layout(std430, set = 0, binding = 3) PARTICLE_BUFFER_ACCESS buffer State {
+    uint aliveCount[2];
+    uint deadCount;
+    uint emitCount;
+    uint sortCount;
+    uint padding[3];
+    uvec4 emitDispatch;
+    uvec4 simulateDispatch;
+    uvec4 sortDispatch;
+    uvec4 drawArguments;
+} state;
+
+layout(std430, set = 0, binding = 5) PARTICLE_BUFFER_ACCESS buffer DrawList {
+    DrawEntry drawList[];
+};
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    // xyz gravity, w delta time in seconds
+    vec4 gravity;
+    uint parity;
+    uint seed;
+    uint emitRequested;
+    uint emitterCount;
+    uint sortBlock;
+    uint sortStep;
+    uint capacity;
+    uint padding;
+    vec2 projectionScale;
+} pushConstants;
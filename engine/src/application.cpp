@@ -1,25 +1,66 @@
 #include "application.h"
 #include <iostream>
+#include <future>
+#include <format>
+#include <chrono>
 #include <SDL_vulkan.h>
 
-Application::Application(const char *appName) {
-    if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
-        std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
-        throw std::runtime_error("Failed to initialize SDL");
+Application::Application(const char *appName, const ApplicationConfig &config)
+        : config(config), vulkan(config.renderer) {
+    auto logConfig = config.log;
+    if (auto level = getenv("DARK_STAR_LOG_LEVEL")) {
+        logConfig.level = Logger::parseLevel(level);
     }
+    Logger::get().start(logConfig);
 
-    if (SDL_Vulkan_LoadLibrary(nullptr) < 0) {
-        std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
-        throw std::runtime_error("Failed to initialize SDL");
+    if (config.renderer.headless) {
+        vulkan.initializeInstance(appName, {}, startupTimer);
+        vulkan.initialize(nullptr, startupTimer);
+        return;
     }
 
-    window = SDL_CreateWindow(appName, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 760,
-                              SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_MAXIMIZED);
+    // Only the subsystems the engine uses, initializing joysticks, haptics and audio is a noticeable startup cost
+    startupTimer.time("SDL", [] {
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_TIMER) < 0) {
+            std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
+            throw std::runtime_error("Failed to initialize SDL");
+        }
+
+        if (SDL_Vulkan_LoadLibrary(nullptr) < 0) {
+            std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
+            throw std::runtime_error("Failed to initialize SDL");
+        }
+    });
+
+    // The window has to be created on the main thread, the instance and the physical device are set up meanwhile.
+    // SDL is only called from the main thread, so the extensions it needs are queried before.
+    auto windowExtensions = Vulkan::getWindowInstanceExtensions();
+    auto instanceReady = std::async(std::launch::async, [this, appName, &windowExtensions] {
+        vulkan.initializeInstance(appName, windowExtensions, startupTimer);
+    });
+
+    startupTimer.time("window", [this, appName] {
+        window = SDL_CreateWindow(appName, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 760,
+                                  SDL_WINDOW_VULKAN | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE |
+                                  SDL_WINDOW_MAXIMIZED);
+    });
+    instanceReady.get();
 
-    vulkan.initialize(appName, window);
+    if (window == nullptr) {
+        throw std::runtime_error(std::format("Failed to create window: {}", SDL_GetError()));
+    }
+
+    vulkan.initialize(window, startupTimer);
 }
 
 Application::~Application() {
+    // The renderer's shutdown messages are written synchronously from here on
+    Logger::get().stop();
+
+    if (config.renderer.headless) {
+        return;
+    }
+
     SDL_DestroyWindow(window);
     SDL_Vulkan_UnloadLibrary();
     SDL_Quit();
@@ -28,10 +69,40 @@ Application::~Application() {
 void Application::start() {
     running = true;
 
+    bool firstFrame = true;
+    uint64_t frameCount = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto previousFrame = start;
     while (running) {
-        running = processEvents();
-        vulkan.update();
+        if (!config.renderer.headless) {
+            running = processEvents();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<float> elapsed = now - previousFrame;
+        previousFrame = now;
+
+        vulkan.update(config.fixedDeltaSeconds > 0.0f ? config.fixedDeltaSeconds : elapsed.count());
         vulkan.renderFrame();
+
+        if (firstFrame) {
+            startupTimer.report(startupTimer.getElapsedMilliseconds());
+            firstFrame = false;
+            start = std::chrono::steady_clock::now();
+        }
+
+        ++frameCount;
+        if (config.frameLimit > 0 && frameCount >= config.frameLimit) {
+            running = false;
+        }
+    }
+
+    // The first frame is excluded, it includes the remaining startup work
+    if (config.frameLimit > 0 && frameCount > 1) {
+        std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+        double frameMilliseconds = total.count() / static_cast<double>(frameCount - 1);
+        std::cout << std::format("Frames: {} in {:.1f} ms, {:.3f} ms avg, {:.1f} fps", frameCount - 1, total.count(),
+                                 frameMilliseconds, 1000.0 / frameMilliseconds) << std::endl;
     }
 }
 
@@ -2,16 +2,31 @@
 
 #include <SDL.h>
 #include "renderer/vulkan.h"
+#include "core/startup_timer.h"
+#include "core/log.h"
+
+typedef struct ApplicationConfig {
+    RendererConfig renderer;
+    LogConfig log;
+    // Stops after this many frames, 0 runs until the window is closed
+    uint64_t frameLimit = 0;
+    // Simulation step per frame, 0 uses the measured frame time
+    float fixedDeltaSeconds = 0.0f;
+} ApplicationConfig;
 
 class Application {
 public:
-    explicit Application(const char *appName);
+    explicit Application(const char *appName, const ApplicationConfig &config = {});
     ~Application();
 
     void start();
 
+    Vulkan &getRenderer() { return vulkan; }
+
 protected:
 private:
+    ApplicationConfig config;
+    StartupTimer startupTimer;
     SDL_Window *window = nullptr;
     Vulkan vulkan;
     bool running = false;
@@ -14,6 +14,24 @@ std::vector<char> readBinaryFile(const std::string &fileName) {
     std::vector<char> contents(fileSize);
     file.seekg(0);
     file.read(contents.data(), fileSize);
+    file.close();
+    return contents;
+}
+
+std::vector<char> readBinaryFileRange(const std::string &fileName, size_t offset, size_t size) {
+    std::ifstream file(fileName, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error(std::format("Unable to open file: {}", fileName));
+    }
+
+    std::vector<char> contents(size);
+    file.seekg(offset);
+    file.read(contents.data(), size);
+    if (static_cast<size_t>(file.gcount()) != size) {
+        throw std::runtime_error(std::format("Unexpected end of file: {}", fileName));
+    }
+
     file.close();
     return contents;
 }
\ No newline at end of file
@@ -3,4 +3,6 @@
 #include <string>
 #include <vector>
 
-std::vector<char> readBinaryFile(const std::string &fileName);
\ No newline at end of file
+std::vector<char> readBinaryFile(const std::string &fileName);
+
+std::vector<char> readBinaryFileRange(const std::string &fileName, size_t offset, size_t size);
\ No newline at end of file
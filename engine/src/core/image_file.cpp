@@ -0,0 +1,131 @@
+#include "image_file.h"
+#include <array>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+static constexpr uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+static constexpr uint8_t PNG_COLOR_TYPE_RGBA = 6;
+// Largest payload of an uncompressed deflate block
+static constexpr size_t DEFLATE_STORED_BLOCK_SIZE = 65535;
+
+static constexpr std::array<uint32_t, 256> CRC_TABLE = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+    // Largest run before the sums have to be reduced to stay within 32 bits
+    constexpr size_t ADLER_RUN = 5552;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t run = std::min(size, ADLER_RUN);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+static void appendBigEndian(std::vector<uint8_t> &output, uint32_t value) {
+    output.push_back(value >> 24);
+    output.push_back(value >> 16);
+    output.push_back(value >> 8);
+    output.push_back(value);
+}
+
+static void appendChunk(std::vector<uint8_t> &output, const char *type, const std::vector<uint8_t> &data) {
+    appendBigEndian(output, data.size());
+    size_t typeOffset = output.size();
+    output.insert(output.end(), type, type + 4);
+    output.insert(output.end(), data.begin(), data.end());
+
+    uint32_t crc = updateCrc(0xffffffffu, output.data() + typeOffset, output.size() - typeOffset);
+    appendBigEndian(output, crc ^ 0xffffffffu);
+}
+
+static void writeFile(const std::string &fileName, const uint8_t *data, size_t size) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error(std::format("Unable to open file: {}", fileName));
+    }
+
+    file.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+    if (!file) {
+        throw std::runtime_error(std::format("Unable to write file: {}", fileName));
+    }
+}
+
+void writePngFile(const std::string &fileName, uint32_t width, uint32_t height, const uint8_t *rgba) {
+    // Every row starts with its filter type, 0 leaves the row as it is
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> scanlines((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t *row = scanlines.data() + y * (rowSize + 1);
+        row[0] = 0;
+        std::copy_n(rgba + y * rowSize, rowSize, row + 1);
+    }
+
+    size_t blockCount = std::max<size_t>(1, (scanlines.size() + DEFLATE_STORED_BLOCK_SIZE - 1) /
+                                            DEFLATE_STORED_BLOCK_SIZE);
+    std::vector<uint8_t> imageData;
+    imageData.reserve(2 + blockCount * 5 + scanlines.size() + 4);
+    // zlib header: deflate with a 32 KiB window, no dictionary, the check bits make it a multiple of 31
+    imageData.push_back(0x78);
+    imageData.push_back(0x01);
+    for (size_t offset = 0, block = 0; block < blockCount; ++block) {
+        size_t size = std::min(DEFLATE_STORED_BLOCK_SIZE, scanlines.size() - offset);
+        bool last = block + 1 == blockCount;
+        imageData.push_back(last ? 1 : 0);
+        imageData.push_back(size & 0xff);
+        imageData.push_back(size >> 8);
+        imageData.push_back(~size & 0xff);
+        imageData.push_back((~size >> 8) & 0xff);
+        imageData.insert(imageData.end(), scanlines.begin() + offset, scanlines.begin() + offset + size);
+        offset += size;
+    }
+    appendBigEndian(imageData, adler32(scanlines.data(), scanlines.size()));
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.push_back(8);
+    header.push_back(PNG_COLOR_TYPE_RGBA);
+    // Compression, filter and interlace methods
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    std::vector<uint8_t> output(std::begin(PNG_SIGNATURE), std::end(PNG_SIGNATURE));
+    output.reserve(output.size() + header.size() + imageData.size() + 3 * 12);
+    appendChunk(output, "IHDR", header);
+    appendChunk(output, "IDAT", imageData);
+    appendChunk(output, "IEND", {});
+
+    writeFile(fileName, output.data(), output.size());
+}
+
+void writeRawImageFile(const std::string &fileName, uint32_t width, uint32_t height, const uint8_t *rgba) {
+    writeFile(fileName, rgba, static_cast<size_t>(width) * height * 4);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Writes tightly packed 8 bit RGBA pixels as a PNG. The image data is stored without compression, which keeps
+// encoding cheap enough for capturing every frame at the cost of file size.
+void writePngFile(const std::string &fileName, uint32_t width, uint32_t height, const uint8_t *rgba);
+
+// Writes the pixels as they are, without any header
+void writeRawImageFile(const std::string &fileName, uint32_t width, uint32_t height, const uint8_t *rgba);
@@ -0,0 +1,316 @@
+#include "log.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// Longest time a queued message waits for the writer thread
+static constexpr std::chrono::milliseconds LOG_WRITE_INTERVAL(5);
+
+static constexpr const char *LOG_LEVEL_NAMES[] = {"verbose", "debug", "info", "warning", "error"};
+static constexpr char LOG_LEVEL_TAGS[] = {'V', 'D', 'I', 'W', 'E'};
+
+Logger &Logger::get() {
+    static Logger logger;
+    return logger;
+}
+
+LogLevel Logger::parseLevel(const std::string &name) {
+    for (size_t i = 0; i < std::size(LOG_LEVEL_NAMES); ++i) {
+        if (name == LOG_LEVEL_NAMES[i]) {
+            return static_cast<LogLevel>(i);
+        }
+    }
+
+    throw std::runtime_error(std::format("Unknown log level: {}", name));
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+void Logger::start(const LogConfig &config) {
+    if (running.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    this->config = config;
+    uint64_t capacity = std::bit_ceil(std::max(config.queueCapacity, 2u));
+    entries = std::make_unique<LogEntry[]>(capacity);
+    for (uint64_t i = 0; i < capacity; ++i) {
+        entries[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask = capacity - 1;
+    writePosition.store(0, std::memory_order_relaxed);
+    readPosition = 0;
+    drainedPosition = 0;
+    startTime = std::chrono::steady_clock::now();
+    for (auto &slot: rateLimitSlots) {
+        slot.messageId.store(LOG_NO_MESSAGE_ID, std::memory_order_relaxed);
+        slot.suppressed.store(0, std::memory_order_relaxed);
+    }
+    flushRequested = false;
+    stopRequested = false;
+
+    minimumLevel.store(config.level, std::memory_order_relaxed);
+    running.store(true, std::memory_order_release);
+    writerThread = std::thread(&Logger::writerMain, this);
+}
+
+void Logger::stop() {
+    if (!running.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(writerMutex);
+        stopRequested = true;
+    }
+    writerCondition.notify_one();
+    writerThread.join();
+
+    // Producers which saw running before this store may still be filling an entry, the final drain waits for them so
+    // that messages queued after the writer's last drain are not lost
+    running.store(false, std::memory_order_seq_cst);
+    while (activeProducers.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    drain();
+    summarizeExpired(std::chrono::steady_clock::now(), true);
+    writeOutput();
+    histories.clear();
+
+    auto stats = getStats();
+    if (stats.suppressedMessages > 0 || stats.droppedMessages > 0) {
+        write(LOG_LEVEL_INFO, "log", std::format("{} messages written, {} repeats suppressed, {} dropped on a full "
+                                                 "queue", stats.writtenMessages, stats.suppressedMessages,
+                                                 stats.droppedMessages));
+    }
+}
+
+void Logger::write(LogLevel level, const char *category, std::string_view message, int32_t messageId) {
+    if (!isEnabled(level)) {
+        return;
+    }
+
+    message = message.substr(0, LOG_MESSAGE_CAPACITY);
+
+    // Counted before running is checked again, either stop() waits for this producer or the producer sees it
+    // stopped. Once stopped, producers no longer touch the count and cannot keep stop() waiting.
+    if (running.load(std::memory_order_acquire)) {
+        activeProducers.fetch_add(1, std::memory_order_seq_cst);
+        if (running.load(std::memory_order_seq_cst)) {
+            enqueue(level, category, message, messageId);
+            activeProducers.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        activeProducers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    auto line = formatLine(level, category, message);
+    auto stream = level >= LOG_LEVEL_WARNING ? stderr : stdout;
+    std::lock_guard lock(outputMutex);
+    fwrite(line.data(), 1, line.size(), stream);
+    fflush(stream);
+    writtenMessages.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::enqueue(LogLevel level, const char *category, std::string_view message, int32_t messageId) {
+    auto time = std::chrono::steady_clock::now();
+    if (messageId != LOG_NO_MESSAGE_ID && isRateLimited(messageId, time)) {
+        return;
+    }
+
+    // Bounded queue after Dmitry Vyukov: the sequence of an entry tells producers whether it is free for their
+    // position and the consumer whether it was published
+    LogEntry *entry;
+    uint64_t position = writePosition.load(std::memory_order_relaxed);
+    while (true) {
+        entry = &entries[position & mask];
+        auto sequence = entry->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+        if (difference == 0) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->level = level;
+    entry->category = category;
+    entry->messageId = messageId;
+    entry->time = time;
+    entry->length = message.size();
+    memcpy(entry->message, message.data(), message.size());
+    entry->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::flush() {
+    if (!running.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    auto target = writePosition.load(std::memory_order_acquire);
+    std::unique_lock lock(writerMutex);
+    flushRequested = true;
+    writerCondition.notify_one();
+    drainedCondition.wait(lock, [this, target] {
+        return drainedPosition >= target || !running.load(std::memory_order_acquire);
+    });
+}
+
+LogStats Logger::getStats() const {
+    return {
+            .writtenMessages = writtenMessages.load(std::memory_order_relaxed),
+            .suppressedMessages = suppressedMessages.load(std::memory_order_relaxed),
+            .droppedMessages = droppedMessages.load(std::memory_order_relaxed),
+    };
+}
+
+Logger::RateLimitSlot &Logger::getRateLimitSlot(int32_t messageId) {
+    // Fibonacci hashing, validation message ids are hashes themselves but other ids may be small and sequential
+    return rateLimitSlots[(static_cast<uint32_t>(messageId) * 2654435769u) >> 24];
+}
+
+bool Logger::isRateLimited(int32_t messageId, std::chrono::steady_clock::time_point time) {
+    auto &slot = getRateLimitSlot(messageId);
+    std::chrono::duration<double> elapsed = time - startTime;
+    auto window = static_cast<uint64_t>(elapsed.count() / config.rateLimitSeconds);
+
+    // Producers racing for a new window may each restart the count, which lets a few more messages through
+    if (slot.messageId.load(std::memory_order_relaxed) != messageId ||
+        slot.window.load(std::memory_order_relaxed) != window) {
+        slot.messageId.store(messageId, std::memory_order_relaxed);
+        slot.window.store(window, std::memory_order_relaxed);
+        slot.count.store(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (slot.count.fetch_add(1, std::memory_order_relaxed) < config.rateLimitCount) {
+        return false;
+    }
+
+    slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+    suppressedMessages.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void Logger::writerMain() {
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock lock(writerMutex);
+            writerCondition.wait_for(lock, LOG_WRITE_INTERVAL, [this] { return stopRequested || flushRequested; });
+            stopping = stopRequested;
+            flushRequested = false;
+        }
+
+        drain();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void Logger::drain() {
+    summarizeExpired(std::chrono::steady_clock::now(), false);
+
+    while (true) {
+        auto &entry = entries[readPosition & mask];
+        if (entry.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+            break;
+        }
+
+        process(entry);
+        entry.sequence.store(readPosition + mask + 1, std::memory_order_release);
+        readPosition++;
+    }
+
+    writeOutput();
+
+    {
+        std::lock_guard lock(writerMutex);
+        drainedPosition = readPosition;
+    }
+    drainedCondition.notify_all();
+}
+
+void Logger::process(const LogEntry &entry) {
+    std::string_view message(entry.message, entry.length);
+    if (entry.messageId == LOG_NO_MESSAGE_ID) {
+        append(entry.level, entry.category, message);
+        return;
+    }
+
+    // Repeats of the previous message with the same id, e.g. a validation error hit every frame, are counted
+    // instead of written
+    auto hash = std::hash<std::string_view>()(message);
+    auto [iterator, inserted] = histories.try_emplace(entry.messageId);
+    auto &history = iterator->second;
+    if (inserted) {
+        history.windowStart = entry.time;
+    } else if (hash == history.lastHash) {
+        history.suppressed++;
+        suppressedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    history.lastHash = hash;
+    history.level = entry.level;
+    history.category = entry.category;
+    append(entry.level, entry.category, message);
+}
+
+void Logger::summarizeExpired(std::chrono::steady_clock::time_point now, bool all) {
+    for (auto &[messageId, history]: histories) {
+        std::chrono::duration<double> sinceWindowStart = now - history.windowStart;
+        if (!all && sinceWindowStart.count() < config.rateLimitSeconds) {
+            continue;
+        }
+
+        auto suppressed = history.suppressed;
+        auto &slot = getRateLimitSlot(messageId);
+        if (slot.messageId.load(std::memory_order_relaxed) == messageId) {
+            suppressed += slot.suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (suppressed > 0) {
+            append(history.level, history.category, std::format("{} more messages with id {:#010x} suppressed",
+                                                                suppressed, static_cast<uint32_t>(messageId)));
+        }
+        history.suppressed = 0;
+        history.windowStart = now;
+    }
+}
+
+void Logger::append(LogLevel level, const char *category, std::string_view message) {
+    (level >= LOG_LEVEL_WARNING ? errorOutput : output) += formatLine(level, category, message);
+    writtenMessages.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::writeOutput() {
+    if (output.empty() && errorOutput.empty()) {
+        return;
+    }
+
+    std::lock_guard lock(outputMutex);
+    if (!output.empty()) {
+        fwrite(output.data(), 1, output.size(), stdout);
+        fflush(stdout);
+        output.clear();
+    }
+    if (!errorOutput.empty()) {
+        fwrite(errorOutput.data(), 1, errorOutput.size(), stderr);
+        fflush(stderr);
+        errorOutput.clear();
+    }
+}
+
+std::string Logger::formatLine(LogLevel level, const char *category, std::string_view message) {
+    return std::format("{} [{}] {}\n", LOG_LEVEL_TAGS[level], category, message);
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+enum LogLevel {
+    LOG_LEVEL_VERBOSE,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR
+};
+
+// Lower levels are removed at compile time together with the formatting of their arguments
+#ifdef NDEBUG
+constexpr LogLevel LOG_COMPILED_LEVEL = LOG_LEVEL_INFO;
+#else
+constexpr LogLevel LOG_COMPILED_LEVEL = LOG_LEVEL_VERBOSE;
+#endif
+
+// Messages without an id are neither deduplicated nor rate limited
+constexpr int32_t LOG_NO_MESSAGE_ID = 0;
+
+typedef struct LogConfig {
+    LogLevel level = LOG_LEVEL_INFO;
+    // Queued messages, a power of two. Messages written while the queue is full are dropped and counted.
+    uint32_t queueCapacity = 512;
+    // Messages with the same id beyond this many per window are only counted, the count is written once per window
+    uint32_t rateLimitCount = 5;
+    double rateLimitSeconds = 1.0;
+} LogConfig;
+
+typedef struct LogStats {
+    uint64_t writtenMessages;
+    // Repeats of the previous message with the same id and messages over the rate limit
+    uint64_t suppressedMessages;
+    uint64_t droppedMessages;
+} LogStats;
+
+// Producers on any thread, including driver threads calling the debug messenger, copy their message into a lock
+// free bounded multi producer single consumer queue and return. Messages over the rate limit of their id are
+// rejected before they take a queue entry, so a flood of one message can not crowd out the others. A writer thread
+// drops repeats of the previous message of an id, formats and writes the rest in batches. Before start() and after
+// stop() messages are written synchronously.
+class Logger {
+public:
+    static Logger &get();
+
+    // Accepts the level names in lower case, e.g. "warning"
+    static LogLevel parseLevel(const std::string &name);
+
+    ~Logger();
+
+    void start(const LogConfig &config);
+
+    // Writes out everything queued, including pending repeat summaries
+    void stop();
+
+    bool isEnabled(LogLevel level) const {
+        return level >= LOG_COMPILED_LEVEL && level >= minimumLevel.load(std::memory_order_relaxed);
+    }
+
+    // Messages longer than LOG_MESSAGE_CAPACITY are truncated, category must be a string literal
+    void write(LogLevel level, const char *category, std::string_view message,
+               int32_t messageId = LOG_NO_MESSAGE_ID);
+
+    // Blocks until everything written so far is out, e.g. before an error terminates the process
+    void flush();
+
+    LogStats getStats() const;
+
+private:
+    static constexpr size_t LOG_MESSAGE_CAPACITY = 2048;
+    // Message ids are mapped directly to a slot, ids sharing one reset each other's count
+    static constexpr size_t LOG_RATE_LIMIT_SLOTS = 256;
+
+    typedef struct LogEntry {
+        // Equals the queue position when the entry is free and the position + 1 once it holds a message
+        std::atomic<uint64_t> sequence;
+        LogLevel level;
+        const char *category;
+        int32_t messageId;
+        uint32_t length;
+        std::chrono::steady_clock::time_point time;
+        char message[LOG_MESSAGE_CAPACITY];
+    } LogEntry;
+
+    typedef struct RateLimitSlot {
+        std::atomic<int32_t> messageId;
+        // Index of the rate limit window since start()
+        std::atomic<uint64_t> window;
+        std::atomic<uint32_t> count;
+        // Not written yet in a summary
+        std::atomic<uint64_t> suppressed;
+    } RateLimitSlot;
+
+    typedef struct MessageHistory {
+        std::chrono::steady_clock::time_point windowStart;
+        uint64_t suppressed;
+        size_t lastHash;
+        LogLevel level;
+        const char *category;
+    } MessageHistory;
+
+    LogConfig config;
+    std::atomic<LogLevel> minimumLevel = LOG_LEVEL_INFO;
+    std::atomic<bool> running = false;
+    // Producers between the running check and publishing their entry
+    std::atomic<uint32_t> activeProducers = 0;
+
+    std::unique_ptr<LogEntry[]> entries;
+    uint64_t mask = 0;
+    std::atomic<uint64_t> writePosition = 0;
+    std::atomic<uint64_t> writtenMessages = 0;
+    std::atomic<uint64_t> suppressedMessages = 0;
+    std::atomic<uint64_t> droppedMessages = 0;
+    std::chrono::steady_clock::time_point startTime;
+    std::array<RateLimitSlot, LOG_RATE_LIMIT_SLOTS> rateLimitSlots{};
+
+    // Only touched by the writer thread, or by stop() once it joined
+    uint64_t readPosition = 0;
+    std::unordered_map<int32_t, MessageHistory> histories;
+    std::string output;
+    std::string errorOutput;
+
+    std::thread writerThread;
+    mutable std::mutex writerMutex;
+    std::condition_variable writerCondition;
+    std::condition_variable drainedCondition;
+    uint64_t drainedPosition = 0;
+    bool flushRequested = false;
+    bool stopRequested = false;
+
+    // Serializes the actual writes of the writer thread and of synchronous messages
+    std::mutex outputMutex;
+
+    RateLimitSlot &getRateLimitSlot(int32_t messageId);
+
+    bool isRateLimited(int32_t messageId, std::chrono::steady_clock::time_point time);
+
+    void enqueue(LogLevel level, const char *category, std::string_view message, int32_t messageId);
+
+    void writerMain();
+
+    void drain();
+
+    void process(const LogEntry &entry);
+
+    void summarizeExpired(std::chrono::steady_clock::time_point now, bool all);
+
+    void append(LogLevel level, const char *category, std::string_view message);
+
+    void writeOutput();
+
+    static std::string formatLine(LogLevel level, const char *category, std::string_view message);
+};
+
+template<LogLevel level, typename... Args>
+void logFormatted(const char *category, std::format_string<Args...> format, Args &&...args) {
+    if constexpr (level >= LOG_COMPILED_LEVEL) {
+        auto &logger = Logger::get();
+        if (logger.isEnabled(level)) {
+            logger.write(level, category, std::format(format, std::forward<Args>(args)...));
+        }
+    }
+}
+
+template<typename... Args>
+void logVerbose(const char *category, std::format_string<Args...> format, Args &&...args) {
+    logFormatted<LOG_LEVEL_VERBOSE>(category, format, std::forward<Args>(args)...);
+}
+
+template<typename... Args>
+void logDebug(const char *category, std::format_string<Args...> format, Args &&...args) {
+    logFormatted<LOG_LEVEL_DEBUG>(category, format, std::forward<Args>(args)...);
+}
+
+template<typename... Args>
+void logInfo(const char *category, std::format_string<Args...> format, Args &&...args) {
+    logFormatted<LOG_LEVEL_INFO>(category, format, std::forward<Args>(args)...);
+}
+
+template<typename... Args>
+void logWarning(const char *category, std::format_string<Args...> format, Args &&...args) {
+    logFormatted<LOG_LEVEL_WARNING>(category, format, std::forward<Args>(args)...);
+}
+
+template<typename... Args>
+void logError(const char *category, std::format_string<Args...> format, Args &&...args) {
+    logFormatted<LOG_LEVEL_ERROR>(category, format, std::forward<Args>(args)...);
+}
@@ -0,0 +1,70 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include "file.h"
+
+#if defined(__linux__)
+#define MAPPED_FILE_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::open(const std::string &fileName) {
+    close();
+
+#ifdef MAPPED_FILE_SUPPORTED
+    int descriptor = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        throw std::runtime_error(std::format("Unable to open file: {}", fileName));
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        throw std::runtime_error(std::format("Unable to stat file: {} ({})", fileName, strerror(errno)));
+    }
+
+    // Empty files can not be mapped, they are read like on other platforms
+    if (status.st_size > 0) {
+        auto address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        // The mapping keeps its own reference to the file
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error(std::format("Unable to map file: {} ({})", fileName, strerror(errno)));
+        }
+
+        contents = static_cast<const uint8_t *>(address);
+        length = status.st_size;
+        mapped = true;
+        return;
+    }
+    ::close(descriptor);
+#endif
+
+    fallback = readBinaryFile(fileName);
+    // Keeps an empty file distinguishable from a closed one
+    fallback.reserve(1);
+    contents = reinterpret_cast<const uint8_t *>(fallback.data());
+    length = fallback.size();
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_SUPPORTED
+    if (mapped) {
+        munmap(const_cast<uint8_t *>(contents), length);
+    }
+#endif
+
+    contents = nullptr;
+    length = 0;
+    mapped = false;
+    fallback = {};
+}
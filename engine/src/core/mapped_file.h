@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. Where the platform supports it the file is mapped into memory, so opening it costs
+// the same for any size and pages are only read from disk, or shared from the page cache, once they are touched.
+// Elsewhere the file is read into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    void open(const std::string &fileName);
+
+    void close();
+
+    bool isOpen() const { return contents != nullptr; }
+
+    // Whether the contents are mapped instead of read
+    bool isMapped() const { return mapped; }
+
+    // Page aligned when mapped
+    const uint8_t *data() const { return contents; }
+
+    size_t size() const { return length; }
+
+private:
+    const uint8_t *contents = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<char> fallback;
+};
@@ -0,0 +1,43 @@
+#include "startup_timer.h"
+#include <algorithm>
+#include <format>
+#include <iostream>
+
+StartupTimer::StartupTimer() : start(std::chrono::steady_clock::now()), mainThread(std::this_thread::get_id()) {
+}
+
+void StartupTimer::time(const std::string &phase, const std::function<void()> &function) {
+    double phaseStart = getElapsedMilliseconds();
+    function();
+    double phaseEnd = getElapsedMilliseconds();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    phases.push_back({
+                             .name = phase,
+                             .startMilliseconds = phaseStart,
+                             .durationMilliseconds = phaseEnd - phaseStart,
+                             .mainThread = std::this_thread::get_id() == mainThread,
+                     });
+}
+
+double StartupTimer::getElapsedMilliseconds() const {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void StartupTimer::report(double timeToFirstFrameMilliseconds) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto sorted = phases;
+    std::sort(sorted.begin(), sorted.end(), [](const StartupPhase &a, const StartupPhase &b) {
+        return a.startMilliseconds < b.startMilliseconds;
+    });
+
+    std::cout << "Startup phases:" << std::endl;
+    for (const auto &phase: sorted) {
+        std::cout << std::format("  {:>8.2f} ms +{:>8.2f} ms  {:<6} {}", phase.startMilliseconds,
+                                 phase.durationMilliseconds, phase.mainThread ? "main" : "worker", phase.name)
+                  << std::endl;
+    }
+    std::cout << std::format("Time to first frame: {:.2f} ms", timeToFirstFrameMilliseconds) << std::endl;
+}
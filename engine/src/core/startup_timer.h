@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct StartupPhase {
+    std::string name;
+    // Offsets are relative to the creation of the timer so that phases running on worker threads show their overlap
+    double startMilliseconds;
+    double durationMilliseconds;
+    bool mainThread;
+} StartupPhase;
+
+// Collects the duration of each engine startup phase, phases may be timed concurrently from worker threads
+class StartupTimer {
+public:
+    StartupTimer();
+
+    void time(const std::string &phase, const std::function<void()> &function);
+
+    double getElapsedMilliseconds() const;
+
+    // Prints every phase followed by the total time from the creation of the timer to the first presented frame
+    void report(double timeToFirstFrameMilliseconds) const;
+
+private:
+    std::chrono::steady_clock::time_point start;
+    std::thread::id mainThread;
+    mutable std::mutex mutex;
+    std::vector<StartupPhase> phases;
+};
@@ -0,0 +1,108 @@
+#include "async_compute.h"
+#include <algorithm>
+#include "vulkan.h"
+
+void AsyncCompute::initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                              uint32_t queueFamilyIndex, VkQueue queue, float timestampPeriod,
+                              uint32_t timestampValidBits, uint32_t maxScopesPerFrame) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->queueFamilyIndex = queueFamilyIndex;
+    this->queue = queue;
+
+    VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    createInfo.queueFamilyIndex = queueFamilyIndex;
+    VK_CHECK(vkCreateCommandPool(device, &createInfo, allocationCallbacks, &commandPool))
+
+    VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocateInfo.commandPool = commandPool;
+    allocateInfo.commandBufferCount = commandBuffers.size();
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, commandBuffers.data()))
+
+    computeTimeline = createTimeline();
+    graphicsTimeline = createTimeline();
+
+    profiler.initialize(device, allocationCallbacks, timestampPeriod, timestampValidBits, maxScopesPerFrame);
+}
+
+void AsyncCompute::destroy() {
+    if (!isEnabled()) {
+        return;
+    }
+
+    profiler.destroy();
+    vkDestroySemaphore(device, computeTimeline, allocationCallbacks);
+    vkDestroySemaphore(device, graphicsTimeline, allocationCallbacks);
+    vkDestroyCommandPool(device, commandPool, allocationCallbacks);
+    queue = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frameIndex) {
+    this->frameIndex = frameIndex;
+    auto commandBuffer = commandBuffers[frameIndex];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo))
+
+    profiler.beginFrame(commandBuffer, frameIndex);
+    scope = profiler.beginScope(commandBuffer, ASYNC_COMPUTE_SCOPE);
+    return commandBuffer;
+}
+
+void AsyncCompute::submit(uint64_t frameValue) {
+    auto commandBuffer = commandBuffers[frameIndex];
+    profiler.endScope(commandBuffer, scope);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer))
+
+    uint64_t waitValue = frameValue - 1;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &frameValue;
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &graphicsTimeline;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &computeTimeline;
+
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE))
+}
+
+void AsyncCompute::updateOverlap(const GpuScopeStats *graphicsFrame) {
+    auto compute = profiler.getScope(ASYNC_COMPUTE_SCOPE);
+    if (compute == nullptr || graphicsFrame == nullptr || compute->samples == lastSampleCount) {
+        return;
+    }
+    lastSampleCount = compute->samples;
+
+    // Both queues write timestamps of the same device clock
+    double overlap = std::min(compute->lastEndMilliseconds, graphicsFrame->lastEndMilliseconds) -
+                     std::max(compute->lastBeginMilliseconds, graphicsFrame->lastBeginMilliseconds);
+    stats.frameCount++;
+    stats.computeMilliseconds += compute->lastMilliseconds;
+    stats.overlapMilliseconds += std::clamp(overlap, 0.0, compute->lastMilliseconds);
+}
+
+VkSemaphore AsyncCompute::createTimeline() {
+    VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo createInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    createInfo.pNext = &typeInfo;
+
+    VkSemaphore result;
+    VK_CHECK(vkCreateSemaphore(device, &createInfo, allocationCallbacks, &result))
+    return result;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_types.h"
+#include "gpu_profiler.h"
+
+// Scope around all work of a frame on the compute queue
+constexpr const char *ASYNC_COMPUTE_SCOPE = "async compute";
+
+typedef struct AsyncComputeStats {
+    uint64_t frameCount;
+    // Sums over frameCount frames
+    double computeMilliseconds;
+    double overlapMilliseconds;
+} AsyncComputeStats;
+
+// Records compute work into per-frame command buffers of a queue family without graphics support and orders it
+// against the graphics queue with two timeline semaphores whose values are frame numbers. The compute work of frame N
+// waits until the graphics queue signaled N - 1, i.e. finished reading the previous results, and the graphics work
+// consuming the results waits for compute value N. Everything the graphics queue records before that wait runs in
+// parallel with the compute work.
+class AsyncCompute {
+public:
+    AsyncCompute() = default;
+
+    void initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks, uint32_t queueFamilyIndex,
+                    VkQueue queue, float timestampPeriod, uint32_t timestampValidBits, uint32_t maxScopesPerFrame);
+
+    void destroy();
+
+    bool isEnabled() const { return queue != VK_NULL_HANDLE; }
+
+    uint32_t getQueueFamilyIndex() const { return queueFamilyIndex; }
+
+    // Begins the command buffer of the frame slot, whose previous submission the frame's fence already waited for
+    VkCommandBuffer begin(uint32_t frameIndex);
+
+    // Ends the command buffer and submits it with the timeline value of the frame, which must be above zero
+    void submit(uint64_t frameValue);
+
+    VkSemaphore getComputeTimeline() const { return computeTimeline; }
+
+    // Signaled by the graphics queue with the frame's timeline value once it finished the frame
+    VkSemaphore getGraphicsTimeline() const { return graphicsTimeline; }
+
+    GpuProfiler &getProfiler() { return profiler; }
+
+    const GpuProfiler &getProfiler() const { return profiler; }
+
+    // Compares the last collected compute scope with the graphics frame scope collected in the same frame
+    void updateOverlap(const GpuScopeStats *graphicsFrame);
+
+    const AsyncComputeStats &getStats() const { return stats; }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    uint32_t queueFamilyIndex = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers{};
+    uint32_t frameIndex = 0;
+    uint32_t scope = INVALID_GPU_SCOPE;
+
+    VkSemaphore computeTimeline = VK_NULL_HANDLE;
+    VkSemaphore graphicsTimeline = VK_NULL_HANDLE;
+
+    GpuProfiler profiler;
+    uint64_t lastSampleCount = 0;
+    AsyncComputeStats stats{};
+
+    VkSemaphore createTimeline();
+};
@@ -0,0 +1,93 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+void DynamicResolution::initialize(const DynamicResolutionConfig &config) {
+    if (config.minScale <= 0.0f || config.minScale > config.maxScale || config.maxScale > 1.0f) {
+        throw std::runtime_error(std::format("Invalid dynamic resolution scale bounds: {} - {}", config.minScale,
+                                             config.maxScale));
+    }
+
+    this->config = config;
+    stats = {};
+    stats.scale = config.maxScale;
+    lastSampleCount = 0;
+    framesSinceChange = 0;
+    framesUnderBudget = 0;
+}
+
+void DynamicResolution::update(const GpuScopeStats *frameStats) {
+    if (!config.enabled || frameStats == nullptr || frameStats->samples == lastSampleCount) {
+        return;
+    }
+    lastSampleCount = frameStats->samples;
+
+    double milliseconds = frameStats->lastMilliseconds;
+    stats.smoothedMilliseconds = stats.sampleCount == 0
+                                 ? milliseconds
+                                 : stats.smoothedMilliseconds +
+                                   (milliseconds - stats.smoothedMilliseconds) * config.smoothing;
+    stats.sampleCount++;
+    if (milliseconds <= config.budgetMilliseconds) {
+        stats.withinBudgetCount++;
+    }
+
+    framesSinceChange++;
+    if (framesSinceChange < config.settleFrames) {
+        return;
+    }
+
+    double budget = config.budgetMilliseconds;
+    if (stats.smoothedMilliseconds > budget * (1.0 + config.overBudgetMargin)) {
+        // GPU time follows the pixel count, i.e. the square of the scale. Aims for the middle of the band.
+        double target = budget * (1.0 - config.underBudgetMargin * 0.5);
+        auto scale = static_cast<float>(stats.scale * std::sqrt(target / stats.smoothedMilliseconds));
+        if (stats.scale > config.minScale) {
+            setScale(scale);
+            stats.decreaseCount++;
+        }
+        framesUnderBudget = 0;
+    } else if (stats.smoothedMilliseconds < budget * (1.0 - config.underBudgetMargin)) {
+        framesUnderBudget++;
+        if (framesUnderBudget >= config.increaseFrames && stats.scale < config.maxScale) {
+            setScale(stats.scale + config.increaseStep);
+            stats.increaseCount++;
+            framesUnderBudget = 0;
+        }
+    } else {
+        framesUnderBudget = 0;
+    }
+}
+
+VkExtent2D DynamicResolution::getRenderExtent(VkExtent2D outputExtent) const {
+    // A minimized window has an empty output, which has nothing to scale
+    if (!config.enabled || outputExtent.width == 0 || outputExtent.height == 0) {
+        return outputExtent;
+    }
+
+    auto scaled = [this](uint32_t size) {
+        return std::clamp(static_cast<uint32_t>(std::lround(size * stats.scale)), 1u, size);
+    };
+    return {scaled(outputExtent.width), scaled(outputExtent.height)};
+}
+
+double DynamicResolution::getBudgetAdherence() const {
+    if (stats.sampleCount == 0) {
+        return 1.0;
+    }
+
+    return static_cast<double>(stats.withinBudgetCount) / static_cast<double>(stats.sampleCount);
+}
+
+void DynamicResolution::setScale(float scale) {
+    float previous = stats.scale;
+    stats.scale = std::clamp(scale, config.minScale, config.maxScale);
+    framesSinceChange = 0;
+
+    // The smoothed time still describes the old resolution, predict it for the new one instead of waiting for the
+    // average to catch up, which would trigger a second change
+    double ratio = stats.scale / previous;
+    stats.smoothedMilliseconds *= ratio * ratio;
+}
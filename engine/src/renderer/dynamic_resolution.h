@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_profiler.h"
+
+typedef struct DynamicResolutionConfig {
+    bool enabled = true;
+    // GPU time per frame the controller steers towards
+    float budgetMilliseconds = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // The scale drops once the smoothed GPU time is more than overBudgetMargin above the budget and only rises
+    // again below underBudgetMargin under it, inside the band it stays put
+    float overBudgetMargin = 0.05f;
+    float underBudgetMargin = 0.15f;
+    // Frames after a change before the next one, the measurements lag behind by the frames in flight
+    uint32_t settleFrames = 8;
+    // Consecutive frames below the band before the scale rises by increaseStep
+    uint32_t increaseFrames = 30;
+    float increaseStep = 0.05f;
+    // Weight of the newest sample in the smoothed GPU time
+    float smoothing = 0.2f;
+} DynamicResolutionConfig;
+
+typedef struct DynamicResolutionStats {
+    float scale;
+    double smoothedMilliseconds;
+    uint64_t sampleCount;
+    uint64_t withinBudgetCount;
+    uint64_t decreaseCount;
+    uint64_t increaseCount;
+} DynamicResolutionStats;
+
+// Picks the fraction of the output resolution the scene is rendered at from the measured GPU frame time. Spikes
+// shrink the scale right away in proportion to the overshoot, recovery happens in small steps once the frame time
+// stayed well under budget, so that the scale does not oscillate around the budget.
+class DynamicResolution {
+public:
+    DynamicResolution() = default;
+
+    void initialize(const DynamicResolutionConfig &config);
+
+    bool isEnabled() const { return config.enabled; }
+
+    // For devices that cannot blit the scaled image to the output
+    void disable() { config.enabled = false; }
+
+    // Takes the GPU time of the graphics work of a frame, frames without a new sample are ignored
+    void update(const GpuScopeStats *frameStats);
+
+    // Never larger than the output, the scaled image is rendered into the top left corner of a full size target
+    VkExtent2D getRenderExtent(VkExtent2D outputExtent) const;
+
+    float getScale() const { return stats.scale; }
+
+    float getBudgetMilliseconds() const { return config.budgetMilliseconds; }
+
+    // Fraction of the measured frames that stayed within the budget
+    double getBudgetAdherence() const;
+
+    const DynamicResolutionStats &getStats() const { return stats; }
+
+private:
+    DynamicResolutionConfig config;
+    DynamicResolutionStats stats{};
+    uint64_t lastSampleCount = 0;
+    uint32_t framesSinceChange = 0;
+    uint32_t framesUnderBudget = 0;
+
+    void setScale(float scale);
+};
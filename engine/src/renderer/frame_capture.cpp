@@ -0,0 +1,261 @@
+#include "frame_capture.h"
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include "vulkan.h"
+#include "core/image_file.h"
+
+void FrameCapture::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                              const VkAllocationCallbacks *allocationCallbacks, const FrameCaptureConfig &config) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->config = config;
+
+    // Cached memory turns the encoder's reads into regular memory reads instead of uncached ones over the bus
+    VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+    memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; ++i) {
+        auto flags = deviceMemoryProperties.memoryTypes[i].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        }
+    }
+
+    if (!config.directory.empty()) {
+        std::filesystem::create_directories(config.directory);
+    }
+
+    slots.resize(std::max(config.bufferCount, 1u));
+    for (auto &slot: slots) {
+        slot.state = SLOT_STATE_FREE;
+    }
+
+    workersRunning = true;
+    for (uint32_t i = 0; i < std::max(config.workerCount, 1u); ++i) {
+        workers.emplace_back(&FrameCapture::workerMain, this);
+    }
+}
+
+void FrameCapture::destroy() {
+    poll();
+
+    // The workers drain the encode queue before they stop
+    {
+        std::lock_guard lock(workerMutex);
+        workersRunning = false;
+    }
+    workerCondition.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    for (auto &slot: slots) {
+        if (slot.buffer.buffer != VK_NULL_HANDLE) {
+            destroyBuffer(device, allocationCallbacks, slot.buffer);
+        }
+    }
+    slots.clear();
+}
+
+bool FrameCapture::isFormatSupported(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void FrameCapture::capture(const std::string &fileName, CaptureFormat format) {
+    pendingRequests.push_back({fileName, format, nullptr});
+}
+
+void FrameCapture::capture(CaptureCallback callback) {
+    pendingRequests.push_back({"", CAPTURE_FORMAT_RAW, std::move(callback)});
+}
+
+bool FrameCapture::isRequested() const {
+    return !slots.empty() && (!pendingRequests.empty() || !config.directory.empty());
+}
+
+void FrameCapture::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent,
+                              VkFence fence, uint64_t frameNumber) {
+    bool continuous = !config.directory.empty();
+
+    // Only this thread claims free slots, the workers merely release them
+    CaptureSlot *slot = nullptr;
+    {
+        std::lock_guard lock(workerMutex);
+        auto free = std::find_if(slots.begin(), slots.end(), [](const CaptureSlot &slot) {
+            return slot.state == SLOT_STATE_FREE;
+        });
+        if (free == slots.end()) {
+            // Requested captures are kept for the next frame
+            if (continuous) {
+                stats.droppedFrames++;
+            }
+            return;
+        }
+
+        slot = &*free;
+        slot->state = SLOT_STATE_COPYING;
+        if (firstCopyTime == std::chrono::steady_clock::time_point{}) {
+            firstCopyTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    if (slot->buffer.size < size) {
+        if (slot->buffer.buffer != VK_NULL_HANDLE) {
+            destroyBuffer(device, allocationCallbacks, slot->buffer);
+        }
+        slot->buffer = createBuffer(physicalDevice, device, allocationCallbacks, size,
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties);
+    }
+
+    slot->fence = fence;
+    slot->frameNumber = frameNumber;
+    slot->extent = extent;
+    slot->swizzle = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    slot->continuous = continuous;
+    slot->requests = std::move(pendingRequests);
+    pendingRequests.clear();
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1,
+                           &region);
+
+    VkMemoryBarrier hostBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                         &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+void FrameCapture::poll() {
+    bool queued = false;
+    {
+        std::lock_guard lock(workerMutex);
+        for (uint32_t i = 0; i < slots.size(); ++i) {
+            auto &slot = slots[i];
+            if (slot.state != SLOT_STATE_COPYING || vkGetFenceStatus(device, slot.fence) != VK_SUCCESS) {
+                continue;
+            }
+
+            if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+                VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+                range.memory = slot.buffer.memory;
+                range.size = VK_WHOLE_SIZE;
+                VK_CHECK(vkInvalidateMappedMemoryRanges(device, 1, &range))
+            }
+
+            slot.state = SLOT_STATE_ENCODING;
+            encodeQueue.push_back(i);
+            queued = true;
+        }
+    }
+
+    if (queued) {
+        workerCondition.notify_all();
+    }
+}
+
+FrameCaptureStats FrameCapture::getStats() const {
+    std::lock_guard lock(workerMutex);
+    auto result = stats;
+    if (result.capturedFrames + result.failedFrames > 0) {
+        std::chrono::duration<double> elapsed = lastEncodeTime - firstCopyTime;
+        result.elapsedSeconds = elapsed.count();
+    }
+    return result;
+}
+
+void FrameCapture::workerMain() {
+    while (true) {
+        uint32_t index;
+        {
+            std::unique_lock lock(workerMutex);
+            workerCondition.wait(lock, [this] { return !workersRunning || !encodeQueue.empty(); });
+            if (encodeQueue.empty()) {
+                return;
+            }
+
+            index = encodeQueue.front();
+            encodeQueue.pop_front();
+        }
+
+        auto &slot = slots[index];
+        auto start = std::chrono::steady_clock::now();
+        bool failed = false;
+        try {
+            encode(slot);
+        } catch (const std::exception &e) {
+            std::cerr << "Frame capture failed: " << e.what() << std::endl;
+            failed = true;
+        }
+        auto end = std::chrono::steady_clock::now();
+        slot.requests.clear();
+
+        std::lock_guard lock(workerMutex);
+        if (failed) {
+            stats.failedFrames++;
+        } else {
+            std::chrono::duration<double, std::milli> encodeTime = end - start;
+            stats.capturedFrames++;
+            stats.encodeMilliseconds += encodeTime.count();
+        }
+        lastEncodeTime = std::max(lastEncodeTime, end);
+        slot.state = SLOT_STATE_FREE;
+    }
+}
+
+void FrameCapture::encode(CaptureSlot &slot) {
+    auto width = slot.extent.width;
+    auto height = slot.extent.height;
+    auto pixels = static_cast<uint8_t *>(slot.buffer.mapped);
+
+    // Converted in place, the buffer is overwritten by its next copy anyway. Presentation ignores alpha, so it is
+    // forced to opaque instead of keeping whatever the passes left in it.
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        auto pixel = pixels + i * 4;
+        if (slot.swizzle) {
+            std::swap(pixel[0], pixel[2]);
+        }
+        pixel[3] = 255;
+    }
+
+    auto write = [width, height, pixels](const std::string &fileName, CaptureFormat format) {
+        if (format == CAPTURE_FORMAT_PNG) {
+            writePngFile(fileName, width, height, pixels);
+        } else {
+            writeRawImageFile(fileName, width, height, pixels);
+        }
+    };
+
+    if (slot.continuous) {
+        auto name = config.format == CAPTURE_FORMAT_PNG
+                    ? std::format("frame_{:06}.png", slot.frameNumber)
+                    : std::format("frame_{:06}_{}x{}.rgba", slot.frameNumber, width, height);
+        write((std::filesystem::path(config.directory) / name).string(), config.format);
+    }
+
+    CapturedImage image{slot.frameNumber, width, height, pixels};
+    for (const auto &request: slot.requests) {
+        if (request.callback) {
+            request.callback(image);
+        } else {
+            write(request.fileName, request.format);
+        }
+    }
+}
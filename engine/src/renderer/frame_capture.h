@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_buffer.h"
+
+enum CaptureFormat {
+    CAPTURE_FORMAT_PNG,
+    // Tightly packed 8 bit RGBA without a header, the size is part of the file name
+    CAPTURE_FORMAT_RAW
+};
+
+typedef struct FrameCaptureConfig {
+    // Captures every frame into this directory, e.g. for video capture. Empty only captures requested frames.
+    std::string directory;
+    CaptureFormat format = CAPTURE_FORMAT_PNG;
+    // Frames in flight between the copy and the end of encoding, further continuous captures are dropped
+    uint32_t bufferCount = 4;
+    uint32_t workerCount = 2;
+} FrameCaptureConfig;
+
+typedef struct CapturedImage {
+    uint64_t frameNumber;
+    uint32_t width;
+    uint32_t height;
+    // Tightly packed 8 bit RGBA, only valid during the callback
+    const uint8_t *rgba;
+} CapturedImage;
+
+// Runs on an encoder thread
+typedef std::function<void(const CapturedImage &image)> CaptureCallback;
+
+typedef struct FrameCaptureStats {
+    uint64_t capturedFrames;
+    uint64_t droppedFrames;
+    uint64_t failedFrames;
+    // Sum over capturedFrames
+    double encodeMilliseconds;
+    // From the first copy to the end of the last encoding
+    double elapsedSeconds;
+} FrameCaptureStats;
+
+// Reads rendered frames back without stalling the render loop. The copy of a frame's image into one of a ring of
+// host cached buffers is recorded into the frame's command buffer and tracked through the frame's fence, finished
+// copies are handed to encoder threads which convert, write or pass the pixels to a callback and free the buffer.
+class FrameCapture {
+public:
+    FrameCapture() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    const FrameCaptureConfig &config);
+
+    // Finishes the pending encodings, the device must be idle
+    void destroy();
+
+    static bool isFormatSupported(VkFormat format);
+
+    // Captures the next rendered frame into a file
+    void capture(const std::string &fileName, CaptureFormat format);
+
+    void capture(CaptureCallback callback);
+
+    // Whether the next frame has to record a copy
+    bool isRequested() const;
+
+    // The image must be in TRANSFER_SRC_OPTIMAL, fence is signaled by the submission of commandBuffer
+    void recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, VkFence fence,
+                    uint64_t frameNumber);
+
+    // Hands finished copies to the encoders, must run before the fences of the copies are reset
+    void poll();
+
+    FrameCaptureStats getStats() const;
+
+private:
+    typedef struct CaptureRequest {
+        std::string fileName;
+        CaptureFormat format;
+        CaptureCallback callback;
+    } CaptureRequest;
+
+    enum SlotState {
+        SLOT_STATE_FREE,
+        SLOT_STATE_COPYING,
+        SLOT_STATE_ENCODING
+    };
+
+    typedef struct CaptureSlot {
+        Buffer buffer;
+        SlotState state;
+        VkFence fence;
+        uint64_t frameNumber;
+        VkExtent2D extent;
+        bool swizzle;
+        bool continuous;
+        std::vector<CaptureRequest> requests;
+    } CaptureSlot;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    FrameCaptureConfig config;
+    VkMemoryPropertyFlags memoryProperties = 0;
+
+    std::vector<CaptureRequest> pendingRequests;
+    std::vector<CaptureSlot> slots;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex workerMutex;
+    std::condition_variable workerCondition;
+    // Slot indices whose copy finished
+    std::deque<uint32_t> encodeQueue;
+    bool workersRunning = false;
+
+    FrameCaptureStats stats{};
+    std::chrono::steady_clock::time_point firstCopyTime;
+    std::chrono::steady_clock::time_point lastEncodeTime;
+
+    void workerMain();
+
+    void encode(CaptureSlot &slot);
+};
@@ -0,0 +1,99 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <numeric>
+#include <stdexcept>
+
+// Empty border around every glyph so that linear filtering never picks up a neighbour
+static constexpr uint32_t GLYPH_PADDING = 1;
+static constexpr uint32_t INITIAL_ATLAS_SIZE = 256;
+
+typedef struct GlyphPlacement {
+    uint32_t x;
+    uint32_t y;
+} GlyphPlacement;
+
+static bool packShelves(const std::vector<GlyphBitmap> &bitmaps, const std::vector<size_t> &order, uint32_t width,
+                        uint32_t height, std::vector<GlyphPlacement> &placements) {
+    uint32_t shelfX = GLYPH_PADDING;
+    uint32_t shelfY = GLYPH_PADDING;
+    uint32_t shelfHeight = 0;
+
+    for (auto index: order) {
+        const auto &bitmap = bitmaps[index];
+        if (bitmap.width + 2 * GLYPH_PADDING > width) {
+            return false;
+        }
+
+        if (shelfX + bitmap.width + GLYPH_PADDING > width) {
+            shelfY += shelfHeight + GLYPH_PADDING;
+            shelfX = GLYPH_PADDING;
+            shelfHeight = 0;
+        }
+
+        if (shelfY + bitmap.height + GLYPH_PADDING > height) {
+            return false;
+        }
+
+        placements[index] = {shelfX, shelfY};
+        shelfX += bitmap.width + GLYPH_PADDING;
+        shelfHeight = std::max(shelfHeight, bitmap.height);
+    }
+
+    return true;
+}
+
+GlyphAtlas packGlyphAtlas(const std::vector<GlyphBitmap> &bitmaps, float lineHeight, uint32_t maxSize) {
+    std::vector<size_t> order(bitmaps.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&bitmaps](size_t a, size_t b) {
+        return bitmaps[a].height > bitmaps[b].height;
+    });
+
+    uint32_t width = INITIAL_ATLAS_SIZE;
+    uint32_t height = INITIAL_ATLAS_SIZE;
+    std::vector<GlyphPlacement> placements(bitmaps.size());
+    while (!packShelves(bitmaps, order, width, height, placements)) {
+        if (width >= maxSize && height >= maxSize) {
+            throw std::runtime_error(std::format("{} glyphs do not fit into a {}x{} atlas", bitmaps.size(),
+                                                 maxSize, maxSize));
+        }
+
+        if (height < width) {
+            height *= 2;
+        } else {
+            width *= 2;
+        }
+    }
+
+    GlyphAtlas atlas{};
+    atlas.width = width;
+    atlas.height = height;
+    atlas.lineHeight = lineHeight;
+    atlas.pixels.resize(static_cast<size_t>(width) * height);
+
+    for (size_t i = 0; i < bitmaps.size(); ++i) {
+        const auto &bitmap = bitmaps[i];
+        const auto &placement = placements[i];
+        if (bitmap.coverage.size() < static_cast<size_t>(bitmap.width) * bitmap.height) {
+            throw std::runtime_error(std::format("Glyph {} has less coverage data than its size", bitmap.codepoint));
+        }
+
+        for (uint32_t row = 0; row < bitmap.height; ++row) {
+            memcpy(&atlas.pixels[static_cast<size_t>(placement.y + row) * width + placement.x],
+                   &bitmap.coverage[static_cast<size_t>(row) * bitmap.width], bitmap.width);
+        }
+
+        atlas.glyphs[bitmap.codepoint] = {
+                .uvMin = glm::vec2(placement.x, placement.y) / glm::vec2(width, height),
+                .uvMax = glm::vec2(placement.x + bitmap.width, placement.y + bitmap.height) /
+                         glm::vec2(width, height),
+                .size = glm::vec2(bitmap.width, bitmap.height),
+                .offset = bitmap.offset,
+                .advance = bitmap.advance,
+        };
+    }
+
+    return atlas;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/vec2.hpp>
+
+// Coverage bitmap of a single glyph, rasterized by the caller, for example with stb_truetype or FreeType
+typedef struct GlyphBitmap {
+    uint32_t codepoint;
+    uint32_t width;
+    uint32_t height;
+    // Offset of the bitmap's top left corner from the pen position on the baseline, in pixels
+    glm::vec2 offset;
+    float advance;
+    std::vector<uint8_t> coverage;
+} GlyphBitmap;
+
+typedef struct Glyph {
+    glm::vec2 uvMin;
+    glm::vec2 uvMax;
+    glm::vec2 size;
+    glm::vec2 offset;
+    float advance;
+} Glyph;
+
+// Single channel coverage atlas, uploaded as R8_UNORM and sampled as white with the coverage in alpha
+typedef struct GlyphAtlas {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+    std::unordered_map<uint32_t, Glyph> glyphs;
+    float lineHeight;
+} GlyphAtlas;
+
+// Shelf packs the bitmaps tallest first, starting at 256x256 and doubling the smaller side until everything fits
+GlyphAtlas packGlyphAtlas(const std::vector<GlyphBitmap> &bitmaps, float lineHeight, uint32_t maxSize = 4096);
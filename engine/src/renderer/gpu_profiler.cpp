@@ -0,0 +1,100 @@
+#include "gpu_profiler.h"
+#include <stdexcept>
+
+void GpuProfiler::initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                             float timestampPeriod, uint32_t timestampValidBits, uint32_t maxScopesPerFrame) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->maxScopesPerFrame = maxScopesPerFrame;
+
+    if (timestampValidBits == 0 || timestampPeriod == 0.0f) {
+        return;
+    }
+
+    nanosecondsPerTick = timestampPeriod;
+    timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+
+    VkQueryPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = maxScopesPerFrame * 2 * MAX_FRAMES_IN_FLIGHT;
+    if (vkCreateQueryPool(device, &createInfo, allocationCallbacks, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool");
+    }
+}
+
+void GpuProfiler::destroy() {
+    vkDestroyQueryPool(device, queryPool, allocationCallbacks);
+    queryPool = VK_NULL_HANDLE;
+    for (auto &scopes: frameScopes) {
+        scopes.clear();
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    this->frameIndex = frameIndex;
+    uint32_t firstQuery = frameIndex * maxScopesPerFrame * 2;
+    auto &scopes = frameScopes[frameIndex];
+
+    if (!scopes.empty()) {
+        std::vector<uint64_t> timestamps(scopes.size() * 2);
+        auto result = vkGetQueryPoolResults(device, queryPool, firstQuery, timestamps.size(),
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            for (const auto &scope: scopes) {
+                uint32_t index = scope.firstQuery - firstQuery;
+                uint64_t ticks = (timestamps[index + 1] - timestamps[index]) & timestampMask;
+                double milliseconds = ticks * nanosecondsPerTick / 1000000.0;
+
+                auto &scopeStats = stats[scope.name];
+                scopeStats.samples++;
+                scopeStats.totalMilliseconds += milliseconds;
+                scopeStats.lastMilliseconds = milliseconds;
+                scopeStats.lastBeginMilliseconds =
+                        (timestamps[index] & timestampMask) * nanosecondsPerTick / 1000000.0;
+                scopeStats.lastEndMilliseconds = scopeStats.lastBeginMilliseconds + milliseconds;
+            }
+        }
+        scopes.clear();
+    }
+
+    vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, maxScopesPerFrame * 2);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string &name,
+                                 VkPipelineStageFlagBits stage) {
+    auto &scopes = frameScopes[frameIndex];
+    if (!isEnabled() || scopes.size() >= maxScopesPerFrame) {
+        return INVALID_GPU_SCOPE;
+    }
+
+    uint32_t scope = scopes.size();
+    uint32_t firstQuery = (frameIndex * maxScopesPerFrame + scope) * 2;
+    scopes.push_back({.name = name, .firstQuery = firstQuery});
+    vkCmdWriteTimestamp(commandBuffer, stage, queryPool, firstQuery);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == INVALID_GPU_SCOPE) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                        frameScopes[frameIndex][scope].firstQuery + 1);
+}
+
+const GpuScopeStats *GpuProfiler::getScope(const std::string &name) const {
+    auto scope = stats.find(name);
+    return scope != stats.end() ? &scope->second : nullptr;
+}
+
+double GpuProfiler::getAverageMilliseconds(const std::string &name) const {
+    auto scope = getScope(name);
+    return scope != nullptr && scope->samples > 0 ? scope->totalMilliseconds / scope->samples : 0.0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_types.h"
+
+constexpr uint32_t INVALID_GPU_SCOPE = UINT32_MAX;
+
+typedef struct GpuScopeStats {
+    uint64_t samples;
+    double totalMilliseconds;
+    double lastMilliseconds;
+    // Device clock at the start and end of the last sample, comparable between the queues of a device
+    double lastBeginMilliseconds;
+    double lastEndMilliseconds;
+} GpuScopeStats;
+
+// Measures the GPU time of command buffer ranges with timestamp queries. Every frame in flight owns a slice of the
+// query pool, which is read back when the same frame slot is recorded again and its fence has been waited for.
+class GpuProfiler {
+public:
+    GpuProfiler() = default;
+
+    // Stays disabled when the queue does not support timestamps
+    void initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks, float timestampPeriod,
+                    uint32_t timestampValidBits, uint32_t maxScopesPerFrame);
+
+    void destroy();
+
+    bool isEnabled() const { return queryPool != VK_NULL_HANDLE; }
+
+    // Collects the results of the previous use of the frame slot and resets its queries, must be recorded outside
+    // of a render pass
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    // The start is taken once earlier commands reached stage, a later stage than the top of the pipe also waits for
+    // the semaphore waits of the batch that block it
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string &name,
+                        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    const GpuScopeStats *getScope(const std::string &name) const;
+
+    double getAverageMilliseconds(const std::string &name) const;
+
+private:
+    typedef struct Scope {
+        std::string name;
+        uint32_t firstQuery;
+    } Scope;
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    double nanosecondsPerTick = 0.0;
+    uint64_t timestampMask = 0;
+    uint32_t maxScopesPerFrame = 0;
+    uint32_t frameIndex = 0;
+
+    std::array<std::vector<Scope>, MAX_FRAMES_IN_FLIGHT> frameScopes;
+    std::unordered_map<std::string, GpuScopeStats> stats;
+};
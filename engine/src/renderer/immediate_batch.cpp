@@ -0,0 +1,196 @@
+#include "immediate_batch.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/common.hpp>
+
+// layer:16 | space:1 | topology:1 | texture:32, sorted from the most significant bits
+static uint64_t makeKey(uint16_t layer, ImmediateSpace space, ImmediateTopology topology, uint32_t texture) {
+    return static_cast<uint64_t>(layer) << 34 | static_cast<uint64_t>(space) << 33 |
+           static_cast<uint64_t>(topology) << 32 | texture;
+}
+
+static uint32_t decodeUtf8(std::string_view text, size_t &position) {
+    auto lead = static_cast<uint8_t>(text[position++]);
+    uint32_t length = lead < 0x80 ? 0 : lead < 0xe0 ? 1 : lead < 0xf0 ? 2 : 3;
+    uint32_t codepoint = length == 0 ? lead : lead & (0x3f >> length);
+
+    for (uint32_t i = 0; i < length && position < text.size(); ++i) {
+        codepoint = codepoint << 6 | (static_cast<uint8_t>(text[position++]) & 0x3f);
+    }
+
+    return codepoint;
+}
+
+uint32_t packColor(const glm::vec4 &color) {
+    auto bytes = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return packColor(static_cast<uint8_t>(bytes.r), static_cast<uint8_t>(bytes.g), static_cast<uint8_t>(bytes.b),
+                     static_cast<uint8_t>(bytes.a));
+}
+
+void ImmediateBatch::line(const glm::vec3 &from, const glm::vec3 &to, uint32_t color) {
+    auto vertex = append(IMMEDIATE_SPACE_WORLD, IMMEDIATE_TOPOLOGY_LINES, IMMEDIATE_TEXTURE_WHITE, 2);
+    vertex[0] = {from, glm::vec2(0.0f), color};
+    vertex[1] = {to, glm::vec2(0.0f), color};
+}
+
+void ImmediateBatch::box(const glm::vec3 &min, const glm::vec3 &max, uint32_t color) {
+    glm::vec3 corners[8];
+    for (uint32_t i = 0; i < 8; ++i) {
+        corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    }
+
+    // Corner indices differ in exactly one bit along every edge
+    static constexpr uint8_t edges[12][2] = {
+            {0, 1}, {2, 3}, {4, 5}, {6, 7},
+            {0, 2}, {1, 3}, {4, 6}, {5, 7},
+            {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    };
+
+    auto vertex = append(IMMEDIATE_SPACE_WORLD, IMMEDIATE_TOPOLOGY_LINES, IMMEDIATE_TEXTURE_WHITE, 24);
+    for (const auto &edge: edges) {
+        *vertex++ = {corners[edge[0]], glm::vec2(0.0f), color};
+        *vertex++ = {corners[edge[1]], glm::vec2(0.0f), color};
+    }
+}
+
+void ImmediateBatch::line2D(const glm::vec2 &from, const glm::vec2 &to, uint32_t color) {
+    auto vertex = append(IMMEDIATE_SPACE_SCREEN, IMMEDIATE_TOPOLOGY_LINES, IMMEDIATE_TEXTURE_WHITE, 2);
+    vertex[0] = {glm::vec3(from, 0.0f), glm::vec2(0.0f), color};
+    vertex[1] = {glm::vec3(to, 0.0f), glm::vec2(0.0f), color};
+}
+
+void ImmediateBatch::rect(const glm::vec2 &min, const glm::vec2 &max, uint32_t color) {
+    quad(IMMEDIATE_SPACE_SCREEN, IMMEDIATE_TEXTURE_WHITE, min, max, glm::vec2(0.0f), glm::vec2(1.0f), color);
+}
+
+void ImmediateBatch::sprite(const glm::vec2 &min, const glm::vec2 &max, uint32_t texture, uint32_t color,
+                            const glm::vec2 &uvMin, const glm::vec2 &uvMax) {
+    quad(IMMEDIATE_SPACE_SCREEN, texture, min, max, uvMin, uvMax, color);
+}
+
+glm::vec2 ImmediateBatch::text(const glm::vec2 &position, std::string_view text, uint32_t color, float scale) {
+    glm::vec2 pen = position;
+    if (font == nullptr) {
+        return pen;
+    }
+
+    size_t offset = 0;
+    while (offset < text.size()) {
+        uint32_t codepoint = decodeUtf8(text, offset);
+        if (codepoint == '\n') {
+            pen = glm::vec2(position.x, pen.y + font->lineHeight * scale);
+            continue;
+        }
+
+        auto glyph = font->glyphs.find(codepoint);
+        if (glyph == font->glyphs.end()) {
+            continue;
+        }
+
+        const auto &metrics = glyph->second;
+        if (metrics.size.x > 0.0f && metrics.size.y > 0.0f) {
+            glm::vec2 min = pen + metrics.offset * scale;
+            quad(IMMEDIATE_SPACE_SCREEN, IMMEDIATE_TEXTURE_FONT, min, min + metrics.size * scale, metrics.uvMin,
+                 metrics.uvMax, color);
+        }
+        pen.x += metrics.advance * scale;
+    }
+
+    return pen;
+}
+
+void ImmediateBatch::build(ImmediateVertex *destination, uint32_t vertexCapacity, uint32_t maxQuadsPerDraw,
+                           std::vector<ImmediateDraw> &draws) {
+    sortedRuns = runs;
+    std::stable_sort(sortedRuns.begin(), sortedRuns.end(), [](const Run &a, const Run &b) {
+        return a.key < b.key;
+    });
+
+    uint32_t written = 0;
+    uint64_t previousKey = UINT64_MAX;
+    size_t firstDraw = draws.size();
+    for (const auto &run: sortedRuns) {
+        auto topology = static_cast<ImmediateTopology>(run.key >> 32 & 1);
+        uint32_t count = run.vertexCount;
+
+        // Only whole primitives are copied when the ring runs out of space
+        if (written + count > vertexCapacity) {
+            uint32_t primitiveSize = topology == IMMEDIATE_TOPOLOGY_QUADS ? 4 : 2;
+            count = (vertexCapacity - written) / primitiveSize * primitiveSize;
+            stats.droppedVertices += run.vertexCount - count;
+        }
+
+        if (count == 0) {
+            continue;
+        }
+
+        memcpy(destination + written, vertices.data() + run.firstVertex, count * sizeof(ImmediateVertex));
+
+        bool extendsDraw = run.key == previousKey && draws.size() > firstDraw;
+        if (extendsDraw && topology == IMMEDIATE_TOPOLOGY_QUADS) {
+            extendsDraw = (draws.back().vertexCount + count) / 4 <= maxQuadsPerDraw;
+        }
+
+        if (extendsDraw) {
+            draws.back().vertexCount += count;
+        } else {
+            draws.push_back({
+                                    .space = static_cast<ImmediateSpace>(run.key >> 33 & 1),
+                                    .topology = topology,
+                                    .texture = static_cast<uint32_t>(run.key),
+                                    .firstVertex = written,
+                                    .vertexCount = count,
+                            });
+        }
+
+        // A run larger than one draw's index range continues in further draws
+        while (topology == IMMEDIATE_TOPOLOGY_QUADS && draws.back().vertexCount / 4 > maxQuadsPerDraw) {
+            auto overflow = draws.back();
+            draws.back().vertexCount = maxQuadsPerDraw * 4;
+            overflow.firstVertex += maxQuadsPerDraw * 4;
+            overflow.vertexCount -= maxQuadsPerDraw * 4;
+            draws.push_back(overflow);
+        }
+
+        written += count;
+        previousKey = run.key;
+    }
+
+    stats.vertices += written;
+    stats.runs += runs.size();
+    stats.draws += draws.size() - firstDraw;
+}
+
+void ImmediateBatch::clear() {
+    vertexCount = 0;
+    runs.clear();
+}
+
+ImmediateVertex *ImmediateBatch::append(ImmediateSpace space, ImmediateTopology topology, uint32_t texture,
+                                        uint32_t count) {
+    uint64_t key = makeKey(layer, space, topology, texture);
+    if (!runs.empty() && runs.back().key == key) {
+        runs.back().vertexCount += count;
+    } else {
+        runs.push_back({.key = key, .firstVertex = vertexCount, .vertexCount = count});
+    }
+
+    // Grown without shrinking so that steady state frames never touch the allocator
+    if (vertexCount + count > vertices.size()) {
+        vertices.resize(std::max<size_t>(vertices.size() * 2, vertexCount + count));
+    }
+
+    auto result = vertices.data() + vertexCount;
+    vertexCount += count;
+    stats.primitives++;
+    return result;
+}
+
+void ImmediateBatch::quad(ImmediateSpace space, uint32_t texture, const glm::vec2 &min, const glm::vec2 &max,
+                          const glm::vec2 &uvMin, const glm::vec2 &uvMax, uint32_t color) {
+    auto vertex = append(space, IMMEDIATE_TOPOLOGY_QUADS, texture, 4);
+    vertex[0] = {glm::vec3(min.x, min.y, 0.0f), glm::vec2(uvMin.x, uvMin.y), color};
+    vertex[1] = {glm::vec3(max.x, min.y, 0.0f), glm::vec2(uvMax.x, uvMin.y), color};
+    vertex[2] = {glm::vec3(max.x, max.y, 0.0f), glm::vec2(uvMax.x, uvMax.y), color};
+    vertex[3] = {glm::vec3(min.x, max.y, 0.0f), glm::vec2(uvMin.x, uvMax.y), color};
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "glyph_atlas.h"
+
+// Placeholder textures, resolved by the ImmediateRenderer to its own white texture and font atlas. Any other value
+// is a bindless sampled image handle, draws with INVALID_BINDLESS_HANDLE (UINT32_MAX) are skipped.
+constexpr uint32_t IMMEDIATE_TEXTURE_WHITE = UINT32_MAX - 1;
+constexpr uint32_t IMMEDIATE_TEXTURE_FONT = UINT32_MAX - 2;
+
+typedef struct ImmediateVertex {
+    glm::vec3 position;
+    glm::vec2 uv;
+    // R8G8B8A8_UNORM, see packColor()
+    uint32_t color;
+} ImmediateVertex;
+
+enum ImmediateSpace {
+    // Transformed by the camera
+    IMMEDIATE_SPACE_WORLD = 0,
+    // Pixels with the origin in the top left corner
+    IMMEDIATE_SPACE_SCREEN = 1
+};
+
+enum ImmediateTopology {
+    IMMEDIATE_TOPOLOGY_LINES = 0,
+    // Four vertices per quad, drawn with a shared index buffer
+    IMMEDIATE_TOPOLOGY_QUADS = 1
+};
+
+typedef struct ImmediateDraw {
+    ImmediateSpace space;
+    ImmediateTopology topology;
+    uint32_t texture;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+} ImmediateDraw;
+
+typedef struct ImmediateBatchStats {
+    uint64_t primitives;
+    uint64_t vertices;
+    uint64_t runs;
+    uint64_t draws;
+    uint64_t droppedVertices;
+} ImmediateBatchStats;
+
+constexpr uint32_t packColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+    return r | (g << 8) | (b << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+uint32_t packColor(const glm::vec4 &color);
+
+// Collects debug lines, rectangles, sprites and text for one frame without touching the GPU. Consecutive
+// primitives with the same layer, space, topology and texture extend the same run, build() stably sorts the runs
+// by that key and merges them, so the number of draws depends on the number of distinct keys rather than on the
+// number of primitives. Within a layer the order between different textures is not preserved, anything that has
+// to stay on top goes into a higher layer.
+class ImmediateBatch {
+public:
+    ImmediateBatch() = default;
+
+    void setLayer(uint16_t layer) { this->layer = layer; }
+
+    void setFont(const GlyphAtlas *font) { this->font = font; }
+
+    void line(const glm::vec3 &from, const glm::vec3 &to, uint32_t color);
+
+    void box(const glm::vec3 &min, const glm::vec3 &max, uint32_t color);
+
+    void line2D(const glm::vec2 &from, const glm::vec2 &to, uint32_t color);
+
+    void rect(const glm::vec2 &min, const glm::vec2 &max, uint32_t color);
+
+    void sprite(const glm::vec2 &min, const glm::vec2 &max, uint32_t texture, uint32_t color,
+                const glm::vec2 &uvMin = glm::vec2(0.0f), const glm::vec2 &uvMax = glm::vec2(1.0f));
+
+    // Draws UTF-8 text with the font set through setFont(), returns the pen position after the last glyph
+    glm::vec2 text(const glm::vec2 &position, std::string_view text, uint32_t color, float scale = 1.0f);
+
+    // Writes the vertices of all runs in sorted order to destination and appends the merged draws. Quad draws are
+    // split after maxQuadsPerDraw quads, the size of the shared index buffer. Whatever exceeds vertexCapacity is
+    // dropped and counted in the stats.
+    void build(ImmediateVertex *destination, uint32_t vertexCapacity, uint32_t maxQuadsPerDraw,
+               std::vector<ImmediateDraw> &draws);
+
+    void clear();
+
+    uint32_t getVertexCount() const { return vertexCount; }
+
+    const ImmediateBatchStats &getStats() const { return stats; }
+
+private:
+    typedef struct Run {
+        uint64_t key;
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+    } Run;
+
+    std::vector<ImmediateVertex> vertices;
+    uint32_t vertexCount = 0;
+    std::vector<Run> runs;
+    std::vector<Run> sortedRuns;
+    uint16_t layer = 0;
+    const GlyphAtlas *font = nullptr;
+    ImmediateBatchStats stats{};
+
+    ImmediateVertex *append(ImmediateSpace space, ImmediateTopology topology, uint32_t texture, uint32_t count);
+
+    void quad(ImmediateSpace space, uint32_t texture, const glm::vec2 &min, const glm::vec2 &max,
+              const glm::vec2 &uvMin, const glm::vec2 &uvMax, uint32_t color);
+};
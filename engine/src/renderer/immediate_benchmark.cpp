@@ -0,0 +1,128 @@
+#include "immediate_benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "immediate_batch.h"
+#include "immediate_renderer.h"
+
+static constexpr uint32_t BENCHMARK_SPRITE_TEXTURES = 8;
+static constexpr uint32_t BENCHMARK_GLYPH_WIDTH = 8;
+static constexpr uint32_t BENCHMARK_GLYPH_HEIGHT = 12;
+static const std::string BENCHMARK_TEXT = "The quick brown fox jumps over 13";
+
+typedef std::function<void(ImmediateBatch &batch, uint32_t index)> BenchmarkSubmit;
+
+// Printable ASCII with solid coverage, only the metrics matter for the CPU cost
+static GlyphAtlas createBenchmarkAtlas() {
+    std::vector<GlyphBitmap> bitmaps;
+    for (uint32_t codepoint = 33; codepoint < 127; ++codepoint) {
+        GlyphBitmap bitmap{};
+        bitmap.codepoint = codepoint;
+        bitmap.width = BENCHMARK_GLYPH_WIDTH;
+        bitmap.height = BENCHMARK_GLYPH_HEIGHT;
+        bitmap.offset = glm::vec2(0.0f, -static_cast<float>(BENCHMARK_GLYPH_HEIGHT));
+        bitmap.advance = BENCHMARK_GLYPH_WIDTH + 1;
+        bitmap.coverage.assign(BENCHMARK_GLYPH_WIDTH * BENCHMARK_GLYPH_HEIGHT, 255);
+        bitmaps.push_back(std::move(bitmap));
+    }
+
+    GlyphBitmap space{};
+    space.codepoint = ' ';
+    space.advance = BENCHMARK_GLYPH_WIDTH + 1;
+    bitmaps.push_back(space);
+
+    return packGlyphAtlas(bitmaps, BENCHMARK_GLYPH_HEIGHT + 4);
+}
+
+static void runCase(const std::string &name, uint32_t primitiveCount, uint32_t primitivesPerCall,
+                    uint32_t iterations, const GlyphAtlas &atlas, const BenchmarkSubmit &submit) {
+    ImmediateBatch batch;
+    batch.setFont(&atlas);
+    std::vector<ImmediateVertex> destination;
+    std::vector<ImmediateDraw> draws;
+    uint32_t calls = (primitiveCount + primitivesPerCall - 1) / primitivesPerCall;
+
+    double submitNanoseconds = 0.0;
+    double buildNanoseconds = 0.0;
+    // The first iteration grows the batch's storage and is not measured
+    for (uint32_t iteration = 0; iteration <= iterations; ++iteration) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < calls; ++i) {
+            submit(batch, i);
+        }
+        auto submitted = std::chrono::steady_clock::now();
+
+        if (destination.size() < batch.getVertexCount()) {
+            destination.resize(batch.getVertexCount());
+        }
+        draws.clear();
+        batch.build(destination.data(), destination.size(), IMMEDIATE_MAX_QUADS_PER_DRAW, draws);
+        batch.clear();
+        auto built = std::chrono::steady_clock::now();
+
+        if (iteration > 0) {
+            submitNanoseconds += std::chrono::duration<double, std::nano>(submitted - start).count();
+            buildNanoseconds += std::chrono::duration<double, std::nano>(built - submitted).count();
+        }
+    }
+
+    double primitives = static_cast<double>(calls) * primitivesPerCall * iterations;
+    std::cout << std::format("{:<8} {:>9} {:>12.1f} {:>12.1f} {:>8}", name, calls * primitivesPerCall,
+                             submitNanoseconds / primitives, buildNanoseconds / primitives, draws.size())
+              << std::endl;
+}
+
+void runImmediateBenchmark(uint32_t primitiveCount, uint32_t iterations) {
+    auto atlas = createBenchmarkAtlas();
+    uint32_t white = packColor(255, 255, 255);
+    // Spaces only advance the pen
+    uint32_t glyphsPerText = BENCHMARK_TEXT.size() - std::count(BENCHMARK_TEXT.begin(), BENCHMARK_TEXT.end(), ' ');
+
+    std::cout << std::format("Immediate batch, {} primitives, {} iterations", primitiveCount, iterations)
+              << std::endl;
+    std::cout << std::format("{:<8} {:>9} {:>12} {:>12} {:>8}", "kind", "count", "submit ns", "build ns", "draws")
+              << std::endl;
+
+    runCase("lines", primitiveCount, 1, iterations, atlas, [white](ImmediateBatch &batch, uint32_t i) {
+        float x = static_cast<float>(i % 1024);
+        batch.line(glm::vec3(x, 0.0f, 0.0f), glm::vec3(x, 1.0f, 0.0f), white);
+    });
+
+    runCase("boxes", primitiveCount, 1, iterations, atlas, [white](ImmediateBatch &batch, uint32_t i) {
+        glm::vec3 min(static_cast<float>(i % 1024), 0.0f, 0.0f);
+        batch.box(min, min + glm::vec3(1.0f), white);
+    });
+
+    runCase("rects", primitiveCount, 1, iterations, atlas, [white](ImmediateBatch &batch, uint32_t i) {
+        glm::vec2 min(static_cast<float>(i % 1920), static_cast<float>(i / 1920 % 1080));
+        batch.rect(min, min + glm::vec2(4.0f), white);
+    });
+
+    // Interleaved textures, the worst case for run merging before sorting
+    runCase("sprites", primitiveCount, 1, iterations, atlas, [white](ImmediateBatch &batch, uint32_t i) {
+        glm::vec2 min(static_cast<float>(i % 1920), static_cast<float>(i / 1920 % 1080));
+        batch.sprite(min, min + glm::vec2(16.0f), i % BENCHMARK_SPRITE_TEXTURES, white);
+    });
+
+    runCase("glyphs", primitiveCount, glyphsPerText, iterations, atlas,
+            [white](ImmediateBatch &batch, uint32_t i) {
+        batch.text(glm::vec2(0.0f, static_cast<float>(i % 64) * 16.0f), BENCHMARK_TEXT, white);
+    });
+
+    // Debug overlay mix, lines below and text above the sprites
+    runCase("mixed", primitiveCount, 4, iterations, atlas, [white](ImmediateBatch &batch, uint32_t i) {
+        glm::vec2 min(static_cast<float>(i % 1920), static_cast<float>(i / 1920 % 1080));
+        batch.setLayer(0);
+        batch.line2D(min, min + glm::vec2(8.0f), white);
+        batch.setLayer(1);
+        batch.sprite(min, min + glm::vec2(16.0f), i % BENCHMARK_SPRITE_TEXTURES, white);
+        batch.rect(min, min + glm::vec2(4.0f), white);
+        batch.setLayer(2);
+        batch.text(min, "x", white);
+    });
+}
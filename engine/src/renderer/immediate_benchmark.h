@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Measures the CPU cost of ImmediateBatch without a device: submission and build time per primitive for every
+// primitive kind, and the number of draws the batch is merged into. Prints one line per kind.
+void runImmediateBenchmark(uint32_t primitiveCount, uint32_t iterations = 20);
@@ -0,0 +1,462 @@
+#include "immediate_renderer.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include "vulkan.h"
+
+static constexpr VkDeviceSize IMMEDIATE_VERTEX_ALIGNMENT = 16;
+static const std::string IMMEDIATE_VERTEX_SHADER = "immediate.vert";
+static const std::string IMMEDIATE_FRAGMENT_SHADER = "immediate.frag";
+
+typedef struct ImmediatePushConstants {
+    glm::mat4 transform;
+    uint32_t textureIndex;
+    uint32_t samplerIndex;
+} ImmediatePushConstants;
+
+// Matches the constant_id declarations in immediate.frag
+typedef struct ImmediateSpecialization {
+    uint32_t textureCount;
+    uint32_t samplerCount;
+} ImmediateSpecialization;
+
+void ImmediateRenderer::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                   const VkAllocationCallbacks *allocationCallbacks, ShaderLibrary &shaderLibrary,
+                                   PipelineCache &pipelineCache, BindlessDescriptors &bindless,
+                                   UploadQueue &uploadQueue, VkDescriptorSetLayout globalSetLayout,
+                                   const ImmediateRendererConfig &config) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->shaderLibrary = &shaderLibrary;
+    this->pipelineCache = &pipelineCache;
+    this->bindless = &bindless;
+    this->uploadQueue = &uploadQueue;
+    this->config = config;
+
+    vertexRing.initialize(physicalDevice, device, allocationCallbacks,
+                          IMMEDIATE_MAX_VERTICES_PER_FRAME * sizeof(ImmediateVertex), 0, IMMEDIATE_VERTEX_ALIGNMENT,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+    // Every quad is drawn from the same index pattern, the draw's vertex offset selects its first quad
+    std::vector<uint32_t> indices(IMMEDIATE_MAX_QUADS_PER_DRAW * 6);
+    for (uint32_t quad = 0; quad < IMMEDIATE_MAX_QUADS_PER_DRAW; ++quad) {
+        uint32_t first = quad * 4;
+        uint32_t *index = &indices[quad * 6];
+        index[0] = first;
+        index[1] = first + 1;
+        index[2] = first + 2;
+        index[3] = first + 2;
+        index[4] = first + 3;
+        index[5] = first;
+    }
+    indexBuffer = createBuffer(physicalDevice, device, allocationCallbacks, indices.size() * sizeof(uint32_t),
+                               VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memcpy(indexBuffer.mapped, indices.data(), indices.size() * sizeof(uint32_t));
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ImmediatePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    VkDescriptorSetLayout setLayouts[] = {globalSetLayout, bindless.getLayout()};
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocationCallbacks, &pipelineLayout))
+
+    // Feature variants do not apply here, each set holds the single pipeline of its topology
+    linePipelines.initialize(device, allocationCallbacks, 0, [this](const VkSpecializationInfo &) {
+        return buildPipeline(VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    });
+    quadPipelines.initialize(device, allocationCallbacks, 0, [this](const VkSpecializationInfo &) {
+        return buildPipeline(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    });
+    linePipelines.get(0);
+    quadPipelines.get(0);
+
+    VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(device, &samplerCreateInfo, allocationCallbacks, &sampler))
+    samplerHandle = bindless.registerSampler(sampler);
+
+    uint32_t white = packColor(255, 255, 255);
+    VkComponentMapping identity{};
+    if (!uploadTexture(whiteTexture, VK_FORMAT_R8G8B8A8_UNORM, identity, 1, 1, &white, sizeof(white), nullptr)) {
+        throw std::runtime_error("Unable to upload the immediate mode white texture");
+    }
+}
+
+void ImmediateRenderer::destroy() {
+    linePipelines.destroy();
+    quadPipelines.destroy();
+    vkDestroyPipelineLayout(device, pipelineLayout, allocationCallbacks);
+
+    for (const auto &texture: pendingTextures) {
+        destroyTexture(texture);
+    }
+    for (const auto &retired: retiredTextures) {
+        destroyTexture(retired.texture);
+    }
+    destroyTexture(whiteTexture);
+    destroyTexture(fontTexture);
+    pendingTextures.clear();
+    retiredTextures.clear();
+    vkDestroySampler(device, sampler, allocationCallbacks);
+
+    vertexRing.destroy(device, allocationCallbacks);
+    destroyBuffer(device, allocationCallbacks, indexBuffer);
+}
+
+void ImmediateRenderer::setFont(const GlyphAtlas &atlas) {
+    pendingFont = atlas;
+    queueFontUpload();
+}
+
+void ImmediateRenderer::beginFrame(uint32_t frameIndex, uint64_t frameNumber) {
+    this->frameNumber = frameNumber;
+    vertexRing.beginFrame(frameIndex);
+    linePipelines.beginFrame(frameNumber);
+    quadPipelines.beginFrame(frameNumber);
+
+    if (fontUploadPending) {
+        queueFontUpload();
+    }
+
+    std::erase_if(retiredTextures, [this, frameNumber](const RetiredTexture &retired) {
+        if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+            return false;
+        }
+        destroyTexture(retired.texture);
+        return true;
+    });
+}
+
+void ImmediateRenderer::record(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4 &viewProjection,
+                               VkExtent2D extent) {
+    uint32_t vertexCapacity = std::min(batch.getVertexCount(), IMMEDIATE_MAX_VERTICES_PER_FRAME);
+    if (vertexCapacity == 0) {
+        batch.clear();
+        return;
+    }
+
+    auto vertices = vertexRing.allocate(vertexCapacity * sizeof(ImmediateVertex));
+    draws.clear();
+    batch.build(static_cast<ImmediateVertex *>(vertices.data), vertexCapacity, IMMEDIATE_MAX_QUADS_PER_DRAW, draws);
+    batch.clear();
+
+    // Pixels to clip space, Vulkan's clip space already has y pointing down
+    glm::mat4 screenTransform(1.0f);
+    screenTransform[0][0] = 2.0f / static_cast<float>(extent.width);
+    screenTransform[1][1] = 2.0f / static_cast<float>(extent.height);
+    screenTransform[3][0] = -1.0f;
+    screenTransform[3][1] = -1.0f;
+
+    VkBuffer vertexBuffer = vertexRing.getBuffer();
+    VkDeviceSize vertexOffset = vertices.offset;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    bindless->bindSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    for (const auto &draw: draws) {
+        auto image = resolveTexture(draw.texture);
+        if (image == INVALID_BINDLESS_HANDLE) {
+            continue;
+        }
+
+        auto pipeline = draw.topology == IMMEDIATE_TOPOLOGY_QUADS ? quadPipelines.get(0) : linePipelines.get(0);
+        if (pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+        }
+
+        PushConstants indices{};
+        bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, frameIndex, indices, image,
+                       samplerHandle);
+
+        ImmediatePushConstants pushConstants = {
+                .transform = draw.space == IMMEDIATE_SPACE_SCREEN ? screenTransform : viewProjection,
+                .textureIndex = indices.textureIndex,
+                .samplerIndex = indices.samplerIndex,
+        };
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(ImmediatePushConstants), &pushConstants);
+
+        if (draw.topology == IMMEDIATE_TOPOLOGY_QUADS) {
+            vkCmdDrawIndexed(commandBuffer, draw.vertexCount / 4 * 6, 1, 0, static_cast<int32_t>(draw.firstVertex),
+                             0);
+        } else {
+            vkCmdDraw(commandBuffer, draw.vertexCount, 1, draw.firstVertex, 0);
+        }
+    }
+}
+
+void ImmediateRenderer::onShaderReloaded(const std::string &shaderName) {
+    if (shaderName != IMMEDIATE_VERTEX_SHADER && shaderName != IMMEDIATE_FRAGMENT_SHADER) {
+        return;
+    }
+
+    linePipelines.rebuild();
+    quadPipelines.rebuild();
+}
+
+VkPipeline ImmediateRenderer::buildPipeline(VkPrimitiveTopology topology) {
+    auto createModule = [this](const std::string &shaderName) {
+        auto shaderCode = shaderLibrary->getCode(shaderName);
+
+        VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        createInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+        createInfo.pCode = shaderCode.data();
+
+        VkShaderModule result;
+        VK_CHECK(vkCreateShaderModule(device, &createInfo, allocationCallbacks, &result))
+        return result;
+    };
+
+    auto vertShaderModule = createModule(IMMEDIATE_VERTEX_SHADER);
+    auto fragShaderModule = createModule(IMMEDIATE_FRAGMENT_SHADER);
+
+    ImmediateSpecialization specializationData = {
+            .textureCount = bindless->getDescriptorCount(BINDLESS_RESOURCE_SAMPLED_IMAGE),
+            .samplerCount = bindless->getDescriptorCount(BINDLESS_RESOURCE_SAMPLER),
+    };
+    VkSpecializationMapEntry specializationEntries[] = {
+            {0, offsetof(ImmediateSpecialization, textureCount), sizeof(uint32_t)},
+            {1, offsetof(ImmediateSpecialization, samplerCount), sizeof(uint32_t)},
+    };
+    VkSpecializationInfo specialization{};
+    specialization.mapEntryCount = 2;
+    specialization.pMapEntries = specializationEntries;
+    specialization.dataSize = sizeof(specializationData);
+    specialization.pData = &specializationData;
+
+    VkPipelineShaderStageCreateInfo vertStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    vertStageCreateInfo.module = vertShaderModule;
+    vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertStageCreateInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    fragStageCreateInfo.module = fragShaderModule;
+    fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragStageCreateInfo.pName = "main";
+    fragStageCreateInfo.pSpecializationInfo = &specialization;
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageCreateInfo, fragStageCreateInfo};
+
+    std::vector<VkDynamicState> dynamicStates = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = dynamicStates.size();
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkVertexInputBindingDescription vertexBinding{};
+    vertexBinding.binding = 0;
+    vertexBinding.stride = sizeof(ImmediateVertex);
+    vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    std::array<VkVertexInputAttributeDescription, 3> vertexAttributes{};
+    vertexAttributes[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(ImmediateVertex, position)};
+    vertexAttributes[1] = {1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(ImmediateVertex, uv)};
+    vertexAttributes[2] = {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(ImmediateVertex, color)};
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &vertexBinding;
+    vertexInputInfo.vertexAttributeDescriptionCount = vertexAttributes.size();
+    vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.lineWidth = 1.0;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Premultiplication is left to the shader's output, text and sprites blend with straight alpha
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = sizeof(shaderStages) / sizeof(VkPipelineShaderStageCreateInfo);
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = config.renderPass;
+    pipelineInfo.subpass = 0;
+
+    VkPipelineRenderingCreateInfo renderingCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+    renderingCreateInfo.colorAttachmentCount = 1;
+    renderingCreateInfo.pColorAttachmentFormats = &config.colorFormat;
+    if (config.renderPass == VK_NULL_HANDLE) {
+        pipelineInfo.pNext = &renderingCreateInfo;
+    }
+
+    VkPipeline result;
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, allocationCallbacks, &result))
+
+    vkDestroyShaderModule(device, vertShaderModule, allocationCallbacks);
+    vkDestroyShaderModule(device, fragShaderModule, allocationCallbacks);
+    return result;
+}
+
+BindlessHandle ImmediateRenderer::resolveTexture(uint32_t texture) const {
+    switch (texture) {
+        case IMMEDIATE_TEXTURE_WHITE:
+            return whiteTexture.handle;
+        case IMMEDIATE_TEXTURE_FONT:
+            return fontTexture.handle;
+        default:
+            return texture;
+    }
+}
+
+bool ImmediateRenderer::uploadTexture(ImmediateTexture &target, VkFormat format, VkComponentMapping components,
+                                      uint32_t width, uint32_t height, const void *data, VkDeviceSize size,
+                                      std::function<void()> onInstalled) {
+    VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.extent = {width, height, 1};
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (config.queueFamilyIndices.size() > 1) {
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageCreateInfo.queueFamilyIndexCount = config.queueFamilyIndices.size();
+        imageCreateInfo.pQueueFamilyIndices = config.queueFamilyIndices.data();
+    } else {
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    ImmediateTexture texture{};
+    VK_CHECK(vkCreateImage(device, &imageCreateInfo, allocationCallbacks, &texture.image))
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, texture.image, &memoryRequirements);
+
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &texture.memory))
+    VK_CHECK(vkBindImageMemory(device, texture.image, texture.memory, 0))
+
+    VkImageViewCreateInfo viewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewCreateInfo.image = texture.image;
+    viewCreateInfo.format = format;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.components = components;
+    viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+    VK_CHECK(vkCreateImageView(device, &viewCreateInfo, allocationCallbacks, &texture.imageView))
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {width, height, 1};
+
+    bool queued = uploadQueue->uploadImage(texture.image, 1, data, size, {region},
+                                           [this, &target, texture, onInstalled]() {
+        std::erase_if(pendingTextures, [&texture](const ImmediateTexture &pending) {
+            return pending.image == texture.image;
+        });
+
+        if (target.image != VK_NULL_HANDLE) {
+            bindless->release(BINDLESS_RESOURCE_SAMPLED_IMAGE, target.handle);
+            retiredTextures.push_back({target, frameNumber});
+        }
+
+        target = texture;
+        target.handle = bindless->registerSampledImage(texture.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        if (onInstalled) {
+            onInstalled();
+        }
+    });
+
+    if (!queued) {
+        destroyTexture(texture);
+        return false;
+    }
+
+    pendingTextures.push_back(texture);
+    return true;
+}
+
+void ImmediateRenderer::queueFontUpload() {
+    // Coverage goes to alpha, the glyphs take their color from the vertices
+    VkComponentMapping coverageAsAlpha = {VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE,
+                                          VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_R};
+
+    // Metrics switch together with the texture so that no frame mixes the old atlas with new coordinates
+    auto metrics = std::make_shared<GlyphAtlas>(std::move(pendingFont));
+    bool queued = uploadTexture(fontTexture, VK_FORMAT_R8_UNORM, coverageAsAlpha, metrics->width, metrics->height,
+                                metrics->pixels.data(), metrics->pixels.size(), [this, metrics]() {
+        font = std::move(*metrics);
+        batch.setFont(&font);
+    });
+
+    if (!queued) {
+        // A full staging ring is retried next frame
+        pendingFont = std::move(*metrics);
+        fontUploadPending = true;
+        return;
+    }
+
+    metrics->pixels = {};
+    fontUploadPending = false;
+}
+
+void ImmediateRenderer::destroyTexture(const ImmediateTexture &texture) {
+    if (texture.image == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDestroyImageView(device, texture.imageView, allocationCallbacks);
+    vkDestroyImage(device, texture.image, allocationCallbacks);
+    vkFreeMemory(device, texture.memory, allocationCallbacks);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/mat4x4.hpp>
+
+#include "immediate_batch.h"
+#include "glyph_atlas.h"
+#include "vulkan_buffer.h"
+#include "vulkan_ring_buffer.h"
+#include "vulkan_bindless.h"
+#include "vulkan_upload.h"
+#include "vulkan_pipeline_cache.h"
+#include "pipeline_variants.h"
+#include "shader_library.h"
+
+// Size of the shared quad index buffer, large enough for 100k quads to go out in a single draw
+constexpr uint32_t IMMEDIATE_MAX_QUADS_PER_DRAW = 128 * 1024;
+constexpr uint32_t IMMEDIATE_MAX_VERTICES_PER_FRAME = IMMEDIATE_MAX_QUADS_PER_DRAW * 4;
+
+typedef struct ImmediateRendererConfig {
+    VkFormat colorFormat;
+    // VK_NULL_HANDLE when dynamic rendering is used
+    VkRenderPass renderPass;
+    // Queue families the textures are shared between, the upload queue's and the graphics queue's
+    std::vector<uint32_t> queueFamilyIndices;
+} ImmediateRendererConfig;
+
+// Draws the contents of an ImmediateBatch once per frame. Vertices go into a per-frame ring, quads share one static
+// index buffer, and each merged draw of the batch is one vkCmdDrawIndexed or vkCmdDraw. Textures are bindless
+// handles, the white texture and the font atlas are owned by the renderer.
+class ImmediateRenderer {
+public:
+    ImmediateRenderer() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    ShaderLibrary &shaderLibrary, PipelineCache &pipelineCache, BindlessDescriptors &bindless,
+                    UploadQueue &uploadQueue, VkDescriptorSetLayout globalSetLayout,
+                    const ImmediateRendererConfig &config);
+
+    void destroy();
+
+    ImmediateBatch &getBatch() { return batch; }
+
+    // Uploads the atlas used by ImmediateBatch::text(), the previous atlas stays in use until the upload finished
+    void setFont(const GlyphAtlas &atlas);
+
+    void beginFrame(uint32_t frameIndex, uint64_t frameNumber);
+
+    // Records the batch into the current render pass and clears it. Screen space primitives are in pixels of extent.
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4 &viewProjection,
+                VkExtent2D extent);
+
+    void onShaderReloaded(const std::string &shaderName);
+
+private:
+    typedef struct ImmediateTexture {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        BindlessHandle handle = INVALID_BINDLESS_HANDLE;
+    } ImmediateTexture;
+
+    typedef struct RetiredTexture {
+        ImmediateTexture texture;
+        uint64_t frameNumber;
+    } RetiredTexture;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    ShaderLibrary *shaderLibrary = nullptr;
+    PipelineCache *pipelineCache = nullptr;
+    BindlessDescriptors *bindless = nullptr;
+    UploadQueue *uploadQueue = nullptr;
+    ImmediateRendererConfig config{};
+    uint64_t frameNumber = 0;
+
+    ImmediateBatch batch;
+    std::vector<ImmediateDraw> draws;
+    RingBuffer vertexRing;
+    Buffer indexBuffer;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    PipelineVariants linePipelines;
+    PipelineVariants quadPipelines;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    BindlessHandle samplerHandle = INVALID_BINDLESS_HANDLE;
+    ImmediateTexture whiteTexture;
+    ImmediateTexture fontTexture;
+    std::vector<ImmediateTexture> pendingTextures;
+    std::vector<RetiredTexture> retiredTextures;
+    // Metrics of the installed atlas, the pending one replaces it once its texture finished uploading
+    GlyphAtlas font{};
+    GlyphAtlas pendingFont{};
+    bool fontUploadPending = false;
+
+    VkPipeline buildPipeline(VkPrimitiveTopology topology);
+
+    BindlessHandle resolveTexture(uint32_t texture) const;
+
+    bool uploadTexture(ImmediateTexture &target, VkFormat format, VkComponentMapping components, uint32_t width,
+                       uint32_t height, const void *data, VkDeviceSize size, std::function<void()> onInstalled);
+
+    void queueFontUpload();
+
+    void destroyTexture(const ImmediateTexture &texture);
+};
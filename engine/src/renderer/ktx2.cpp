@@ -0,0 +1,192 @@
+#include "ktx2.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <numeric>
+#include <stdexcept>
+#include <vulkan/vk_enum_string_helper.h>
+#include "core/file.h"
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+typedef struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+} Ktx2Header;
+
+typedef struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+} Ktx2LevelIndex;
+
+typedef struct Ktx2FormatBlock {
+    uint32_t bytes;
+    uint32_t width;
+    uint32_t height;
+} Ktx2FormatBlock;
+
+static_assert(sizeof(Ktx2Header) == 80);
+static_assert(sizeof(Ktx2LevelIndex) == 24);
+
+static bool isInRange(VkFormat format, VkFormat first, VkFormat last) {
+    return format >= first && format <= last;
+}
+
+// Texel block of the formats a texture can be uploaded in as is, a block size of 0 for everything else
+static Ktx2FormatBlock getFormatBlock(VkFormat format) {
+    if (format == VK_FORMAT_R4G4_UNORM_PACK8 || isInRange(format, VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB)) {
+        return {1, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16) ||
+        isInRange(format, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB) ||
+        isInRange(format, VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT)) {
+        return {2, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB)) {
+        return {3, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32) ||
+        isInRange(format, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT) ||
+        isInRange(format, VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT) ||
+        format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) {
+        return {4, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT)) {
+        return {6, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT) ||
+        isInRange(format, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT)) {
+        return {8, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT)) {
+        return {12, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT)) {
+        return {16, 1, 1};
+    }
+    if (isInRange(format, VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK) ||
+        isInRange(format, VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK) ||
+        isInRange(format, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) ||
+        isInRange(format, VK_FORMAT_EAC_R11_UNORM_BLOCK, VK_FORMAT_EAC_R11_SNORM_BLOCK)) {
+        return {8, 4, 4};
+    }
+    if (isInRange(format, VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK) ||
+        isInRange(format, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK) ||
+        isInRange(format, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) ||
+        isInRange(format, VK_FORMAT_EAC_R11G11_UNORM_BLOCK, VK_FORMAT_EAC_R11G11_SNORM_BLOCK)) {
+        return {16, 4, 4};
+    }
+    if (isInRange(format, VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK)) {
+        // UNORM and SRGB variants alternate, in order of the block extents
+        static constexpr uint32_t ASTC_BLOCKS[][2] = {
+                {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10},
+                {12, 10}, {12, 12},
+        };
+        const auto &block = ASTC_BLOCKS[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+        return {16, block[0], block[1]};
+    }
+    return {0, 1, 1};
+}
+
+Ktx2File readKtx2Header(const std::string &fileName) {
+    auto headerData = readBinaryFileRange(fileName, 0, sizeof(Ktx2Header));
+    Ktx2Header header;
+    memcpy(&header, headerData.data(), sizeof(Ktx2Header));
+
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error(std::format("Not a KTX2 file: {}", fileName));
+    }
+
+    if (header.vkFormat == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error(std::format("KTX2 file needs transcoding, only GPU ready formats are supported: {}",
+                                             fileName));
+    }
+
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error(std::format("Supercompressed KTX2 files are not supported: {}", fileName));
+    }
+
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+        throw std::runtime_error(std::format("Only 2D KTX2 textures are supported: {}", fileName));
+    }
+
+    auto format = static_cast<VkFormat>(header.vkFormat);
+    auto block = getFormatBlock(format);
+    if (block.bytes == 0) {
+        throw std::runtime_error(std::format("KTX2 format {} is not supported: {}", string_VkFormat(format),
+                                             fileName));
+    }
+
+    if (header.pixelWidth == 0) {
+        throw std::runtime_error(std::format("KTX2 texture has no width: {}", fileName));
+    }
+
+    Ktx2File result = {
+            .format = format,
+            .width = header.pixelWidth,
+            .height = std::max(header.pixelHeight, 1u),
+    };
+
+    // Streaming drops and adds single levels, which needs every one of them down to 1x1
+    uint32_t levelCount = std::bit_width(std::max(result.width, result.height));
+    if (header.levelCount != levelCount) {
+        throw std::runtime_error(std::format("KTX2 texture has {} mip levels instead of the full chain of {}: {}",
+                                             header.levelCount, levelCount, fileName));
+    }
+
+    auto fileSize = std::filesystem::file_size(fileName);
+    auto indexData = readBinaryFileRange(fileName, sizeof(Ktx2Header), sizeof(Ktx2LevelIndex) * levelCount);
+    // Required by KTX2 and by the copy regions, which are offset by the distance between levels
+    uint64_t alignment = std::lcm(block.bytes, 4u);
+
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        Ktx2LevelIndex index;
+        memcpy(&index, indexData.data() + level * sizeof(Ktx2LevelIndex), sizeof(Ktx2LevelIndex));
+
+        uint32_t width = std::max(result.width >> level, 1u);
+        uint32_t height = std::max(result.height >> level, 1u);
+        uint64_t blockCount = static_cast<uint64_t>((width + block.width - 1) / block.width) *
+                              ((height + block.height - 1) / block.height);
+        if (index.byteOffset > fileSize || index.byteLength > fileSize - index.byteOffset ||
+            index.byteOffset % alignment != 0) {
+            throw std::runtime_error(std::format("KTX2 mip level {} lies outside of the file: {}", level, fileName));
+        }
+        if (index.byteLength < blockCount * block.bytes) {
+            throw std::runtime_error(std::format("KTX2 mip level {} has {} bytes, {}x{} need {}: {}", level,
+                                                 index.byteLength, width, height, blockCount * block.bytes,
+                                                 fileName));
+        }
+
+        // The smallest level comes first in the file, streamed windows are read as one range
+        if (level > 0 && index.byteOffset + index.byteLength > result.levels.back().byteOffset) {
+            throw std::runtime_error(std::format("KTX2 mip level {} is not stored before level {}: {}", level,
+                                                 level - 1, fileName));
+        }
+
+        result.levels.push_back({
+                                        .byteOffset = index.byteOffset,
+                                        .byteLength = index.byteLength,
+                                        .width = width,
+                                        .height = height,
+                                });
+    }
+
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+typedef struct Ktx2Level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint32_t width;
+    uint32_t height;
+} Ktx2Level;
+
+typedef struct Ktx2File {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    std::vector<Ktx2Level> levels;
+} Ktx2File;
+
+// Reads the header and level index of a KTX2 texture. Only GPU ready 2D textures are accepted: the payload must
+// not be supercompressed and must contain the full precomputed mip chain, so uploads are plain copies. Every level
+// has to lie inside the file, smallest first, and hold at least the data its extent needs in the format.
+Ktx2File readKtx2Header(const std::string &fileName);
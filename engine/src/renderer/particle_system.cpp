@@ -0,0 +1,581 @@
+#include "particle_system.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include "vulkan.h"
+
+static constexpr uint32_t PARTICLE_SORT_BLOCK_SIZE = 1024;
+static constexpr uint32_t PARTICLE_RESET_GROUP_SIZE = 256;
+static const std::string PARTICLE_VERTEX_SHADER = "particle.vert";
+static const std::string PARTICLE_FRAGMENT_SHADER = "particle.frag";
+static const std::array<std::string, PARTICLE_PIPELINE_DRAW> PARTICLE_COMPUTE_SHADERS = {
+        "particle_reset.comp",
+        "particle_prepare.comp",
+        "particle_emit.comp",
+        "particle_simulate.comp",
+        "particle_finalize.comp",
+        "particle_sort_local.comp",
+        "particle_sort_global.comp",
+};
+
+// Byte offsets of the indirect arguments in the State block of the shaders
+static constexpr VkDeviceSize PARTICLE_EMIT_DISPATCH_OFFSET = 32;
+static constexpr VkDeviceSize PARTICLE_SIMULATE_DISPATCH_OFFSET = 48;
+static constexpr VkDeviceSize PARTICLE_SORT_DISPATCH_OFFSET = 64;
+static constexpr VkDeviceSize PARTICLE_DRAW_ARGUMENTS_OFFSET = 80;
+static constexpr VkDeviceSize PARTICLE_STATE_SIZE = 96;
+// aliveCount[2], deadCount and emitCount are copied back every frame
+static constexpr VkDeviceSize PARTICLE_COUNTERS_SIZE = 16;
+
+// Matches the Particle struct of the shaders
+typedef struct GpuParticle {
+    glm::vec4 positionLife;
+    glm::vec4 velocityLifetime;
+    uint32_t colorStart;
+    uint32_t colorEnd;
+    float size;
+    float padding;
+} GpuParticle;
+
+// Matches the Emitter struct of particle_emit.comp
+typedef struct GpuParticleEmitter {
+    glm::vec4 positionSpread;
+    glm::vec4 velocitySpread;
+    uint32_t colorStart;
+    uint32_t colorEnd;
+    float lifetime;
+    float lifetimeSpread;
+    float size;
+    uint32_t firstParticle;
+    uint32_t particleCount;
+    float padding;
+} GpuParticleEmitter;
+
+// Matches the push constant block shared by all particle shaders
+typedef struct ParticlePushConstants {
+    glm::mat4 viewProjection;
+    glm::vec4 gravity;
+    uint32_t parity;
+    uint32_t seed;
+    uint32_t emitRequested;
+    uint32_t emitterCount;
+    uint32_t sortBlock;
+    uint32_t sortStep;
+    uint32_t capacity;
+    uint32_t padding;
+    glm::vec2 projectionScale;
+} ParticlePushConstants;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void ParticleSystem::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                const VkAllocationCallbacks *allocationCallbacks, ShaderLibrary &shaderLibrary,
+                                PipelineCache &pipelineCache, DescriptorLayoutCache &descriptorLayoutCache,
+                                VkFormat colorFormat, VkRenderPass renderPass,
+                                const std::vector<uint32_t> &queueFamilyIndices, const ParticleSystemConfig &config) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->shaderLibrary = &shaderLibrary;
+    this->pipelineCache = &pipelineCache;
+    this->colorFormat = colorFormat;
+    this->renderPass = renderPass;
+    this->queueFamilyIndices = queueFamilyIndices;
+    this->config = config;
+    asyncCompute = queueFamilyIndices.size() > 1;
+
+    if (config.capacity == 0) {
+        throw std::runtime_error("The particle capacity must not be zero");
+    }
+
+    // The bitonic sort works on power of two counts of whole blocks
+    sortCapacity = PARTICLE_SORT_BLOCK_SIZE;
+    while (sortCapacity < config.capacity) {
+        sortCapacity *= 2;
+    }
+
+    stats.capacity = config.capacity;
+
+    createBuffers();
+    createDescriptors(descriptorLayoutCache);
+
+    for (uint32_t pipeline = 0; pipeline < PARTICLE_PIPELINE_COUNT; ++pipeline) {
+        auto type = static_cast<ParticlePipeline>(pipeline);
+        pipelines[pipeline].initialize(device, allocationCallbacks, 0, [this, type](const VkSpecializationInfo &) {
+            return type == PARTICLE_PIPELINE_DRAW ? buildDrawPipeline() : buildComputePipeline(type);
+        });
+        pipelines[pipeline].get(0);
+    }
+}
+
+void ParticleSystem::destroy() {
+    for (auto &pipeline: pipelines) {
+        pipeline.destroy();
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, allocationCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, allocationCallbacks);
+
+    destroyBuffer(device, allocationCallbacks, particleBuffer);
+    destroyBuffer(device, allocationCallbacks, aliveBuffer);
+    destroyBuffer(device, allocationCallbacks, deadBuffer);
+    destroyBuffer(device, allocationCallbacks, stateBuffer);
+    destroyBuffer(device, allocationCallbacks, drawListBuffer);
+    destroyBuffer(device, allocationCallbacks, emitterBuffer);
+    destroyBuffer(device, allocationCallbacks, readbackBuffer);
+}
+
+ParticleEmitterHandle ParticleSystem::addEmitter(const ParticleEmitter &emitter) {
+    active = true;
+    ++stats.emitterCount;
+
+    for (size_t index = 0; index < emitters.size(); ++index) {
+        if (!emitters[index].used) {
+            emitters[index] = {emitter, 0.0f, true};
+            return index;
+        }
+    }
+
+    if (emitters.size() == MAX_PARTICLE_EMITTERS) {
+        throw std::runtime_error(std::format("Unable to add more than {} particle emitters", MAX_PARTICLE_EMITTERS));
+    }
+
+    emitters.push_back({emitter, 0.0f, true});
+    return emitters.size() - 1;
+}
+
+void ParticleSystem::updateEmitter(ParticleEmitterHandle handle, const ParticleEmitter &emitter) {
+    if (handle >= emitters.size() || !emitters[handle].used) {
+        throw std::runtime_error(std::format("Invalid particle emitter handle {}", handle));
+    }
+
+    emitters[handle].emitter = emitter;
+}
+
+void ParticleSystem::removeEmitter(ParticleEmitterHandle handle) {
+    if (handle >= emitters.size() || !emitters[handle].used) {
+        throw std::runtime_error(std::format("Invalid particle emitter handle {}", handle));
+    }
+
+    // Particles already emitted live out their lifetime
+    emitters[handle].used = false;
+    --stats.emitterCount;
+}
+
+void ParticleSystem::update(float deltaSeconds) {
+    this->deltaSeconds = deltaSeconds;
+
+    for (auto &slot: emitters) {
+        if (slot.used) {
+            slot.pendingParticles += slot.emitter.rate * deltaSeconds;
+        }
+    }
+}
+
+void ParticleSystem::beginFrame(uint64_t frameNumber) {
+    for (auto &pipeline: pipelines) {
+        pipeline.beginFrame(frameNumber);
+    }
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                                      const glm::mat4 &viewProjection) {
+    this->viewProjection = viewProjection;
+    parity = 1 - parity;
+
+    // The fence of this frame index was waited on, so its counters are complete
+    auto counters = static_cast<const uint32_t *>(readbackBuffer.mapped) + frameIndex * 4;
+    stats.aliveCount = config.capacity - std::min(counters[2], config.capacity);
+    stats.emittedCount = counters[3];
+
+    // Whole particles are handed out, the fractions carry over to the next frame. Emitters are laid out in the order
+    // of their first particle, the emit shader searches them by particle index.
+    auto gpuEmitters = reinterpret_cast<GpuParticleEmitter *>(static_cast<uint8_t *>(emitterBuffer.mapped) +
+                                                              frameIndex * emitterRegionSize);
+    emitRequested = 0;
+    emitterCount = 0;
+    for (auto &slot: emitters) {
+        if (!slot.used) {
+            continue;
+        }
+
+        auto particleCount = std::min(static_cast<uint32_t>(slot.pendingParticles), config.capacity - emitRequested);
+        slot.pendingParticles -= static_cast<float>(particleCount);
+        // A backlog beyond one full buffer is dropped instead of accumulating forever
+        slot.pendingParticles = std::min(slot.pendingParticles, static_cast<float>(config.capacity));
+        if (particleCount == 0) {
+            continue;
+        }
+
+        const auto &emitter = slot.emitter;
+        gpuEmitters[emitterCount++] = {
+                .positionSpread = glm::vec4(emitter.position, emitter.positionSpread),
+                .velocitySpread = glm::vec4(emitter.velocity, emitter.velocitySpread),
+                .colorStart = glm::packUnorm4x8(emitter.colorStart),
+                .colorEnd = glm::packUnorm4x8(emitter.colorEnd),
+                .lifetime = emitter.lifetime,
+                .lifetimeSpread = emitter.lifetimeSpread,
+                .size = emitter.size,
+                .firstParticle = emitRequested,
+                .particleCount = particleCount,
+                .padding = 0.0f,
+        };
+        emitRequested += particleCount;
+    }
+    stats.requestedParticles += emitRequested;
+    emitterOffset = static_cast<uint32_t>(frameIndex * emitterRegionSize);
+
+    // The previous frame's draw still reads the lists the compute passes are about to overwrite. On the compute queue
+    // the semaphore wait for the previous graphics frame takes care of that.
+    if (!asyncCompute) {
+        VkMemoryBarrier drawBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 1,
+                            &emitterOffset);
+
+    if (resetPending) {
+        dispatch(commandBuffer, PARTICLE_PIPELINE_RESET,
+                 (config.capacity + PARTICLE_RESET_GROUP_SIZE - 1) / PARTICLE_RESET_GROUP_SIZE);
+        computeBarrier(commandBuffer);
+        resetPending = false;
+    }
+
+    dispatch(commandBuffer, PARTICLE_PIPELINE_PREPARE, 1);
+    computeBarrier(commandBuffer);
+    dispatchIndirect(commandBuffer, PARTICLE_PIPELINE_EMIT, PARTICLE_EMIT_DISPATCH_OFFSET);
+    computeBarrier(commandBuffer);
+    dispatchIndirect(commandBuffer, PARTICLE_PIPELINE_SIMULATE, PARTICLE_SIMULATE_DISPATCH_OFFSET);
+    computeBarrier(commandBuffer);
+    dispatch(commandBuffer, PARTICLE_PIPELINE_FINALIZE, 1);
+    computeBarrier(commandBuffer);
+
+    VkBufferCopy region{0, frameIndex * PARTICLE_COUNTERS_SIZE, PARTICLE_COUNTERS_SIZE};
+    vkCmdCopyBuffer(commandBuffer, stateBuffer.buffer, readbackBuffer.buffer, 1, &region);
+
+    VkMemoryBarrier hostBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                         &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleSystem::recordSort(VkCommandBuffer commandBuffer) {
+    // Every dispatch covers the GPU side sort count, passes for blocks beyond it return immediately
+    dispatchIndirect(commandBuffer, PARTICLE_PIPELINE_SORT_LOCAL, PARTICLE_SORT_DISPATCH_OFFSET);
+    computeBarrier(commandBuffer);
+
+    for (uint32_t block = PARTICLE_SORT_BLOCK_SIZE * 2; block <= sortCapacity; block *= 2) {
+        for (uint32_t step = block / 2; step >= PARTICLE_SORT_BLOCK_SIZE; step /= 2) {
+            dispatchIndirect(commandBuffer, PARTICLE_PIPELINE_SORT_GLOBAL, PARTICLE_SORT_DISPATCH_OFFSET, block,
+                             step);
+            computeBarrier(commandBuffer);
+        }
+
+        // The remaining steps fit into one block and run in shared memory
+        dispatchIndirect(commandBuffer, PARTICLE_PIPELINE_SORT_LOCAL, PARTICLE_SORT_DISPATCH_OFFSET, block, 0);
+        computeBarrier(commandBuffer);
+    }
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[PARTICLE_PIPELINE_DRAW].get(0));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1,
+                            &emitterOffset);
+    pushConstants(commandBuffer, 0, 0);
+    vkCmdDrawIndirect(commandBuffer, stateBuffer.buffer, PARTICLE_DRAW_ARGUMENTS_OFFSET, 1, 0);
+}
+
+void ParticleSystem::onShaderReloaded(const std::string &shaderName) {
+    if (shaderName == PARTICLE_VERTEX_SHADER || shaderName == PARTICLE_FRAGMENT_SHADER) {
+        pipelines[PARTICLE_PIPELINE_DRAW].rebuild();
+        return;
+    }
+
+    auto shader = std::find(PARTICLE_COMPUTE_SHADERS.begin(), PARTICLE_COMPUTE_SHADERS.end(), shaderName);
+    if (shader != PARTICLE_COMPUTE_SHADERS.end()) {
+        pipelines[shader - PARTICLE_COMPUTE_SHADERS.begin()].rebuild();
+    }
+}
+
+void ParticleSystem::createBuffers() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    auto storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    auto deviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    auto hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    particleBuffer = createBuffer(physicalDevice, device, allocationCallbacks,
+                                  config.capacity * sizeof(GpuParticle), storage, deviceLocal, queueFamilyIndices);
+    aliveBuffer = createBuffer(physicalDevice, device, allocationCallbacks, config.capacity * 2 * sizeof(uint32_t),
+                               storage, deviceLocal, queueFamilyIndices);
+    deadBuffer = createBuffer(physicalDevice, device, allocationCallbacks, config.capacity * sizeof(uint32_t),
+                              storage, deviceLocal, queueFamilyIndices);
+    stateBuffer = createBuffer(physicalDevice, device, allocationCallbacks, PARTICLE_STATE_SIZE,
+                               storage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                               deviceLocal, queueFamilyIndices);
+    drawListBuffer = createBuffer(physicalDevice, device, allocationCallbacks,
+                                  static_cast<VkDeviceSize>(sortCapacity) * 2 * sizeof(uint32_t), storage,
+                                  deviceLocal, queueFamilyIndices);
+
+    emitterRegionSize = alignUp(MAX_PARTICLE_EMITTERS * sizeof(GpuParticleEmitter),
+                                properties.limits.minStorageBufferOffsetAlignment);
+    emitterBuffer = createBuffer(physicalDevice, device, allocationCallbacks, emitterRegionSize * MAX_FRAMES_IN_FLIGHT,
+                                 storage, hostVisible, queueFamilyIndices);
+
+    readbackBuffer = createBuffer(physicalDevice, device, allocationCallbacks,
+                                  PARTICLE_COUNTERS_SIZE * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  hostVisible);
+    // Reads as a full dead list until the first copy landed
+    auto counters = static_cast<uint32_t *>(readbackBuffer.mapped);
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+        counters[frame * 4] = 0;
+        counters[frame * 4 + 1] = 0;
+        counters[frame * 4 + 2] = config.capacity;
+        counters[frame * 4 + 3] = 0;
+    }
+}
+
+void ParticleSystem::createDescriptors(DescriptorLayoutCache &descriptorLayoutCache) {
+    VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    std::array<Buffer *, 6> buffers = {&particleBuffer, &aliveBuffer, &deadBuffer, &stateBuffer, &emitterBuffer,
+                                       &drawListBuffer};
+    constexpr uint32_t emitterBinding = 4;
+
+    DescriptorLayoutInfo layoutInfo;
+    for (uint32_t binding = 0; binding < buffers.size(); ++binding) {
+        auto type = binding == emitterBinding ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                                              : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutInfo.bindings.push_back({binding, type, 1, stages, nullptr});
+    }
+    setLayout = descriptorLayoutCache.getLayout(layoutInfo);
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(buffers.size() - 1)},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, allocationCallbacks, &descriptorPool))
+
+    VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet))
+
+    std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+    std::array<VkWriteDescriptorSet, 6> writes{};
+    for (uint32_t binding = 0; binding < buffers.size(); ++binding) {
+        // The dynamic offset selects the frame's emitter region
+        auto range = binding == emitterBinding ? emitterRegionSize : VK_WHOLE_SIZE;
+        bufferInfos[binding] = {buffers[binding]->buffer, 0, range};
+
+        writes[binding] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[binding].dstSet = descriptorSet;
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = layoutInfo.bindings[binding].descriptorType;
+        writes[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = stages;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ParticlePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocationCallbacks, &pipelineLayout))
+}
+
+VkPipeline ParticleSystem::buildComputePipeline(ParticlePipeline pipeline) {
+    auto shaderCode = shaderLibrary->getCode(PARTICLE_COMPUTE_SHADERS[pipeline]);
+
+    VkShaderModuleCreateInfo moduleCreateInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    moduleCreateInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+    moduleCreateInfo.pCode = shaderCode.data();
+
+    VkShaderModule shaderModule;
+    VK_CHECK(vkCreateShaderModule(device, &moduleCreateInfo, allocationCallbacks, &shaderModule))
+
+    VkComputePipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipelineInfo.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    VkPipeline result;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache->get(), 1, &pipelineInfo, allocationCallbacks, &result))
+
+    vkDestroyShaderModule(device, shaderModule, allocationCallbacks);
+    return result;
+}
+
+VkPipeline ParticleSystem::buildDrawPipeline() {
+    auto createModule = [this](const std::string &shaderName) {
+        auto shaderCode = shaderLibrary->getCode(shaderName);
+
+        VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        createInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+        createInfo.pCode = shaderCode.data();
+
+        VkShaderModule result;
+        VK_CHECK(vkCreateShaderModule(device, &createInfo, allocationCallbacks, &result))
+        return result;
+    };
+
+    auto vertShaderModule = createModule(PARTICLE_VERTEX_SHADER);
+    auto fragShaderModule = createModule(PARTICLE_FRAGMENT_SHADER);
+
+    VkPipelineShaderStageCreateInfo vertStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    vertStageCreateInfo.module = vertShaderModule;
+    vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertStageCreateInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    fragStageCreateInfo.module = fragShaderModule;
+    fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragStageCreateInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageCreateInfo, fragStageCreateInfo};
+
+    std::vector<VkDynamicState> dynamicStates = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = dynamicStates.size();
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // Quads are generated from gl_VertexIndex, the particles come from the storage buffers
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.lineWidth = 1.0;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = sizeof(shaderStages) / sizeof(VkPipelineShaderStageCreateInfo);
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+
+    VkPipelineRenderingCreateInfo renderingCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+    renderingCreateInfo.colorAttachmentCount = 1;
+    renderingCreateInfo.pColorAttachmentFormats = &colorFormat;
+    if (renderPass == VK_NULL_HANDLE) {
+        pipelineInfo.pNext = &renderingCreateInfo;
+    }
+
+    VkPipeline result;
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, allocationCallbacks, &result))
+
+    vkDestroyShaderModule(device, vertShaderModule, allocationCallbacks);
+    vkDestroyShaderModule(device, fragShaderModule, allocationCallbacks);
+    return result;
+}
+
+void ParticleSystem::dispatch(VkCommandBuffer commandBuffer, ParticlePipeline pipeline, uint32_t groupCount) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pipeline].get(0));
+    pushConstants(commandBuffer, 0, 0);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+}
+
+void ParticleSystem::dispatchIndirect(VkCommandBuffer commandBuffer, ParticlePipeline pipeline,
+                                      VkDeviceSize argumentOffset, uint32_t sortBlock, uint32_t sortStep) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pipeline].get(0));
+    pushConstants(commandBuffer, sortBlock, sortStep);
+    vkCmdDispatchIndirect(commandBuffer, stateBuffer.buffer, argumentOffset);
+}
+
+void ParticleSystem::pushConstants(VkCommandBuffer commandBuffer, uint32_t sortBlock, uint32_t sortStep) {
+    // Length of the first two rows, the clip space size of a unit offset along the camera's right and up axes
+    glm::vec2 projectionScale = {
+            glm::length(glm::vec3(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0])),
+            glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1])),
+    };
+
+    ParticlePushConstants constants = {
+            .viewProjection = viewProjection,
+            .gravity = glm::vec4(config.gravity, deltaSeconds),
+            .parity = parity,
+            .seed = static_cast<uint32_t>(stats.requestedParticles),
+            .emitRequested = emitRequested,
+            .emitterCount = emitterCount,
+            .sortBlock = sortBlock,
+            .sortStep = sortStep,
+            .capacity = config.capacity,
+            .padding = 0,
+            .projectionScale = projectionScale,
+    };
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(ParticlePushConstants), &constants);
+}
+
+void ParticleSystem::computeBarrier(VkCommandBuffer commandBuffer) const {
+    // Every particle pass reads what the previous one wrote, as indirect arguments, storage buffers or copy source.
+    // Compute queues have no vertex stage, the draw there waits on a semaphore instead.
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (!asyncCompute) {
+        dstStages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+}
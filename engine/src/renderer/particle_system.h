@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "vulkan_types.h"
+#include "vulkan_buffer.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_pipeline_cache.h"
+#include "pipeline_variants.h"
+#include "shader_library.h"
+
+constexpr uint32_t MAX_PARTICLE_EMITTERS = 64;
+
+typedef uint32_t ParticleEmitterHandle;
+
+typedef struct ParticleEmitter {
+    glm::vec3 position;
+    // Radius of the sphere particles spawn in
+    float positionSpread;
+    glm::vec3 velocity;
+    // Magnitude of the random velocity added to every particle
+    float velocitySpread;
+    glm::vec4 colorStart;
+    glm::vec4 colorEnd;
+    float lifetime;
+    float lifetimeSpread;
+    float size;
+    // Particles per second
+    float rate;
+} ParticleEmitter;
+
+typedef struct ParticleSystemConfig {
+    uint32_t capacity = 256 * 1024;
+    bool sort = true;
+    glm::vec3 gravity = glm::vec3(0.0f, 0.0f, 0.0f);
+} ParticleSystemConfig;
+
+typedef struct ParticleSystemStats {
+    uint32_t capacity;
+    uint32_t emitterCount;
+    // Read back from the GPU with MAX_FRAMES_IN_FLIGHT frames of latency
+    uint32_t aliveCount;
+    uint32_t emittedCount;
+    uint64_t requestedParticles;
+} ParticleSystemStats;
+
+enum ParticlePipeline {
+    PARTICLE_PIPELINE_RESET,
+    PARTICLE_PIPELINE_PREPARE,
+    PARTICLE_PIPELINE_EMIT,
+    PARTICLE_PIPELINE_SIMULATE,
+    PARTICLE_PIPELINE_FINALIZE,
+    PARTICLE_PIPELINE_SORT_LOCAL,
+    PARTICLE_PIPELINE_SORT_GLOBAL,
+    PARTICLE_PIPELINE_DRAW,
+    PARTICLE_PIPELINE_COUNT
+};
+
+// GPU resident particles. The CPU only writes the emitter parameters of a frame, emission, simulation, compaction
+// of dead particles into a free list and the back to front bitonic sort all run in compute shaders, and the draw
+// takes its instance count from the GPU through vkCmdDrawIndirect. Dispatch sizes are derived on the GPU as well,
+// so nothing ever waits for the alive count.
+class ParticleSystem {
+public:
+    ParticleSystem() = default;
+
+    // renderPass is VK_NULL_HANDLE when dynamic rendering is used. A second queue family in queueFamilyIndices means
+    // that simulation and sort are recorded on a compute queue, ordered against the draws by semaphores.
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    ShaderLibrary &shaderLibrary, PipelineCache &pipelineCache,
+                    DescriptorLayoutCache &descriptorLayoutCache, VkFormat colorFormat, VkRenderPass renderPass,
+                    const std::vector<uint32_t> &queueFamilyIndices, const ParticleSystemConfig &config);
+
+    void destroy();
+
+    ParticleEmitterHandle addEmitter(const ParticleEmitter &emitter);
+
+    void updateEmitter(ParticleEmitterHandle handle, const ParticleEmitter &emitter);
+
+    void removeEmitter(ParticleEmitterHandle handle);
+
+    // Accumulates the particles the emitters spawn over deltaSeconds
+    void update(float deltaSeconds);
+
+    // Nothing is recorded until the first emitter was added
+    bool isActive() const { return active; }
+
+    bool isSortEnabled() const { return config.sort; }
+
+    void beginFrame(uint64_t frameNumber);
+
+    // Emission, simulation and compaction, recorded outside of a render pass
+    void recordSimulation(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4 &viewProjection);
+
+    void recordSort(VkCommandBuffer commandBuffer);
+
+    // Inside the render pass, after recordSimulation() and the optional recordSort()
+    void recordDraw(VkCommandBuffer commandBuffer);
+
+    void onShaderReloaded(const std::string &shaderName);
+
+    const ParticleSystemStats &getStats() const { return stats; }
+
+private:
+    typedef struct EmitterSlot {
+        ParticleEmitter emitter;
+        float pendingParticles;
+        bool used;
+    } EmitterSlot;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    ShaderLibrary *shaderLibrary = nullptr;
+    PipelineCache *pipelineCache = nullptr;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    std::vector<uint32_t> queueFamilyIndices;
+    bool asyncCompute = false;
+    ParticleSystemConfig config;
+    uint32_t sortCapacity = 0;
+    bool active = false;
+    bool resetPending = true;
+    uint32_t parity = 0;
+    float deltaSeconds = 0.0f;
+    uint32_t emitRequested = 0;
+
+    Buffer particleBuffer;
+    Buffer aliveBuffer;
+    Buffer deadBuffer;
+    Buffer stateBuffer;
+    Buffer drawListBuffer;
+    // One region of MAX_PARTICLE_EMITTERS per frame in flight, selected with a dynamic offset
+    Buffer emitterBuffer;
+    VkDeviceSize emitterRegionSize = 0;
+    Buffer readbackBuffer;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::array<PipelineVariants, PARTICLE_PIPELINE_COUNT> pipelines;
+
+    std::vector<EmitterSlot> emitters;
+    uint32_t emitterCount = 0;
+    uint32_t emitterOffset = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    ParticleSystemStats stats{};
+
+    void createBuffers();
+
+    void createDescriptors(DescriptorLayoutCache &descriptorLayoutCache);
+
+    VkPipeline buildComputePipeline(ParticlePipeline pipeline);
+
+    VkPipeline buildDrawPipeline();
+
+    void dispatch(VkCommandBuffer commandBuffer, ParticlePipeline pipeline, uint32_t groupCount);
+
+    void dispatchIndirect(VkCommandBuffer commandBuffer, ParticlePipeline pipeline, VkDeviceSize argumentOffset,
+                          uint32_t sortBlock = 0, uint32_t sortStep = 0);
+
+    void pushConstants(VkCommandBuffer commandBuffer, uint32_t sortBlock, uint32_t sortStep);
+
+    void computeBarrier(VkCommandBuffer commandBuffer) const;
+};
@@ -0,0 +1,287 @@
+#include "physical_device_selector.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include "vulkan.h"
+
+static constexpr uint32_t CACHE_VERSION = 1;
+static constexpr VkDeviceSize GIBIBYTE = 1024ull * 1024 * 1024;
+// VRAM only counts up to this size, beyond it other capabilities matter more
+static constexpr VkDeviceSize MAX_SCORED_MEMORY = 16 * GIBIBYTE;
+
+static uint32_t getDeviceTypeScore(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return 10000;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return 6000;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return 4000;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return 2000;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t getScore(const PhysicalDeviceCandidate &candidate) {
+    uint32_t score = getDeviceTypeScore(candidate.device.properties.deviceType);
+    score += static_cast<uint32_t>(std::min(candidate.deviceLocalBytes, MAX_SCORED_MEMORY) * 250 / GIBIBYTE);
+    score += candidate.dedicatedComputeQueue ? 1000 : 0;
+    score += candidate.dedicatedTransferQueue ? 1000 : 0;
+    score += candidate.descriptorIndexing ? 1000 : 0;
+    score += candidate.dynamicRendering ? 500 : 0;
+    score += candidate.memoryBudget ? 200 : 0;
+    return score;
+}
+
+PhysicalDevice PhysicalDeviceSelector::select(VkInstance instance, VkSurfaceKHR surface,
+                                              const PhysicalDeviceSelectorConfig &config) {
+    uint32_t count;
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &count, nullptr))
+    std::vector<VkPhysicalDevice> handles(count);
+    VK_CHECK(vkEnumeratePhysicalDevices(instance, &count, handles.data()))
+
+    std::vector<PhysicalDevice> devices;
+    for (const auto &handle: handles) {
+        PhysicalDevice device = {.vkPhysicalDevice = handle};
+        vkGetPhysicalDeviceProperties(handle, &device.properties);
+        devices.push_back(device);
+    }
+
+    candidates.clear();
+    fromCache = false;
+
+    if (auto preferred = findPreferred(devices, config.preferredDevice)) {
+        auto candidate = evaluate(preferred->vkPhysicalDevice, surface, config);
+        if (candidate.rejection.empty()) {
+            candidate.device.score = getScore(candidate);
+            candidates.push_back(candidate);
+            return candidate.device;
+        }
+        std::cout << std::format("Ignoring preferred physical device {}: {}", preferred->properties.deviceName,
+                                 candidate.rejection) << std::endl;
+    } else if (!config.preferredDevice.empty()) {
+        std::cout << std::format("Preferred physical device not found: {}", config.preferredDevice) << std::endl;
+    }
+
+    if (auto cached = loadCached(devices, config)) {
+        if (surface == VK_NULL_HANDLE || isPresentSupported(cached->vkPhysicalDevice, surface)) {
+            fromCache = true;
+            return *cached;
+        }
+    }
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+        auto candidate = evaluate(devices[i].vkPhysicalDevice, surface, config);
+        const auto &properties = candidate.device.properties;
+        if (candidate.rejection.empty()) {
+            candidate.device.score = getScore(candidate);
+            std::cout << std::format("Physical device {}: {} ({}, {:.1f} GiB, {} compute queue, {} transfer queue) "
+                                     "score {}", i, properties.deviceName,
+                                     string_VkPhysicalDeviceType(properties.deviceType),
+                                     static_cast<double>(candidate.deviceLocalBytes) / GIBIBYTE,
+                                     candidate.dedicatedComputeQueue ? "dedicated" : "shared",
+                                     candidate.dedicatedTransferQueue ? "dedicated" : "shared",
+                                     candidate.device.score) << std::endl;
+        } else {
+            std::cout << std::format("Physical device {}: {} rejected, {}", i, properties.deviceName,
+                                     candidate.rejection) << std::endl;
+        }
+        candidates.push_back(candidate);
+    }
+
+    // Ties keep the enumeration order, which drivers usually sort by preference
+    size_t best = candidates.size();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates[i].rejection.empty() &&
+            (best == candidates.size() || candidates[i].device.score > candidates[best].device.score)) {
+            best = i;
+        }
+    }
+
+    if (best == candidates.size()) {
+        throw std::runtime_error(std::format("No usable physical device among {}", devices.size()));
+    }
+
+    saveCached(devices, best, config);
+    return candidates[best].device;
+}
+
+bool PhysicalDeviceSelector::isPresentSupported(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+    for (uint32_t i = 0; i < count; ++i) {
+        VkBool32 supported = VK_FALSE;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supported))
+        if (supported) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PhysicalDeviceSelector::isDescriptorIndexingSupported(
+        const VkPhysicalDeviceFeatures &features, const VkPhysicalDeviceDescriptorIndexingFeatures &indexingFeatures) {
+    // Draws index the arrays with push constants, which is dynamic indexing on top of the non-uniform support
+    return features.shaderSampledImageArrayDynamicIndexing &&
+           indexingFeatures.runtimeDescriptorArray &&
+           indexingFeatures.descriptorBindingPartiallyBound &&
+           indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+           indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+           indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+           indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+}
+
+PhysicalDeviceCandidate PhysicalDeviceSelector::evaluate(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                                         const PhysicalDeviceSelectorConfig &config) {
+    PhysicalDeviceCandidate candidate{};
+    candidate.device.vkPhysicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &candidate.device.properties);
+    auto apiVersion = candidate.device.properties.apiVersion;
+
+    uint32_t extensionCount = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr))
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()))
+    auto hasExtension = [&extensions](const char *name) {
+        return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties &extension) {
+            return strcmp(extension.extensionName, name) == 0;
+        });
+    };
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    bool graphics = false;
+    for (const auto &family: families) {
+        auto flags = family.queueFlags;
+        graphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        candidate.dedicatedComputeQueue |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        candidate.dedicatedTransferQueue |= (flags & VK_QUEUE_TRANSFER_BIT) &&
+                                            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        const auto &heap = memoryProperties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            candidate.deviceLocalBytes = std::max(candidate.deviceLocalBytes, heap.size);
+        }
+    }
+
+    // Checked in order of cost, the surface query is the slowest
+    if (apiVersion < VK_API_VERSION_1_1) {
+        candidate.rejection = "Vulkan 1.1 is unsupported";
+    } else if (!graphics) {
+        candidate.rejection = "no graphics queue";
+    } else if (config.requireSwapChain && !hasExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+        candidate.rejection = std::format("{} is unsupported", VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    } else if (surface != VK_NULL_HANDLE && !isPresentSupported(physicalDevice, surface)) {
+        candidate.rejection = "unable to present to the window";
+    }
+    if (!candidate.rejection.empty()) {
+        return candidate;
+    }
+
+    // Feature structures are only chained when the device knows them
+    bool indexingAvailable = std::min(config.instanceApiVersion, apiVersion) >= VK_API_VERSION_1_2 ||
+                             hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    bool dynamicRenderingAvailable = apiVersion >= VK_API_VERSION_1_3 ||
+                                     hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES};
+    VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    if (indexingAvailable) {
+        indexingFeatures.pNext = features.pNext;
+        features.pNext = &indexingFeatures;
+    }
+    if (dynamicRenderingAvailable) {
+        dynamicRenderingFeatures.pNext = features.pNext;
+        features.pNext = &dynamicRenderingFeatures;
+    }
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    candidate.descriptorIndexing = indexingAvailable &&
+                                   isDescriptorIndexingSupported(features.features, indexingFeatures);
+    candidate.dynamicRendering = dynamicRenderingAvailable && dynamicRenderingFeatures.dynamicRendering;
+    candidate.memoryBudget = hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    return candidate;
+}
+
+std::string PhysicalDeviceSelector::getCacheKey(const std::vector<PhysicalDevice> &devices) {
+    std::string key = std::format("{}", CACHE_VERSION);
+    for (const auto &device: devices) {
+        const auto &properties = device.properties;
+        key += std::format(" {:x}:{:x}:{:x}", properties.vendorID, properties.deviceID, properties.driverVersion);
+    }
+
+    return key;
+}
+
+const PhysicalDevice *PhysicalDeviceSelector::findPreferred(const std::vector<PhysicalDevice> &devices,
+                                                            const std::string &preferredDevice) {
+    if (preferredDevice.empty()) {
+        return nullptr;
+    }
+
+    // Numbers too large for an index are matched against the names like any other text
+    size_t index;
+    auto end = preferredDevice.data() + preferredDevice.size();
+    auto [last, error] = std::from_chars(preferredDevice.data(), end, index);
+    if (error == std::errc() && last == end) {
+        return index < devices.size() ? &devices[index] : nullptr;
+    }
+
+    for (const auto &device: devices) {
+        if (std::string(device.properties.deviceName).find(preferredDevice) != std::string::npos) {
+            return &device;
+        }
+    }
+
+    return nullptr;
+}
+
+const PhysicalDevice *PhysicalDeviceSelector::loadCached(const std::vector<PhysicalDevice> &devices,
+                                                         const PhysicalDeviceSelectorConfig &config) {
+    if (config.cacheFile.empty()) {
+        return nullptr;
+    }
+
+    std::ifstream file(config.cacheFile);
+    std::string key;
+    bool requireSwapChain;
+    size_t index;
+    if (!std::getline(file, key) || !(file >> requireSwapChain >> index)) {
+        return nullptr;
+    }
+
+    // A different driver version or device list invalidates the choice
+    if (key != getCacheKey(devices) || requireSwapChain != config.requireSwapChain || index >= devices.size()) {
+        return nullptr;
+    }
+
+    return &devices[index];
+}
+
+void PhysicalDeviceSelector::saveCached(const std::vector<PhysicalDevice> &devices, size_t index,
+                                        const PhysicalDeviceSelectorConfig &config) {
+    if (config.cacheFile.empty()) {
+        return;
+    }
+
+    std::ofstream file(config.cacheFile, std::ios::trunc);
+    file << getCacheKey(devices) << "\n" << config.requireSwapChain << " " << index << "\n";
+    if (!file) {
+        std::cerr << "Unable to write physical device cache: " << config.cacheFile << std::endl;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+typedef struct PhysicalDevice {
+    VkPhysicalDevice vkPhysicalDevice;
+    VkPhysicalDeviceProperties properties;
+    uint32_t score;
+} PhysicalDevice;
+
+typedef struct PhysicalDeviceSelectorConfig {
+    // Index in enumeration order or a case sensitive part of the device name, empty to pick the best scored device
+    std::string preferredDevice;
+    // Stores the selection together with the driver versions it was made for, empty to always score
+    std::string cacheFile = "physical_device_cache.txt";
+    bool requireSwapChain = true;
+    // Version the instance was created with, device features of a newer core version are not usable beyond it
+    uint32_t instanceApiVersion = VK_API_VERSION_1_1;
+} PhysicalDeviceSelectorConfig;
+
+typedef struct PhysicalDeviceCandidate {
+    PhysicalDevice device;
+    // Largest device local heap
+    VkDeviceSize deviceLocalBytes;
+    bool dedicatedComputeQueue;
+    bool dedicatedTransferQueue;
+    bool descriptorIndexing;
+    bool dynamicRendering;
+    bool memoryBudget;
+    // Empty when the device is usable
+    std::string rejection;
+} PhysicalDeviceCandidate;
+
+// Ranks the physical devices by what the renderer benefits from: device type, VRAM, queue families that let
+// transfers and compute overlap with graphics, and optional features. Devices missing a requirement are never
+// chosen. The choice is cached per set of devices and driver versions, so later startups skip the capability
+// queries until a driver update or a GPU change.
+class PhysicalDeviceSelector {
+public:
+    PhysicalDeviceSelector() = default;
+
+    // surface is VK_NULL_HANDLE while it is not created yet, present support is then left to isPresentSupported()
+    PhysicalDevice select(VkInstance instance, VkSurfaceKHR surface, const PhysicalDeviceSelectorConfig &config);
+
+    static bool isPresentSupported(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+
+    // Everything the bindless path enables, so that a device is never preferred for features the renderer refuses
+    static bool isDescriptorIndexingSupported(const VkPhysicalDeviceFeatures &features,
+                                              const VkPhysicalDeviceDescriptorIndexingFeatures &indexingFeatures);
+
+    // Filled by the last select() that scored the devices, empty when the cached choice was used
+    const std::vector<PhysicalDeviceCandidate> &getCandidates() const { return candidates; }
+
+    bool isFromCache() const { return fromCache; }
+
+private:
+    std::vector<PhysicalDeviceCandidate> candidates;
+    bool fromCache = false;
+
+    static PhysicalDeviceCandidate evaluate(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface,
+                                            const PhysicalDeviceSelectorConfig &config);
+
+    static std::string getCacheKey(const std::vector<PhysicalDevice> &devices);
+
+    static const PhysicalDevice *findPreferred(const std::vector<PhysicalDevice> &devices,
+                                               const std::string &preferredDevice);
+
+    static const PhysicalDevice *loadCached(const std::vector<PhysicalDevice> &devices,
+                                            const PhysicalDeviceSelectorConfig &config);
+
+    static void saveCached(const std::vector<PhysicalDevice> &devices, size_t index,
+                           const PhysicalDeviceSelectorConfig &config);
+};
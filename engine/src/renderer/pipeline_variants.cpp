@@ -0,0 +1,138 @@
+#include "pipeline_variants.h"
+#include <chrono>
+#include <cstddef>
+
+void PipelineVariants::initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                                  ShaderFeatures supportedFeatures, PipelineVariantBuilder builder) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->supportedFeatures = supportedFeatures;
+    this->builder = std::move(builder);
+}
+
+void PipelineVariants::destroy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &[key, pipeline]: variants) {
+        vkDestroyPipeline(device, pipeline, allocationCallbacks);
+    }
+    for (auto &[key, pipeline]: rebuiltVariants) {
+        vkDestroyPipeline(device, pipeline, allocationCallbacks);
+    }
+    for (auto &retired: retiredPipelines) {
+        vkDestroyPipeline(device, retired.pipeline, allocationCallbacks);
+    }
+
+    variants.clear();
+    rebuiltVariants.clear();
+    retiredPipelines.clear();
+}
+
+VkPipeline PipelineVariants::get(ShaderFeatures features) {
+    return find(features & supportedFeatures);
+}
+
+VkPipeline PipelineVariants::getUber() {
+    return find(UBER_VARIANT_KEY);
+}
+
+void PipelineVariants::rebuild() {
+    std::vector<uint64_t> keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &[key, pipeline]: variants) {
+            keys.push_back(key);
+        }
+    }
+
+    std::unordered_map<uint64_t, VkPipeline> rebuilt;
+    try {
+        for (auto key: keys) {
+            rebuilt[key] = build(key);
+        }
+    } catch (...) {
+        for (auto &[key, pipeline]: rebuilt) {
+            vkDestroyPipeline(device, pipeline, allocationCallbacks);
+        }
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // A previous rebuild which was not installed yet was never used by a frame
+    for (auto &[key, pipeline]: rebuiltVariants) {
+        vkDestroyPipeline(device, pipeline, allocationCallbacks);
+    }
+    rebuiltVariants = std::move(rebuilt);
+}
+
+void PipelineVariants::beginFrame(uint64_t frameNumber) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!rebuiltVariants.empty()) {
+        // Variants requested after the rebuild started are dropped here and built again with the new shaders
+        for (auto &[key, pipeline]: variants) {
+            retiredPipelines.push_back({.pipeline = pipeline, .frameNumber = frameNumber});
+        }
+        variants = std::move(rebuiltVariants);
+        rebuiltVariants.clear();
+        stats.variantCount = variants.size();
+    }
+
+    std::erase_if(retiredPipelines, [this, frameNumber](const RetiredPipeline &retired) {
+        if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+            return false;
+        }
+
+        vkDestroyPipeline(device, retired.pipeline, allocationCallbacks);
+        return true;
+    });
+}
+
+PipelineVariantStats PipelineVariants::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+VkPipeline PipelineVariants::find(uint64_t key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.requests++;
+        auto variant = variants.find(key);
+        if (variant != variants.end()) {
+            return variant->second;
+        }
+    }
+
+    // Only the render thread adds variants, so nothing else can insert the same key while the lock is released
+    auto pipeline = build(key);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    variants[key] = pipeline;
+    stats.variantCount = variants.size();
+    return pipeline;
+}
+
+VkPipeline PipelineVariants::build(uint64_t key) {
+    ShaderSpecialization specialization = {
+            .specialized = (key & UBER_VARIANT_KEY) ? VK_FALSE : VK_TRUE,
+            .features = static_cast<ShaderFeatures>(key),
+    };
+
+    VkSpecializationMapEntry entries[] = {
+            {.constantID = 0, .offset = offsetof(ShaderSpecialization, specialized), .size = sizeof(VkBool32)},
+            {.constantID = 1, .offset = offsetof(ShaderSpecialization, features), .size = sizeof(ShaderFeatures)},
+    };
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 2;
+    specializationInfo.pMapEntries = entries;
+    specializationInfo.dataSize = sizeof(specialization);
+    specializationInfo.pData = &specialization;
+
+    auto start = std::chrono::steady_clock::now();
+    auto pipeline = builder(specializationInfo);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.builds++;
+    stats.buildMilliseconds += elapsed.count();
+    return pipeline;
+}
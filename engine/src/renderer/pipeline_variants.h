@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_types.h"
+
+// Specialization constants of every variant, they match the constant_id declarations in the shaders
+typedef struct ShaderSpecialization {
+    VkBool32 specialized;
+    ShaderFeatures features;
+} ShaderSpecialization;
+
+typedef std::function<VkPipeline(const VkSpecializationInfo &specialization)> PipelineVariantBuilder;
+
+typedef struct PipelineVariantStats {
+    uint32_t variantCount;
+    uint64_t requests;
+    uint64_t builds;
+    double buildMilliseconds;
+} PipelineVariantStats;
+
+// Lazily builds one pipeline per distinct feature set, with the features folded in as specialization constants so
+// that the shaders run without feature branches. Requests are deduplicated on the supported feature bits. The uber
+// variant reads the features from the push constants instead and serves as the reference path.
+class PipelineVariants {
+public:
+    PipelineVariants() = default;
+
+    void initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    ShaderFeatures supportedFeatures, PipelineVariantBuilder builder);
+
+    void destroy();
+
+    VkPipeline get(ShaderFeatures features);
+
+    VkPipeline getUber();
+
+    // Builds a new pipeline for every existing variant, for example after a shader changed. May be called from any
+    // thread, the results are installed by the next beginFrame().
+    void rebuild();
+
+    // Installs rebuilt variants and destroys retired ones once no frame in flight can still use them
+    void beginFrame(uint64_t frameNumber);
+
+    PipelineVariantStats getStats() const;
+
+private:
+    typedef struct RetiredPipeline {
+        VkPipeline pipeline;
+        uint64_t frameNumber;
+    } RetiredPipeline;
+
+    // Keys are the feature bits, the uber variant uses a bit outside of them
+    static constexpr uint64_t UBER_VARIANT_KEY = 1ull << 32;
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    ShaderFeatures supportedFeatures = 0;
+    PipelineVariantBuilder builder;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, VkPipeline> variants;
+    std::unordered_map<uint64_t, VkPipeline> rebuiltVariants;
+    std::vector<RetiredPipeline> retiredPipelines;
+    PipelineVariantStats stats{};
+
+    VkPipeline find(uint64_t key);
+
+    VkPipeline build(uint64_t key);
+};
@@ -0,0 +1,599 @@
+#include "render_graph.h"
+#include <algorithm>
+#include <format>
+#include "vulkan.h"
+
+static constexpr uint32_t NO_PASS = UINT32_MAX;
+
+typedef struct UsageState {
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageLayout layout;
+} UsageState;
+
+static UsageState getUsageState(RenderResourceUsage usage, bool write) {
+    switch (usage) {
+        case RENDER_RESOURCE_USAGE_COLOR_ATTACHMENT:
+            return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0u),
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        case RENDER_RESOURCE_USAGE_DEPTH_ATTACHMENT:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    (write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0u),
+                    write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                          : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        case RENDER_RESOURCE_USAGE_SAMPLED:
+            return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case RENDER_RESOURCE_USAGE_STORAGE_READ:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        case RENDER_RESOURCE_USAGE_STORAGE_WRITE:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        case RENDER_RESOURCE_USAGE_TRANSFER_SRC:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        case RENDER_RESOURCE_USAGE_TRANSFER_DST:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+        case RENDER_RESOURCE_USAGE_PRESENT:
+            return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+        case RENDER_RESOURCE_USAGE_UNDEFINED:
+        default:
+            return {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+    }
+}
+
+RenderPassBuilder &RenderPassBuilder::read(RenderResource resource, RenderResourceUsage usage) {
+    graph.passes[pass].uses.push_back({.resource = resource, .usage = usage, .write = false});
+    return *this;
+}
+
+RenderPassBuilder &RenderPassBuilder::write(RenderResource resource, RenderResourceUsage usage) {
+    graph.passes[pass].uses.push_back({.resource = resource, .usage = usage, .write = true});
+    return *this;
+}
+
+RenderPassBuilder &RenderPassBuilder::sideEffects() {
+    graph.passes[pass].sideEffects = true;
+    return *this;
+}
+
+RenderPassBuilder &RenderPassBuilder::splitSubmission() {
+    graph.passes[pass].splitSubmission = true;
+    return *this;
+}
+
+void RenderGraph::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                             const VkAllocationCallbacks *allocationCallbacks) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+}
+
+void RenderGraph::destroy() {
+    destroyTransients(transients);
+    for (auto &retired: retiredTransients) {
+        destroyTransients(retired);
+    }
+    retiredTransients.clear();
+}
+
+void RenderGraph::reset() {
+    passes.clear();
+    resources.clear();
+    finalBarriers.clear();
+}
+
+RenderResource RenderGraph::importImage(const char *name, VkImage image, VkImageView imageView, VkFormat format,
+                                        VkExtent2D extent, VkImageLayout initialLayout,
+                                        VkPipelineStageFlags initialStage, RenderResourceUsage finalUsage) {
+    resources.push_back({
+                                .name = name,
+                                .imported = true,
+                                .description = {format, extent, 0, VK_IMAGE_ASPECT_COLOR_BIT},
+                                .image = image,
+                                .imageView = imageView,
+                                .initialLayout = initialLayout,
+                                .initialStage = initialStage,
+                                .finalUsage = finalUsage,
+                        });
+    return resources.size() - 1;
+}
+
+RenderResource RenderGraph::createImage(const char *name, const RenderImageDescription &description) {
+    resources.push_back({
+                                .name = name,
+                                .imported = false,
+                                .description = description,
+                                .image = VK_NULL_HANDLE,
+                                .imageView = VK_NULL_HANDLE,
+                                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                                .initialStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                .finalUsage = RENDER_RESOURCE_USAGE_UNDEFINED,
+                        });
+    return resources.size() - 1;
+}
+
+RenderPassBuilder RenderGraph::addPass(const char *name, RenderPassCallback execute) {
+    passes.push_back({.name = name, .execute = std::move(execute), .sideEffects = false, .splitSubmission = false,
+                      .culled = false});
+    return {*this, static_cast<uint32_t>(passes.size() - 1)};
+}
+
+void RenderGraph::compile(uint64_t frameNumber) {
+    cullPasses();
+    computeLifetimes();
+    allocateTransients(frameNumber);
+    computeBarriers();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    execute(commandBuffer, commandBuffer);
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, VkCommandBuffer splitCommandBuffer) {
+    for (auto &pass: passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        if (pass.splitSubmission) {
+            commandBuffer = splitCommandBuffer;
+        }
+
+        recordBarriers(commandBuffer, pass.barriers);
+        pass.execute(commandBuffer, *this);
+    }
+
+    recordBarriers(commandBuffer, finalBarriers);
+}
+
+VkImage RenderGraph::getImage(RenderResource resource) const {
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderResource resource) const {
+    return resources[resource].imageView;
+}
+
+VkExtent2D RenderGraph::getExtent(RenderResource resource) const {
+    return resources[resource].description.extent;
+}
+
+VkFormat RenderGraph::getFormat(RenderResource resource) const {
+    return resources[resource].description.format;
+}
+
+void RenderGraph::enableSynchronization2(PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2) {
+    this->cmdPipelineBarrier2 = cmdPipelineBarrier2;
+}
+
+void RenderGraph::cullPasses() {
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); ++i) {
+        needed[i] = resources[i].imported && resources[i].finalUsage != RENDER_RESOURCE_USAGE_UNDEFINED;
+    }
+
+    // Walk backwards so every pass sees whether a later, surviving pass consumes what it writes
+    for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+        bool contributes = pass->sideEffects;
+        for (const auto &use: pass->uses) {
+            contributes |= use.write && needed[use.resource];
+        }
+
+        pass->culled = !contributes;
+        if (pass->culled) {
+            continue;
+        }
+
+        for (const auto &use: pass->uses) {
+            if (!use.write) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (auto &resource: resources) {
+        resource.firstPass = NO_PASS;
+        resource.lastPass = 0;
+    }
+
+    for (uint32_t i = 0; i < passes.size(); ++i) {
+        if (passes[i].culled) {
+            continue;
+        }
+
+        for (const auto &use: passes[i].uses) {
+            auto &resource = resources[use.resource];
+            resource.firstPass = std::min(resource.firstPass, i);
+            resource.lastPass = std::max(resource.lastPass, i);
+        }
+    }
+}
+
+void RenderGraph::computeBarriers() {
+    typedef struct TrackedState {
+        VkImageLayout layout;
+        VkPipelineStageFlags stage;
+        VkAccessFlags access;
+        bool written;
+    } TrackedState;
+
+    std::vector<TrackedState> states;
+    for (const auto &resource: resources) {
+        // Transient memory may still be in use by the previous frame or by an aliased image, hence the full wait
+        states.push_back({
+                                 .layout = resource.initialLayout,
+                                 .stage = resource.initialStage,
+                                 .access = resource.imported ? 0u : VK_ACCESS_MEMORY_WRITE_BIT,
+                                 .written = !resource.imported,
+                         });
+    }
+
+    auto transition = [&states](RenderResource resource, const UsageState &target, bool write,
+                                std::vector<RenderGraphImageBarrier> &barriers) {
+        auto &state = states[resource];
+        if (state.layout == target.layout && !write && !state.written) {
+            // Read after read only has to extend the stages a later writer waits for
+            state.stage |= target.stage;
+            return;
+        }
+
+        barriers.push_back({
+                                   .resource = resource,
+                                   .srcStage = state.stage,
+                                   .srcAccess = state.written ? state.access : 0u,
+                                   .oldLayout = state.layout,
+                                   .dstStage = target.stage,
+                                   .dstAccess = target.access,
+                                   .newLayout = target.layout,
+                           });
+        state = {target.layout, target.stage, target.access, write};
+    };
+
+    for (auto &pass: passes) {
+        pass.barriers.clear();
+        if (pass.culled) {
+            continue;
+        }
+
+        // A resource used more than once by the same pass gets a single merged transition
+        std::vector<RenderResource> seen;
+        for (const auto &use: pass.uses) {
+            if (std::find(seen.begin(), seen.end(), use.resource) != seen.end()) {
+                continue;
+            }
+            seen.push_back(use.resource);
+
+            bool write = false;
+            UsageState target{0, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+            for (const auto &other: pass.uses) {
+                if (other.resource != use.resource) {
+                    continue;
+                }
+
+                auto state = getUsageState(other.usage, other.write);
+                target.stage |= state.stage;
+                target.access |= state.access;
+                if (other.write || target.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+                    target.layout = state.layout;
+                }
+                write |= other.write;
+            }
+
+            transition(use.resource, target, write, pass.barriers);
+        }
+    }
+
+    finalBarriers.clear();
+    for (RenderResource i = 0; i < resources.size(); ++i) {
+        if (resources[i].imported && resources[i].finalUsage != RENDER_RESOURCE_USAGE_UNDEFINED) {
+            transition(i, getUsageState(resources[i].finalUsage, false), false, finalBarriers);
+        }
+    }
+}
+
+void RenderGraph::allocateTransients(uint64_t frameNumber) {
+    std::erase_if(retiredTransients, [this, frameNumber](TransientAllocation &retired) {
+        if (retired.retiredFrame + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+            return false;
+        }
+        destroyTransients(retired);
+        return true;
+    });
+
+    std::vector<RenderResource> transientResources;
+    for (RenderResource i = 0; i < resources.size(); ++i) {
+        if (!resources[i].imported && resources[i].firstPass != NO_PASS) {
+            transientResources.push_back(i);
+        }
+    }
+
+    auto shapeHash = computeShapeHash();
+    shapeChanged = shapeHash != transients.shapeHash;
+
+    if (shapeChanged) {
+        if (!transients.images.empty()) {
+            transients.retiredFrame = frameNumber;
+            retiredTransients.push_back(std::move(transients));
+        }
+        transients = TransientAllocation{};
+        transients.shapeHash = shapeHash;
+
+        std::vector<VkMemoryRequirements> requirements;
+        uint32_t memoryTypeBits = UINT32_MAX;
+        for (auto index: transientResources) {
+            auto &resource = resources[index];
+            const auto &description = resource.description;
+
+            VkImageCreateInfo createInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+            createInfo.imageType = VK_IMAGE_TYPE_2D;
+            createInfo.format = description.format;
+            createInfo.extent = {description.extent.width, description.extent.height, 1};
+            createInfo.mipLevels = 1;
+            createInfo.arrayLayers = 1;
+            createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            createInfo.usage = description.usage;
+            createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkImage image;
+            VK_CHECK(vkCreateImage(device, &createInfo, allocationCallbacks, &image))
+            transients.images.push_back({image, VK_NULL_HANDLE, 0, 0});
+
+            VkMemoryRequirements memoryRequirements;
+            vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+            requirements.push_back(memoryRequirements);
+            memoryTypeBits &= memoryRequirements.memoryTypeBits;
+
+            resource.size = memoryRequirements.size;
+            transients.unaliasedBytes += memoryRequirements.size;
+        }
+
+        // Greedy placement, largest first: each image takes the lowest offset that does not overlap any already
+        // placed image whose pass range intersects its own
+        std::vector<uint32_t> order(transientResources.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&requirements](uint32_t a, uint32_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        bool aliasing = memoryTypeBits != 0;
+        std::vector<uint32_t> placed;
+        VkDeviceSize heapSize = 0;
+        for (auto i: order) {
+            auto &resource = resources[transientResources[i]];
+            auto alignment = requirements[i].alignment;
+            VkDeviceSize offset = 0;
+
+            if (aliasing) {
+                bool moved = true;
+                while (moved) {
+                    moved = false;
+                    for (auto j: placed) {
+                        const auto &other = resources[transientResources[j]];
+                        bool livesTogether = resource.firstPass <= other.lastPass &&
+                                             other.firstPass <= resource.lastPass;
+                        bool overlaps = offset < other.offset + other.size && other.offset < offset + resource.size;
+                        if (livesTogether && overlaps) {
+                            offset = (other.offset + other.size + alignment - 1) / alignment * alignment;
+                            moved = true;
+                        }
+                    }
+                }
+            }
+
+            resource.offset = offset;
+            placed.push_back(i);
+            heapSize = std::max(heapSize, offset + resource.size);
+        }
+
+        if (aliasing && !transientResources.empty()) {
+            VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+            allocateInfo.allocationSize = heapSize;
+            allocateInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryTypeBits,
+                                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            VkDeviceMemory memory;
+            VK_CHECK(vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &memory))
+            transients.memory.push_back(memory);
+            transients.allocatedBytes = heapSize;
+        }
+
+        for (uint32_t i = 0; i < transientResources.size(); ++i) {
+            auto &resource = resources[transientResources[i]];
+            auto &transient = transients.images[i];
+            VkDeviceMemory memory;
+            VkDeviceSize offset = resource.offset;
+
+            if (aliasing) {
+                memory = transients.memory.front();
+            } else {
+                // No memory type suits every image, fall back to one dedicated allocation each
+                VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+                allocateInfo.allocationSize = requirements[i].size;
+                allocateInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements[i].memoryTypeBits,
+                                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                VK_CHECK(vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &memory))
+                transients.memory.push_back(memory);
+                transients.allocatedBytes += requirements[i].size;
+                offset = 0;
+            }
+            VK_CHECK(vkBindImageMemory(device, transient.image, memory, offset))
+            transient.offset = offset;
+            transient.size = resource.size;
+
+            VkImageViewCreateInfo viewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+            viewCreateInfo.image = transient.image;
+            viewCreateInfo.format = resource.description.format;
+            viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewCreateInfo.subresourceRange.aspectMask = resource.description.aspect;
+            viewCreateInfo.subresourceRange.levelCount = 1;
+            viewCreateInfo.subresourceRange.layerCount = 1;
+            VK_CHECK(vkCreateImageView(device, &viewCreateInfo, allocationCallbacks, &transient.imageView))
+        }
+    }
+
+    for (uint32_t i = 0; i < transientResources.size(); ++i) {
+        auto &resource = resources[transientResources[i]];
+        resource.image = transients.images[i].image;
+        resource.imageView = transients.images[i].imageView;
+        resource.offset = transients.images[i].offset;
+        resource.size = transients.images[i].size;
+    }
+}
+
+void RenderGraph::destroyTransients(TransientAllocation &allocation) {
+    for (auto &transient: allocation.images) {
+        vkDestroyImageView(device, transient.imageView, allocationCallbacks);
+        vkDestroyImage(device, transient.image, allocationCallbacks);
+    }
+    allocation.images.clear();
+
+    for (auto &memory: allocation.memory) {
+        vkFreeMemory(device, memory, allocationCallbacks);
+    }
+    allocation.memory.clear();
+}
+
+size_t RenderGraph::computeShapeHash() const {
+    size_t result = 1;
+    auto combine = [&result](size_t value) {
+        result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+    };
+
+    for (const auto &resource: resources) {
+        if (resource.imported || resource.firstPass == NO_PASS) {
+            continue;
+        }
+
+        const auto &description = resource.description;
+        combine(description.format);
+        combine(description.extent.width);
+        combine(description.extent.height);
+        combine(description.usage);
+        combine(description.aspect);
+        combine(resource.firstPass);
+        combine(resource.lastPass);
+    }
+
+    return result;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphImageBarrier> &barriers) {
+    if (barriers.empty()) {
+        return;
+    }
+
+    if (cmdPipelineBarrier2 != nullptr) {
+        recordBarriers2(commandBuffer, barriers);
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    VkPipelineStageFlags srcStage = 0;
+    VkPipelineStageFlags dstStage = 0;
+    for (const auto &barrier: barriers) {
+        const auto &resource = resources[barrier.resource];
+
+        VkImageMemoryBarrier imageBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        imageBarrier.image = resource.image;
+        imageBarrier.srcAccessMask = barrier.srcAccess;
+        imageBarrier.dstAccessMask = barrier.dstAccess;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.subresourceRange.aspectMask = resource.description.aspect;
+        imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        imageBarriers.push_back(imageBarrier);
+
+        srcStage |= barrier.srcStage;
+        dstStage |= barrier.dstStage;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, imageBarriers.size(),
+                         imageBarriers.data());
+}
+
+void RenderGraph::recordBarriers2(VkCommandBuffer commandBuffer,
+                                  const std::vector<RenderGraphImageBarrier> &barriers) {
+    std::vector<VkImageMemoryBarrier2> imageBarriers;
+    for (const auto &barrier: barriers) {
+        const auto &resource = resources[barrier.resource];
+
+        // The synchronization1 stage and access bits keep their values in the 64 bit synchronization2 masks
+        VkImageMemoryBarrier2 imageBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        imageBarrier.image = resource.image;
+        imageBarrier.srcStageMask = barrier.srcStage;
+        imageBarrier.srcAccessMask = barrier.srcAccess;
+        imageBarrier.dstStageMask = barrier.dstStage;
+        imageBarrier.dstAccessMask = barrier.dstAccess;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.subresourceRange.aspectMask = resource.description.aspect;
+        imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        imageBarriers.push_back(imageBarrier);
+    }
+
+    VkDependencyInfo dependencyInfo{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependencyInfo.imageMemoryBarrierCount = imageBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+std::string RenderGraph::dump() const {
+    uint32_t culledCount = std::count_if(passes.begin(), passes.end(), [](const Pass &pass) { return pass.culled; });
+    std::string result = std::format("Render graph: {} passes ({} culled), {} resources\n", passes.size(),
+                                     culledCount, resources.size());
+
+    auto dumpBarrier = [this, &result](const RenderGraphImageBarrier &barrier) {
+        result += std::format("    barrier {}: {} -> {}\n", resources[barrier.resource].name,
+                              string_VkImageLayout(barrier.oldLayout), string_VkImageLayout(barrier.newLayout));
+    };
+
+    for (uint32_t i = 0; i < passes.size(); ++i) {
+        const auto &pass = passes[i];
+        result += std::format("  pass {} \"{}\"{}{}\n", i, pass.name, pass.splitSubmission ? " [split]" : "",
+                              pass.culled ? " [culled]" : "");
+        for (const auto &barrier: pass.barriers) {
+            dumpBarrier(barrier);
+        }
+        for (const auto &use: pass.uses) {
+            result += std::format("    {} {}\n", use.write ? "write" : "read", resources[use.resource].name);
+        }
+    }
+
+    if (!finalBarriers.empty()) {
+        result += "  final\n";
+        for (const auto &barrier: finalBarriers) {
+            dumpBarrier(barrier);
+        }
+    }
+
+    for (const auto &resource: resources) {
+        if (resource.imported || resource.firstPass == NO_PASS) {
+            continue;
+        }
+        result += std::format("  transient {} {}x{} passes [{}, {}] offset {} size {}\n", resource.name,
+                              resource.description.extent.width, resource.description.extent.height,
+                              resource.firstPass, resource.lastPass, resource.offset, resource.size);
+    }
+
+    VkDeviceSize saved = transients.unaliasedBytes - std::min(transients.unaliasedBytes, transients.allocatedBytes);
+    result += std::format("Transient memory: {} KiB unaliased, {} KiB allocated, {} KiB saved by aliasing\n",
+                          transients.unaliasedBytes / 1024, transients.allocatedBytes / 1024, saved / 1024);
+    return result;
+}
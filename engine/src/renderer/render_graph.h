@@ -0,0 +1,188 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+typedef uint32_t RenderResource;
+
+enum RenderResourceUsage {
+    RENDER_RESOURCE_USAGE_UNDEFINED,
+    RENDER_RESOURCE_USAGE_COLOR_ATTACHMENT,
+    RENDER_RESOURCE_USAGE_DEPTH_ATTACHMENT,
+    RENDER_RESOURCE_USAGE_SAMPLED,
+    RENDER_RESOURCE_USAGE_STORAGE_READ,
+    RENDER_RESOURCE_USAGE_STORAGE_WRITE,
+    RENDER_RESOURCE_USAGE_TRANSFER_SRC,
+    RENDER_RESOURCE_USAGE_TRANSFER_DST,
+    RENDER_RESOURCE_USAGE_PRESENT,
+};
+
+typedef struct RenderImageDescription {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+} RenderImageDescription;
+
+typedef struct RenderGraphImageBarrier {
+    RenderResource resource;
+    VkPipelineStageFlags srcStage;
+    VkAccessFlags srcAccess;
+    VkImageLayout oldLayout;
+    VkPipelineStageFlags dstStage;
+    VkAccessFlags dstAccess;
+    VkImageLayout newLayout;
+} RenderGraphImageBarrier;
+
+class RenderGraph;
+
+typedef std::function<void(VkCommandBuffer commandBuffer, const RenderGraph &graph)> RenderPassCallback;
+
+class RenderPassBuilder {
+public:
+    RenderPassBuilder(RenderGraph &graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+    RenderPassBuilder &read(RenderResource resource, RenderResourceUsage usage);
+
+    RenderPassBuilder &write(RenderResource resource, RenderResourceUsage usage);
+
+    // Keeps the pass even if nothing it writes is consumed, e.g. for readbacks or GPU side effects
+    RenderPassBuilder &sideEffects();
+
+    // Records this pass and all following ones into the second command buffer of execute(), so that they can be
+    // submitted behind a semaphore wait while the passes before it already run
+    RenderPassBuilder &splitSubmission();
+
+private:
+    RenderGraph &graph;
+    uint32_t pass;
+};
+
+// Frame graph rebuilt every frame: passes declare what they read and write, compile() culls passes that do not
+// contribute to an output, derives one batched pipeline barrier per pass including all layout transitions, and
+// places transient images into a shared allocation where images with disjoint lifetimes alias the same memory.
+// The transient allocation is kept across frames as long as the graph keeps the same shape.
+class RenderGraph {
+public:
+    RenderGraph() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks);
+
+    void destroy();
+
+    void reset();
+
+    // The image is expected in initialLayout, with pending work in initialStage (e.g. the acquire semaphore wait
+    // stage). After the last pass it is transitioned for finalUsage and counts as a graph output.
+    RenderResource importImage(const char *name, VkImage image, VkImageView imageView, VkFormat format,
+                               VkExtent2D extent, VkImageLayout initialLayout, VkPipelineStageFlags initialStage,
+                               RenderResourceUsage finalUsage);
+
+    RenderResource createImage(const char *name, const RenderImageDescription &description);
+
+    RenderPassBuilder addPass(const char *name, RenderPassCallback execute);
+
+    void compile(uint64_t frameNumber);
+
+    void execute(VkCommandBuffer commandBuffer);
+
+    void execute(VkCommandBuffer commandBuffer, VkCommandBuffer splitCommandBuffer);
+
+    VkImage getImage(RenderResource resource) const;
+
+    VkImageView getImageView(RenderResource resource) const;
+
+    VkExtent2D getExtent(RenderResource resource) const;
+
+    VkFormat getFormat(RenderResource resource) const;
+
+    // Records every barrier with its own stage masks through vkCmdPipelineBarrier2 instead of one merged
+    // synchronization1 barrier per batch
+    void enableSynchronization2(PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2);
+
+    bool hasShapeChanged() const { return shapeChanged; }
+
+    std::string dump() const;
+
+private:
+    friend class RenderPassBuilder;
+
+    typedef struct ResourceUse {
+        RenderResource resource;
+        RenderResourceUsage usage;
+        bool write;
+    } ResourceUse;
+
+    typedef struct Pass {
+        std::string name;
+        RenderPassCallback execute;
+        std::vector<ResourceUse> uses;
+        bool sideEffects;
+        bool splitSubmission;
+        bool culled;
+        std::vector<RenderGraphImageBarrier> barriers;
+    } Pass;
+
+    typedef struct Resource {
+        std::string name;
+        bool imported;
+        RenderImageDescription description;
+        VkImage image;
+        VkImageView imageView;
+        VkImageLayout initialLayout;
+        VkPipelineStageFlags initialStage;
+        RenderResourceUsage finalUsage;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        VkDeviceSize size;
+        VkDeviceSize offset;
+        uint32_t allocation;
+    } Resource;
+
+    typedef struct TransientImage {
+        VkImage image;
+        VkImageView imageView;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    } TransientImage;
+
+    typedef struct TransientAllocation {
+        size_t shapeHash = 0;
+        std::vector<TransientImage> images;
+        std::vector<VkDeviceMemory> memory;
+        VkDeviceSize unaliasedBytes = 0;
+        VkDeviceSize allocatedBytes = 0;
+        uint64_t retiredFrame = 0;
+    } TransientAllocation;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<RenderGraphImageBarrier> finalBarriers;
+
+    TransientAllocation transients;
+    std::vector<TransientAllocation> retiredTransients;
+    bool shapeChanged = false;
+    PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2 = nullptr;
+
+    void cullPasses();
+
+    void computeLifetimes();
+
+    void computeBarriers();
+
+    void allocateTransients(uint64_t frameNumber);
+
+    void destroyTransients(TransientAllocation &allocation);
+
+    size_t computeShapeHash() const;
+
+    void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphImageBarrier> &barriers);
+
+    void recordBarriers2(VkCommandBuffer commandBuffer, const std::vector<RenderGraphImageBarrier> &barriers);
+};
@@ -0,0 +1,173 @@
+#include "scene_instances.h"
+#include <algorithm>
+#include <array>
+#include <format>
+#include "vulkan.h"
+
+// Instances per upload, small enough to fit into the staging ring next to texture uploads
+static constexpr uint32_t SCENE_UPLOAD_CHUNK_INSTANCES = 64 * 1024;
+static constexpr VkDeviceSize SCENE_UPLOAD_FRAME_BUDGET = 16 * 1024 * 1024;
+
+static_assert(sizeof(ObjectData) == sizeof(glm::mat4), "Snapshot transforms are uploaded as ObjectData");
+
+void SceneInstances::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                const VkAllocationCallbacks *allocationCallbacks, UploadQueue &uploadQueue,
+                                VkDescriptorSetLayout setLayout, VkBuffer cameraBuffer, VkDeviceSize cameraRange,
+                                uint32_t windowInstances, const std::vector<uint32_t> &queueFamilyIndices) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->uploadQueue = &uploadQueue;
+    this->setLayout = setLayout;
+    this->cameraBuffer = cameraBuffer;
+    this->cameraRange = cameraRange;
+    this->windowInstances = windowInstances;
+    this->queueFamilyIndices = queueFamilyIndices;
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, allocationCallbacks, &descriptorPool))
+
+    VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet))
+}
+
+void SceneInstances::destroy() {
+    destroyBuffer(device, allocationCallbacks, instanceBuffer);
+    vkDestroyDescriptorPool(device, descriptorPool, allocationCallbacks);
+    snapshot = nullptr;
+}
+
+void SceneInstances::setScene(const SceneSnapshot *snapshot) {
+    destroyBuffer(device, allocationCallbacks, instanceBuffer);
+    drawRanges.clear();
+    stagedInstances = 0;
+    generation++;
+    stats = {};
+
+    this->snapshot = snapshot != nullptr && snapshot->getInstanceCount() > 0 ? snapshot : nullptr;
+    if (this->snapshot == nullptr) {
+        return;
+    }
+
+    // Padded to whole windows, the binding range behind every dynamic offset has to lie inside the buffer
+    auto instanceCount = snapshot->getInstanceCount();
+    VkDeviceSize windowSize = static_cast<VkDeviceSize>(windowInstances) * sizeof(ObjectData);
+    VkDeviceSize windowCount = (instanceCount + windowInstances - 1) / windowInstances;
+    if ((windowCount - 1) * windowSize > UINT32_MAX) {
+        throw std::runtime_error(std::format("Scene has too many instances to draw: {}", instanceCount));
+    }
+
+    instanceBuffer = createBuffer(physicalDevice, device, allocationCallbacks, windowCount * windowSize,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices);
+    writeDescriptorSet();
+
+    const auto &ranges = snapshot->getDrawRanges();
+    drawRanges.assign(ranges.begin(), ranges.end());
+    stats.instanceCount = instanceCount;
+    stats.drawRangeCount = drawRanges.size();
+    uploadStart = std::chrono::steady_clock::now();
+}
+
+void SceneInstances::writeDescriptorSet() {
+    VkDescriptorBufferInfo cameraBufferInfo{cameraBuffer, 0, cameraRange};
+    VkDescriptorBufferInfo objectBufferInfo{instanceBuffer.buffer, 0, windowInstances * sizeof(ObjectData)};
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[0].dstSet = descriptorSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writes[0].pBufferInfo = &cameraBufferInfo;
+
+    writes[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[1].dstSet = descriptorSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    writes[1].pBufferInfo = &objectBufferInfo;
+
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+}
+
+void SceneInstances::update() {
+    if (snapshot == nullptr) {
+        return;
+    }
+
+    auto instanceCount = snapshot->getInstanceCount();
+    auto transforms = snapshot->getInstanceTransforms().data();
+    VkDeviceSize budget = SCENE_UPLOAD_FRAME_BUDGET;
+    while (stagedInstances < instanceCount && budget > 0) {
+        uint32_t count = std::min(instanceCount - stagedInstances, SCENE_UPLOAD_CHUNK_INSTANCES);
+        VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(ObjectData);
+
+        // The copy into staging is the first read of these pages of the mapping. Upload batches retire in order, so
+        // the resident instances are always a prefix of the buffer.
+        auto staged = uploadQueue->uploadBuffer(instanceBuffer.buffer, stagedInstances * sizeof(ObjectData),
+                                                transforms + stagedInstances, size,
+                                                [this, uploadGeneration = generation, count] {
+            if (uploadGeneration != generation) {
+                return;
+            }
+
+            stats.residentInstances += count;
+            if (stats.residentInstances == stats.instanceCount) {
+                std::chrono::duration<double, std::milli> uploadTime = std::chrono::steady_clock::now() - uploadStart;
+                logInfo("scene", "Scene instances resident: {} instances in {} draw ranges, {:.1f} MiB in {:.1f} ms",
+                        stats.instanceCount, stats.drawRangeCount,
+                        stats.instanceCount * sizeof(ObjectData) / (1024.0 * 1024.0), uploadTime.count());
+            }
+        });
+
+        // A full staging ring is tried again next frame
+        if (!staged) {
+            break;
+        }
+
+        stagedInstances += count;
+        budget -= std::min(budget, size);
+    }
+}
+
+void SceneInstances::recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+                                uint32_t cameraOffset, uint32_t vertexCount) {
+    stats.drawCount = 0;
+    if (snapshot == nullptr) {
+        return;
+    }
+
+    uint32_t boundWindow = UINT32_MAX;
+    for (const auto &range: drawRanges) {
+        uint32_t first = range.firstInstance;
+        uint32_t end = std::min(range.firstInstance + range.instanceCount, stats.residentInstances);
+        while (first < end) {
+            uint32_t window = first / windowInstances;
+            uint32_t windowStart = window * windowInstances;
+            uint32_t count = std::min(end, windowStart + windowInstances) - first;
+
+            if (window != boundWindow) {
+                uint32_t dynamicOffsets[] = {cameraOffset, static_cast<uint32_t>(windowStart * sizeof(ObjectData))};
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                        &descriptorSet, 2, dynamicOffsets);
+                boundWindow = window;
+            }
+
+            // gl_InstanceIndex starts at firstInstance, which indexes the instance inside the bound window
+            vkCmdDraw(commandBuffer, vertexCount, count, 0, first - windowStart);
+            stats.drawCount++;
+            first += count;
+        }
+    }
+}
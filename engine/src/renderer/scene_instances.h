@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_buffer.h"
+#include "vulkan_upload.h"
+#include "scene/scene_snapshot.h"
+
+typedef struct SceneInstancesStats {
+    uint32_t instanceCount;
+    // Only uploaded instances are drawn, the rest of the scene appears over the next frames
+    uint32_t residentInstances;
+    uint32_t drawRangeCount;
+    // Instanced draws recorded in the last frame
+    uint32_t drawCount;
+} SceneInstancesStats;
+
+// Draws the instances of a mapped scene snapshot. Their transforms go straight from the mapping into the staging
+// ring of the upload queue, a limited amount per frame, and end up in a device local buffer that a set of the global
+// layout points at instead of the per-frame object ring. Draw ranges are drawn instanced, split at windows of the
+// object binding's range which the dynamic offset moves along the buffer.
+class SceneInstances {
+public:
+    SceneInstances() = default;
+
+    // windowInstances is the number of ObjectData the object binding covers, the camera binding points at the ring
+    // behind cameraBuffer
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    UploadQueue &uploadQueue, VkDescriptorSetLayout setLayout, VkBuffer cameraBuffer,
+                    VkDeviceSize cameraRange, uint32_t windowInstances, const std::vector<uint32_t> &queueFamilyIndices);
+
+    // The device must be idle
+    void destroy();
+
+    // nullptr draws nothing. The snapshot must stay open until it is replaced, the device must be idle.
+    void setScene(const SceneSnapshot *snapshot);
+
+    // Stages the next part of the transforms, must run before the upload queue is flushed
+    void update();
+
+    // Expects a pipeline of the main pass layout and the vertex buffer of the mesh to be bound
+    void recordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t cameraOffset,
+                    uint32_t vertexCount);
+
+    const SceneInstancesStats &getStats() const { return stats; }
+
+private:
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    UploadQueue *uploadQueue = nullptr;
+    VkBuffer cameraBuffer = VK_NULL_HANDLE;
+    VkDeviceSize cameraRange = 0;
+    uint32_t windowInstances = 0;
+    std::vector<uint32_t> queueFamilyIndices;
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    const SceneSnapshot *snapshot = nullptr;
+    Buffer instanceBuffer;
+    std::vector<SceneDrawRange> drawRanges;
+    // Instances handed to the upload queue
+    uint32_t stagedInstances = 0;
+    // Completions of uploads for a previous scene are ignored
+    uint64_t generation = 0;
+    std::chrono::steady_clock::time_point uploadStart;
+    SceneInstancesStats stats{};
+
+    void writeDescriptorSet();
+};
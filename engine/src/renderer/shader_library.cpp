@@ -0,0 +1,394 @@
+#include "shader_library.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+#include "core/file.h"
+
+#ifdef DARK_STAR_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+#if defined(__linux__) && defined(DARK_STAR_SHADERC)
+#define SHADER_HOT_RELOAD_SUPPORTED
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Bumped whenever the compiler setup changes in a way the cache key does not capture
+static constexpr uint64_t SHADER_CACHE_VERSION = 2;
+static constexpr int WATCH_POLL_TIMEOUT_MS = 100;
+static constexpr std::chrono::milliseconds RELOAD_DEBOUNCE(50);
+
+static std::vector<uint32_t> toWords(const std::vector<char> &bytes, const std::string &fileName) {
+    if (bytes.empty() || bytes.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error(std::format("Invalid SPIR-V file: {}", fileName));
+    }
+
+    std::vector<uint32_t> words(bytes.size() / sizeof(uint32_t));
+    memcpy(words.data(), bytes.data(), bytes.size());
+    return words;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#ifdef DARK_STAR_SHADERC
+static constexpr shaderc_optimization_level SHADER_OPTIMIZATION_LEVEL = shaderc_optimization_level_performance;
+
+static shaderc_shader_kind getShaderKind(const std::filesystem::path &path) {
+    static const std::unordered_map<std::string, shaderc_shader_kind> kinds = {
+            {".vert", shaderc_vertex_shader},
+            {".frag", shaderc_fragment_shader},
+            {".comp", shaderc_compute_shader},
+            {".geom", shaderc_geometry_shader},
+            {".tesc", shaderc_tess_control_shader},
+            {".tese", shaderc_tess_evaluation_shader},
+    };
+
+    auto kind = kinds.find(path.extension().string());
+    return kind != kinds.end() ? kind->second : shaderc_glsl_infer_from_source;
+}
+
+// Resolves #include "file" next to the including file first and #include <file> through the search paths only.
+// Every resolved file is added to includedFiles so that the shader can be reloaded when one of them changes.
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+public:
+    ShaderIncluder(const std::vector<std::string> &searchPaths, std::vector<std::string> &includedFiles)
+            : searchPaths(searchPaths), includedFiles(includedFiles) {}
+
+    shaderc_include_result *GetInclude(const char *requestedSource, shaderc_include_type type,
+                                       const char *requestingSource, size_t includeDepth) override {
+        auto include = new Include{};
+        auto path = resolve(requestedSource, type, requestingSource);
+        if (path.empty()) {
+            include->content = std::format("Unable to find include {}", requestedSource);
+        } else {
+            try {
+                auto content = readBinaryFile(path.string());
+                include->sourceName = path.string();
+                include->content.assign(content.begin(), content.end());
+                if (std::find(includedFiles.begin(), includedFiles.end(), include->sourceName) == includedFiles.end()) {
+                    includedFiles.push_back(include->sourceName);
+                }
+            } catch (const std::exception &e) {
+                include->content = e.what();
+            }
+        }
+
+        // An empty source name tells shaderc that the include failed, the content is the error message then
+        include->result.source_name = include->sourceName.c_str();
+        include->result.source_name_length = include->sourceName.size();
+        include->result.content = include->content.c_str();
+        include->result.content_length = include->content.size();
+        include->result.user_data = include;
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result *result) override {
+        delete static_cast<Include *>(result->user_data);
+    }
+
+private:
+    typedef struct Include {
+        std::string sourceName;
+        std::string content;
+        shaderc_include_result result;
+    } Include;
+
+    std::vector<std::string> searchPaths;
+    std::vector<std::string> &includedFiles;
+
+    std::filesystem::path resolve(const char *requestedSource, shaderc_include_type type,
+                                  const char *requestingSource) const {
+        if (type == shaderc_include_type_relative) {
+            auto path = (std::filesystem::path(requestingSource).parent_path() / requestedSource).lexically_normal();
+            if (std::filesystem::exists(path)) {
+                return path;
+            }
+        }
+
+        for (const auto &searchPath: searchPaths) {
+            auto path = (std::filesystem::path(searchPath) / requestedSource).lexically_normal();
+            if (std::filesystem::exists(path)) {
+                return path;
+            }
+        }
+        return {};
+    }
+};
+#endif
+
+void ShaderLibrary::initialize(const ShaderLibraryConfig &config) {
+    this->config = config;
+
+#ifdef SHADER_HOT_RELOAD_SUPPORTED
+    if (this->config.hotReload) {
+        inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyDescriptor < 0) {
+            std::cerr << "Shader hot reload unavailable: " << strerror(errno) << std::endl;
+            this->config.hotReload = false;
+        }
+    }
+#else
+    if (this->config.hotReload) {
+        std::cerr << "Shader hot reload requires shaderc and inotify, it is disabled in this build" << std::endl;
+        this->config.hotReload = false;
+    }
+#endif
+}
+
+void ShaderLibrary::destroy() {
+    watcherRunning = false;
+    if (watcherThread.joinable()) {
+        watcherThread.join();
+    }
+
+    // Loads lock the mutex when they finish, so they have to be awaited without holding it
+    std::unordered_map<std::string, std::shared_future<void>> loads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loads.swap(pendingLoads);
+    }
+    for (auto &[name, pendingLoad]: loads) {
+        pendingLoad.wait();
+    }
+
+#ifdef SHADER_HOT_RELOAD_SUPPORTED
+    if (inotifyDescriptor >= 0) {
+        close(inotifyDescriptor);
+    }
+#endif
+    inotifyDescriptor = -1;
+    watchedDirectories.clear();
+    shaders.clear();
+}
+
+void ShaderLibrary::preload(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (shaders.contains(name) || pendingLoads.contains(name)) {
+        return;
+    }
+
+    pendingLoads.emplace(name, std::async(std::launch::async, &ShaderLibrary::load, this, name).share());
+}
+
+std::vector<uint32_t> ShaderLibrary::getCode(const std::string &name) {
+    preload(name);
+
+    std::shared_future<void> pendingLoad;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto pending = pendingLoads.find(name);
+        if (pending != pendingLoads.end()) {
+            pendingLoad = pending->second;
+        }
+    }
+
+    if (pendingLoad.valid()) {
+        // Rethrows the load error, the failed entry stays so every caller sees it
+        pendingLoad.get();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingLoads.erase(name);
+    return shaders.at(name).code;
+}
+
+void ShaderLibrary::startWatching(ShaderReloadCallback onReloaded) {
+    if (!config.hotReload) {
+        return;
+    }
+
+    this->onReloaded = std::move(onReloaded);
+    watcherRunning = true;
+    watcherThread = std::thread(&ShaderLibrary::watcherMain, this);
+}
+
+void ShaderLibrary::load(const std::string &name) {
+    Shader shader{};
+    for (const auto &searchPath: config.searchPaths) {
+        auto sourcePath = std::filesystem::path(searchPath) / name;
+#ifdef DARK_STAR_SHADERC
+        if (std::filesystem::exists(sourcePath)) {
+            shader.sourcePath = sourcePath.string();
+            shader.code = compile(shader.sourcePath, shader.includedFiles);
+            break;
+        }
+#endif
+
+        auto binaryPath = sourcePath;
+        binaryPath += ".spv";
+        if (std::filesystem::exists(binaryPath)) {
+            shader.code = toWords(readBinaryFile(binaryPath.string()), binaryPath.string());
+            break;
+        }
+    }
+
+    if (shader.code.empty()) {
+        throw std::runtime_error(std::format("Unable to find shader {} in the search paths", name));
+    }
+
+    if (config.hotReload && !shader.sourcePath.empty()) {
+        watchDirectory(std::filesystem::path(shader.sourcePath).parent_path().string());
+        for (const auto &includedFile: shader.includedFiles) {
+            watchDirectory(std::filesystem::path(includedFile).parent_path().string());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    shaders[name] = std::move(shader);
+}
+
+std::vector<uint32_t> ShaderLibrary::compile(const std::string &sourcePath, std::vector<std::string> &includedFiles) {
+#ifdef DARK_STAR_SHADERC
+    auto source = readBinaryFile(sourcePath);
+    auto kind = getShaderKind(sourcePath);
+
+    includedFiles.clear();
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetOptimizationLevel(SHADER_OPTIMIZATION_LEVEL);
+    options.SetIncluder(std::make_unique<ShaderIncluder>(config.searchPaths, includedFiles));
+
+    // The cache key is taken from the preprocessed source, which already has the includes and macros expanded
+    auto preprocessed = compiler.PreprocessGlsl(source.data(), source.size(), kind, sourcePath.c_str(), options);
+    if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+        throw std::runtime_error(std::format("Failed to preprocess shader {}:\n{}", sourcePath,
+                                             preprocessed.GetErrorMessage()));
+    }
+    std::string expandedSource(preprocessed.cbegin(), preprocessed.cend());
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hashBytes(hash, expandedSource.data(), expandedSource.size());
+    hash = hashBytes(hash, &kind, sizeof(kind));
+    hash = hashBytes(hash, &SHADER_OPTIMIZATION_LEVEL, sizeof(SHADER_OPTIMIZATION_LEVEL));
+    hash = hashBytes(hash, &SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+    auto cachePath = std::filesystem::path(config.cacheDirectory) / std::format("{:016x}.spv", hash);
+
+    if (std::filesystem::exists(cachePath)) {
+        try {
+            return toWords(readBinaryFile(cachePath.string()), cachePath.string());
+        } catch (const std::exception &e) {
+            std::cerr << "Ignoring shader cache entry: " << e.what() << std::endl;
+        }
+    }
+
+    // Compiling the preprocessed source keeps the SPIR-V in line with the key even if an include changes meanwhile
+    auto result = compiler.CompileGlslToSpv(expandedSource, kind, sourcePath.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        throw std::runtime_error(std::format("Failed to compile shader {}:\n{}", sourcePath, result.GetErrorMessage()));
+    }
+
+    std::vector<uint32_t> code(result.cbegin(), result.cend());
+
+    // Written under a temporary name and renamed, so a concurrent reader never sees a partial entry
+    std::error_code error;
+    std::filesystem::create_directories(config.cacheDirectory, error);
+    auto temporaryPath = cachePath;
+    temporaryPath += std::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(code.data()), code.size() * sizeof(uint32_t));
+    }
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::cerr << "Unable to write shader cache entry " << cachePath << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+
+    return code;
+#else
+    throw std::runtime_error(std::format("Unable to compile shader {}, the engine was built without shaderc",
+                                         sourcePath));
+#endif
+}
+
+void ShaderLibrary::watchDirectory(const std::string &directory) {
+#ifdef SHADER_HOT_RELOAD_SUPPORTED
+    int watch = inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        std::cerr << "Unable to watch shader directory " << directory << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    watchedDirectories[watch] = directory;
+#endif
+}
+
+void ShaderLibrary::watcherMain() {
+#ifdef SHADER_HOT_RELOAD_SUPPORTED
+    alignas(inotify_event) char buffer[4096];
+
+    while (watcherRunning) {
+        pollfd descriptor{inotifyDescriptor, POLLIN, 0};
+        if (poll(&descriptor, 1, WATCH_POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        // Editors often save in several steps, waiting a little lets them finish before the events are read
+        std::this_thread::sleep_for(RELOAD_DEBOUNCE);
+
+        std::unordered_set<std::string> changedFiles;
+        ssize_t length;
+        while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (char *it = buffer; it < buffer + length;) {
+                auto event = reinterpret_cast<const inotify_event *>(it);
+                auto directory = watchedDirectories.find(event->wd);
+                if (event->len > 0 && directory != watchedDirectories.end()) {
+                    changedFiles.insert((std::filesystem::path(directory->second) / event->name).string());
+                }
+                it += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        // A changed include reloads every shader that includes it
+        std::vector<std::pair<std::string, std::string>> changedShaders;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &[name, shader]: shaders) {
+                bool changed = changedFiles.contains(shader.sourcePath);
+                for (const auto &includedFile: shader.includedFiles) {
+                    changed = changed || changedFiles.contains(includedFile);
+                }
+                if (changed && !shader.sourcePath.empty()) {
+                    changedShaders.emplace_back(name, shader.sourcePath);
+                }
+            }
+        }
+
+        for (const auto &[name, sourcePath]: changedShaders) {
+            try {
+                std::vector<std::string> includedFiles;
+                auto code = compile(sourcePath, includedFiles);
+                for (const auto &includedFile: includedFiles) {
+                    watchDirectory(std::filesystem::path(includedFile).parent_path().string());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shaders[name].code = std::move(code);
+                    shaders[name].includedFiles = std::move(includedFiles);
+                }
+
+                std::cout << "Reloaded shader: " << name << std::endl;
+                onReloaded(name);
+            } catch (const std::exception &e) {
+                std::cerr << "Shader reload failed, keeping the previous version: " << e.what() << std::endl;
+            }
+        }
+    }
+#endif
+}
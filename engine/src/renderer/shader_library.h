@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef struct ShaderLibraryConfig {
+    // Directories searched in order for a shader's GLSL source and its precompiled <name>.spv
+    std::vector<std::string> searchPaths;
+    // Compiled SPIR-V is stored here under the hash of the preprocessed source and the compile options
+    std::string cacheDirectory = "shader_cache";
+    bool hotReload = false;
+} ShaderLibraryConfig;
+
+typedef std::function<void(const std::string &shaderName)> ShaderReloadCallback;
+
+// Resolves shaders by name, for example "basic.vert", through the configured search paths. A GLSL source is
+// compiled with shaderc unless its SPIR-V is already in the cache, the precompiled .spv produced by the build is
+// the fallback when no source is found or the engine was built without shaderc. Includes are resolved next to the
+// including file and then through the search paths.
+// With hot reload enabled, the directories of the resolved sources and their includes are watched with inotify.
+// Shaders whose source or includes changed are recompiled on the watcher thread, which then invokes the reload
+// callback; the previous code stays active when compilation fails.
+class ShaderLibrary {
+public:
+    ShaderLibrary() = default;
+
+    void initialize(const ShaderLibraryConfig &config);
+
+    void destroy();
+
+    // Starts loading a shader in the background so that a later getCode() does not have to wait for the disk or the
+    // compiler
+    void preload(const std::string &name);
+
+    std::vector<uint32_t> getCode(const std::string &name);
+
+    void startWatching(ShaderReloadCallback onReloaded);
+
+    bool isHotReloadEnabled() const { return config.hotReload; }
+
+private:
+    typedef struct Shader {
+        std::string sourcePath;
+        // Files pulled in through #include when the source was last compiled
+        std::vector<std::string> includedFiles;
+        std::vector<uint32_t> code;
+    } Shader;
+
+    ShaderLibraryConfig config;
+    std::mutex mutex;
+    std::unordered_map<std::string, Shader> shaders;
+    std::unordered_map<std::string, std::shared_future<void>> pendingLoads;
+
+    int inotifyDescriptor = -1;
+    std::unordered_map<int, std::string> watchedDirectories;
+    std::thread watcherThread;
+    std::atomic<bool> watcherRunning = false;
+    ShaderReloadCallback onReloaded;
+
+    void load(const std::string &name);
+
+    std::vector<uint32_t> compile(const std::string &sourcePath, std::vector<std::string> &includedFiles);
+
+    void watchDirectory(const std::string &directory);
+
+    void watcherMain();
+};
@@ -0,0 +1,618 @@
+#include "texture_streamer.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include "vulkan.h"
+#include "core/file.h"
+
+static constexpr uint32_t NO_LEVEL = UINT32_MAX;
+static constexpr uint32_t MAX_PENDING_REQUESTS = 16;
+// Streamed textures are bindless, so any of these stages may sample them
+static constexpr VkPipelineStageFlags SAMPLING_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+void TextureStreamer::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                 const VkAllocationCallbacks *allocationCallbacks, UploadQueue &uploadQueue,
+                                 BindlessDescriptors &bindless, std::vector<uint32_t> queueFamilyIndices,
+                                 bool memoryBudgetSupported, const TextureStreamerConfig &config) {
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->uploadQueue = &uploadQueue;
+    this->bindless = &bindless;
+    this->queueFamilyIndices = std::move(queueFamilyIndices);
+    this->memoryBudgetSupported = memoryBudgetSupported;
+    this->config = config;
+
+    VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(device, &samplerCreateInfo, allocationCallbacks, &sampler))
+    samplerHandle = bindless.registerSampler(sampler);
+
+    loaderRunning = true;
+    loaderThread = std::thread(&TextureStreamer::loaderMain, this);
+}
+
+void TextureStreamer::destroy() {
+    {
+        std::lock_guard lock(loaderMutex);
+        loaderRunning = false;
+    }
+    loaderCondition.notify_all();
+    if (loaderThread.joinable()) {
+        loaderThread.join();
+    }
+
+    for (auto &texture: textures) {
+        if (texture.image != VK_NULL_HANDLE) {
+            retiredImages.push_back({texture.image, texture.memory, texture.imageView, texture.residentBytes, 0});
+        }
+    }
+    textures.clear();
+
+    // The upload queue drops the completion callbacks of uploads that are still pending
+    for (auto &pending: uploadingImages) {
+        retiredImages.push_back({pending.image, pending.memory, pending.imageView, pending.size, 0});
+    }
+    uploadingImages.clear();
+    for (auto &pending: copyingImages) {
+        retiredImages.push_back({pending.image, pending.memory, pending.imageView, pending.size, 0});
+    }
+    copyingImages.clear();
+
+    for (auto &retired: retiredImages) {
+        vkDestroyImageView(device, retired.imageView, allocationCallbacks);
+        vkDestroyImage(device, retired.image, allocationCallbacks);
+        vkFreeMemory(device, retired.memory, allocationCallbacks);
+    }
+    retiredImages.clear();
+
+    vkDestroySampler(device, sampler, allocationCallbacks);
+}
+
+TextureHandle TextureStreamer::load(const std::string &fileName) {
+    auto file = readKtx2Header(fileName);
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, file.format, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        throw std::runtime_error(std::format("Texture format {} is not supported by the device: {}",
+                                             string_VkFormat(file.format), fileName));
+    }
+
+    uint32_t lowestLevel = file.levels.size() - 1;
+    uint32_t initialLevel = 0;
+    while (initialLevel < lowestLevel &&
+           std::max(file.levels[initialLevel].width, file.levels[initialLevel].height) > config.initialMaxDimension) {
+        initialLevel++;
+    }
+
+    TextureHandle handle = textures.size();
+    textures.push_back({
+                               .fileName = fileName,
+                               .file = std::move(file),
+                               .image = VK_NULL_HANDLE,
+                               .memory = VK_NULL_HANDLE,
+                               .imageView = VK_NULL_HANDLE,
+                               .residentBytes = 0,
+                               .allocationSizes = std::vector<VkDeviceSize>(lowestLevel + 1, 0),
+                               .imageHandle = INVALID_BINDLESS_HANDLE,
+                               .residentLevel = lowestLevel + 1,
+                               .desiredLevel = initialLevel,
+                               .pendingLevel = NO_LEVEL,
+                               .lastRequestedFrame = frameNumber,
+                       });
+
+    requestLevels(handle, initialLevel);
+    stats.textureCount = textures.size();
+    return handle;
+}
+
+void TextureStreamer::requestResolution(TextureHandle texture, float screenPixels) {
+    auto &streamed = textures[texture];
+    uint32_t lowestLevel = streamed.file.levels.size() - 1;
+    float dimension = static_cast<float>(std::max(streamed.file.width, streamed.file.height));
+
+    uint32_t level = lowestLevel;
+    if (screenPixels >= 1.0f) {
+        float exactLevel = std::floor(std::log2(dimension / screenPixels));
+        level = static_cast<uint32_t>(std::clamp(exactLevel, 0.0f, static_cast<float>(lowestLevel)));
+    }
+
+    streamed.desiredLevel = level;
+    streamed.lastRequestedFrame = frameNumber;
+}
+
+BindlessHandle TextureStreamer::getImageHandle(TextureHandle texture) const {
+    return textures[texture].imageHandle;
+}
+
+void TextureStreamer::update(uint64_t frameNumber) {
+    this->frameNumber = frameNumber;
+
+    std::erase_if(retiredImages, [this](const RetiredImage &retired) {
+        if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > this->frameNumber) {
+            return false;
+        }
+
+        vkDestroyImageView(device, retired.imageView, allocationCallbacks);
+        vkDestroyImage(device, retired.image, allocationCallbacks);
+        vkFreeMemory(device, retired.memory, allocationCallbacks);
+        return true;
+    });
+
+    {
+        std::lock_guard lock(loaderMutex);
+        while (!readResults.empty()) {
+            uploadBacklog.push_back(std::move(readResults.front()));
+            readResults.pop_front();
+        }
+    }
+
+    VkDeviceSize uploadBudget = config.maxUploadBytesPerFrame;
+    bool stagingFull = false;
+    while (!uploadBacklog.empty()) {
+        auto &request = uploadBacklog.front();
+        // Always allow one upload per frame, even if it is larger than the per frame limit on its own
+        if (request.size > uploadBudget && uploadBudget < config.maxUploadBytesPerFrame) {
+            break;
+        }
+
+        uploadLevels(request, uploadBudget, stagingFull);
+        if (stagingFull) {
+            break;
+        }
+        uploadBacklog.pop_front();
+    }
+
+    updateResidency();
+}
+
+void TextureStreamer::loaderMain() {
+    while (true) {
+        ReadRequest request;
+        {
+            std::unique_lock lock(loaderMutex);
+            loaderCondition.wait(lock, [this] { return !loaderRunning || !readQueue.empty(); });
+            if (!loaderRunning) {
+                return;
+            }
+
+            request = std::move(readQueue.front());
+            readQueue.pop_front();
+        }
+
+        try {
+            request.data = readBinaryFileRange(request.fileName, request.offset, request.size);
+        } catch (const std::exception &e) {
+            logError("streaming", "Texture streaming failed: {}", e.what());
+            request.failed = true;
+        }
+
+        std::lock_guard lock(loaderMutex);
+        readResults.push_back(std::move(request));
+    }
+}
+
+void TextureStreamer::requestLevels(TextureHandle texture, uint32_t topLevel) {
+    auto &streamed = textures[texture];
+    const auto &levels = streamed.file.levels;
+    streamed.pendingLevel = topLevel;
+    stats.pendingRequests++;
+
+    // KTX2 stores the smallest mip first, so the levels above the resident ones are one contiguous range. The resident
+    // levels are copied from the current image by recordCopies().
+    uint64_t begin = levels[streamed.residentLevel - 1].byteOffset;
+    uint64_t end = levels[topLevel].byteOffset + levels[topLevel].byteLength;
+
+    {
+        std::lock_guard lock(loaderMutex);
+        readQueue.push_back({
+                                    .texture = texture,
+                                    .topLevel = topLevel,
+                                    .residentLevel = streamed.residentLevel,
+                                    .fileName = streamed.fileName,
+                                    .offset = begin,
+                                    .size = end - begin,
+                                    .data = {},
+                                    .failed = false,
+                            });
+    }
+    loaderCondition.notify_one();
+}
+
+void TextureStreamer::uploadLevels(ReadRequest &request, VkDeviceSize &uploadBudget, bool &stagingFull) {
+    auto &streamed = textures[request.texture];
+    if (request.failed) {
+        streamed.pendingLevel = NO_LEVEL;
+        stats.pendingRequests--;
+        return;
+    }
+
+    // Checked before the image exists, so a full staging ring does not build and destroy it again every frame
+    if (!uploadQueue->canStage(request.data.size())) {
+        stagingFull = true;
+        return;
+    }
+
+    const auto &levels = streamed.file.levels;
+    auto pending = createImage(request.texture, request.topLevel);
+
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t level = request.topLevel; level < request.residentLevel; ++level) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = levels[level].byteOffset - request.offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level - request.topLevel;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {levels[level].width, levels[level].height, 1};
+        regions.push_back(region);
+    }
+
+    // Once uploaded, the image waits for recordCopies() to add the levels that are already resident
+    VkImage image = pending.image;
+    auto onUploaded = [this, image]() {
+        auto uploading = std::find_if(uploadingImages.begin(), uploadingImages.end(),
+                                      [image](const PendingImage &pending) { return pending.image == image; });
+        copyingImages.push_back(*uploading);
+        uploadingImages.erase(uploading);
+    };
+
+    uint32_t uploadedLevels = request.residentLevel - request.topLevel;
+    bool queued = uploadQueue->uploadImage(image, uploadedLevels, request.data.data(), request.data.size(),
+                                           std::move(regions), onUploaded);
+
+    if (!queued) {
+        vkDestroyImageView(device, pending.imageView, allocationCallbacks);
+        vkDestroyImage(device, pending.image, allocationCallbacks);
+        vkFreeMemory(device, pending.memory, allocationCallbacks);
+        stagingFull = true;
+        return;
+    }
+
+    uploadingImages.push_back(pending);
+    uploadBudget -= std::min(uploadBudget, static_cast<VkDeviceSize>(request.data.size()));
+    stats.uploadedBytes += request.data.size();
+}
+
+void TextureStreamer::recordCopies(VkCommandBuffer commandBuffer) {
+    if (copyingImages.empty()) {
+        return;
+    }
+
+    // The old image leaves SHADER_READ_ONLY_OPTIMAL only around the copy. Earlier frames sampling it were submitted to
+    // the same queue, so the barrier orders the layout change after them.
+    std::vector<VkImageMemoryBarrier> transferBarriers;
+    std::vector<VkImageMemoryBarrier> shaderReadBarriers;
+    for (const auto &pending: copyingImages) {
+        const auto &streamed = textures[pending.texture];
+        if (streamed.image == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        uint32_t firstLevel = std::max(pending.topLevel, streamed.residentLevel);
+        VkImageMemoryBarrier source{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        source.image = streamed.image;
+        source.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        source.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        source.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        source.subresourceRange.baseMipLevel = firstLevel - streamed.residentLevel;
+        source.subresourceRange.levelCount = streamed.file.levels.size() - firstLevel;
+        source.subresourceRange.layerCount = 1;
+        source.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        source.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        source.srcAccessMask = 0;
+        source.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        // Levels above the old image were uploaded already and stay as they are
+        auto destination = source;
+        destination.image = pending.image;
+        destination.subresourceRange.baseMipLevel = firstLevel - pending.topLevel;
+        destination.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        destination.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        destination.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        transferBarriers.push_back(source);
+        transferBarriers.push_back(destination);
+
+        source.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        source.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        source.srcAccessMask = 0;
+        source.dstAccessMask = 0;
+        destination.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        destination.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        destination.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        destination.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        shaderReadBarriers.push_back(source);
+        shaderReadBarriers.push_back(destination);
+    }
+
+    if (!transferBarriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, SAMPLING_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             transferBarriers.size(), transferBarriers.data());
+    }
+
+    for (const auto &pending: copyingImages) {
+        const auto &streamed = textures[pending.texture];
+        if (streamed.image == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        const auto &levels = streamed.file.levels;
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = std::max(pending.topLevel, streamed.residentLevel); level < levels.size(); ++level) {
+            VkImageCopy region{};
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = level - streamed.residentLevel;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource = region.srcSubresource;
+            region.dstSubresource.mipLevel = level - pending.topLevel;
+            region.extent = {levels[level].width, levels[level].height, 1};
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(commandBuffer, streamed.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+    }
+
+    if (!shaderReadBarriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES, 0, 0, nullptr, 0, nullptr,
+                             shaderReadBarriers.size(), shaderReadBarriers.data());
+    }
+
+    for (const auto &pending: copyingImages) {
+        install(pending);
+    }
+    copyingImages.clear();
+}
+
+TextureStreamer::PendingImage TextureStreamer::createImage(TextureHandle texture, uint32_t topLevel) {
+    const auto &streamed = textures[texture];
+
+    auto imageCreateInfo = getImageCreateInfo(streamed, topLevel);
+    VkImage image;
+    VK_CHECK(vkCreateImage(device, &imageCreateInfo, allocationCallbacks, &image))
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkDeviceMemory memory;
+    VK_CHECK(vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &memory))
+    VK_CHECK(vkBindImageMemory(device, image, memory, 0))
+
+    VkImageViewCreateInfo viewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewCreateInfo.image = image;
+    viewCreateInfo.format = streamed.file.format;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewCreateInfo.subresourceRange.levelCount = imageCreateInfo.mipLevels;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+    VkImageView imageView;
+    VK_CHECK(vkCreateImageView(device, &viewCreateInfo, allocationCallbacks, &imageView))
+
+    return {texture, topLevel, image, memory, imageView, memoryRequirements.size};
+}
+
+void TextureStreamer::install(const PendingImage &pending) {
+    auto &streamed = textures[pending.texture];
+    if (streamed.image != VK_NULL_HANDLE) {
+        retiredImages.push_back({streamed.image, streamed.memory, streamed.imageView, streamed.residentBytes,
+                                 frameNumber});
+    }
+
+    // Frames in flight may still sample the old view, so the new one gets a fresh slot instead of a rewrite
+    auto previousHandle = streamed.imageHandle;
+    streamed.imageHandle = bindless->registerSampledImage(pending.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (previousHandle != INVALID_BINDLESS_HANDLE) {
+        bindless->release(BINDLESS_RESOURCE_SAMPLED_IMAGE, previousHandle);
+    }
+
+    stats.residentBytes = stats.residentBytes - streamed.residentBytes + pending.size;
+    stats.pendingRequests--;
+
+    streamed.image = pending.image;
+    streamed.memory = pending.memory;
+    streamed.imageView = pending.imageView;
+    streamed.residentBytes = pending.size;
+    streamed.residentLevel = pending.topLevel;
+    streamed.pendingLevel = NO_LEVEL;
+}
+
+void TextureStreamer::updateResidency() {
+    VkDeviceSize budget = queryBudget();
+    stats.budgetBytes = budget;
+
+    // projected is what the textures settle at, transient the memory of old images that stay alive next to their
+    // replacement until the frames in flight are done with them
+    VkDeviceSize projected = 0;
+    VkDeviceSize transient = 0;
+    for (const auto &retired: retiredImages) {
+        transient += retired.size;
+    }
+
+    std::vector<TextureHandle> candidates;
+    for (TextureHandle handle = 0; handle < textures.size(); ++handle) {
+        auto &streamed = textures[handle];
+        uint32_t lowestLevel = streamed.file.levels.size() - 1;
+
+        if (frameNumber - streamed.lastRequestedFrame > config.evictAfterFrames) {
+            streamed.desiredLevel = lowestLevel;
+        }
+
+        uint32_t targetLevel = streamed.pendingLevel != NO_LEVEL ? streamed.pendingLevel : streamed.residentLevel;
+        projected += getAllocationSize(streamed, targetLevel);
+        if (streamed.pendingLevel != NO_LEVEL) {
+            transient += streamed.residentBytes;
+        }
+
+        if (streamed.pendingLevel == NO_LEVEL && streamed.residentLevel <= lowestLevel &&
+            streamed.desiredLevel < streamed.residentLevel) {
+            candidates.push_back(handle);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](TextureHandle a, TextureHandle b) {
+        const auto &textureA = textures[a];
+        const auto &textureB = textures[b];
+        uint32_t gapA = textureA.residentLevel - textureA.desiredLevel;
+        uint32_t gapB = textureB.residentLevel - textureB.desiredLevel;
+        if (gapA != gapB) {
+            return gapA > gapB;
+        }
+        return textureA.lastRequestedFrame > textureB.lastRequestedFrame;
+    });
+
+    // Over resident textures are evicted first, then the ones which have not been requested for the longest time
+    auto findVictim = [this](TextureHandle exclude, bool onlyUnneeded) -> TextureHandle {
+        TextureHandle victim = NO_LEVEL;
+        for (TextureHandle handle = 0; handle < textures.size(); ++handle) {
+            const auto &streamed = textures[handle];
+            if (handle == exclude || streamed.pendingLevel != NO_LEVEL ||
+                streamed.residentLevel + 1 >= streamed.file.levels.size()) {
+                continue;
+            }
+
+            bool unneeded = streamed.residentLevel < streamed.desiredLevel;
+            if (onlyUnneeded && !unneeded) {
+                continue;
+            }
+
+            if (victim == NO_LEVEL) {
+                victim = handle;
+                continue;
+            }
+
+            const auto &current = textures[victim];
+            bool currentUnneeded = current.residentLevel < current.desiredLevel;
+            if (unneeded != currentUnneeded ? unneeded : streamed.lastRequestedFrame < current.lastRequestedFrame) {
+                victim = handle;
+            }
+        }
+        return victim;
+    };
+
+    // Dropping a level needs no reads or uploads, the remaining levels are copied into a smaller image
+    auto evict = [this, &projected, &transient](TextureHandle victim) {
+        auto &streamed = textures[victim];
+        uint32_t topLevel = streamed.residentLevel + 1;
+        projected -= getAllocationSize(streamed, streamed.residentLevel) - getAllocationSize(streamed, topLevel);
+        transient += streamed.residentBytes;
+        copyingImages.push_back(createImage(victim, topLevel));
+        streamed.pendingLevel = topLevel;
+        stats.pendingRequests++;
+        stats.evictions++;
+    };
+
+    while (projected > budget && stats.pendingRequests < MAX_PENDING_REQUESTS) {
+        auto victim = findVictim(NO_LEVEL, false);
+        if (victim == NO_LEVEL) {
+            break;
+        }
+        evict(victim);
+    }
+
+    for (auto handle: candidates) {
+        if (stats.pendingRequests >= MAX_PENDING_REQUESTS) {
+            break;
+        }
+
+        auto &streamed = textures[handle];
+        uint32_t nextLevel = streamed.residentLevel - 1;
+        VkDeviceSize extra = getAllocationSize(streamed, nextLevel) -
+                             getAllocationSize(streamed, streamed.residentLevel);
+
+        while (projected + extra > budget && stats.pendingRequests < MAX_PENDING_REQUESTS) {
+            auto victim = findVictim(handle, true);
+            if (victim == NO_LEVEL) {
+                break;
+            }
+            evict(victim);
+        }
+
+        // The whole new image is allocated while the current one is still in use, so both count until it is freed
+        if (projected + extra + transient + streamed.residentBytes > budget ||
+            stats.pendingRequests >= MAX_PENDING_REQUESTS) {
+            continue;
+        }
+
+        projected += extra;
+        transient += streamed.residentBytes;
+        requestLevels(handle, nextLevel);
+        stats.promotions++;
+    }
+}
+
+VkDeviceSize TextureStreamer::queryBudget() const {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    VkPhysicalDeviceMemoryProperties2 memoryProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+    if (memoryBudgetSupported) {
+        memoryProperties.pNext = &budgetProperties;
+    }
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+    VkDeviceSize heapBudget = 0;
+    const auto &properties = memoryProperties.memoryProperties;
+    for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+        if (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            auto available = memoryBudgetSupported ? budgetProperties.heapBudget[i] : properties.memoryHeaps[i].size;
+            heapBudget = std::max(heapBudget, available);
+        }
+    }
+
+    return std::min(config.budgetBytes, static_cast<VkDeviceSize>(heapBudget * config.heapBudgetFraction));
+}
+
+VkImageCreateInfo TextureStreamer::getImageCreateInfo(const StreamedTexture &texture, uint32_t topLevel) const {
+    const auto &levels = texture.file.levels;
+
+    VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = texture.file.format;
+    imageCreateInfo.extent = {levels[topLevel].width, levels[topLevel].height, 1};
+    imageCreateInfo.mipLevels = levels.size() - topLevel;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                            VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (queueFamilyIndices.size() > 1) {
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageCreateInfo.queueFamilyIndexCount = queueFamilyIndices.size();
+        imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    } else {
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    return imageCreateInfo;
+}
+
+VkDeviceSize TextureStreamer::getAllocationSize(StreamedTexture &texture, uint32_t topLevel) {
+    // Nothing is resident yet
+    if (topLevel >= texture.file.levels.size()) {
+        return 0;
+    }
+
+    // The budget is compared with the allocations, which alignment and padding of the driver's layout make larger
+    // than the file's level sizes. An image without memory is enough to ask for them.
+    auto &size = texture.allocationSizes[topLevel];
+    if (size == 0) {
+        auto imageCreateInfo = getImageCreateInfo(texture, topLevel);
+        VkImage image;
+        VK_CHECK(vkCreateImage(device, &imageCreateInfo, allocationCallbacks, &image))
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+        vkDestroyImage(device, image, allocationCallbacks);
+        size = memoryRequirements.size;
+    }
+    return size;
+}
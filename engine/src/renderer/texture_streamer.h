@@ -0,0 +1,167 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "ktx2.h"
+#include "vulkan_bindless.h"
+#include "vulkan_upload.h"
+
+typedef uint32_t TextureHandle;
+
+typedef struct TextureStreamerConfig {
+    // Upper limit for streamed textures, the effective budget is lowered further by VK_EXT_memory_budget
+    VkDeviceSize budgetBytes = 512ull * 1024 * 1024;
+    // Share of the device local heap budget reported by the driver that streaming may occupy
+    float heapBudgetFraction = 0.5f;
+    VkDeviceSize maxUploadBytesPerFrame = 32ull * 1024 * 1024;
+    // Largest mip dimension loaded right away, larger mips are only streamed in on demand
+    uint32_t initialMaxDimension = 64;
+    // Textures which were not requested for this many frames are the first eviction candidates
+    uint32_t evictAfterFrames = 120;
+} TextureStreamerConfig;
+
+typedef struct TextureStreamerStats {
+    VkDeviceSize residentBytes;
+    VkDeviceSize budgetBytes;
+    uint32_t textureCount;
+    uint32_t pendingRequests;
+    uint64_t promotions;
+    uint64_t evictions;
+    uint64_t uploadedBytes;
+} TextureStreamerStats;
+
+// Keeps a window of each texture's mip chain resident, [residentLevel, levels.size()). Low mips are loaded first,
+// higher ones are promoted one level at a time based on the screen space size reported through
+// requestResolution(), and the least needed textures drop their top level whenever the budget would be exceeded.
+// A residency change builds a new image. Only levels that were not resident before are read on the loader thread and
+// uploaded through the UploadQueue, the new image is created once the staging ring has room for them. The levels
+// that stay resident are copied out of the old image by recordCopies() on the graphics queue, which also swaps the
+// bindless descriptor; an eviction is such a copy alone. The old image is freed once the frames in flight are done
+// with it, until then the budget counts it together with the new one.
+class TextureStreamer {
+public:
+    TextureStreamer() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    UploadQueue &uploadQueue, BindlessDescriptors &bindless,
+                    std::vector<uint32_t> queueFamilyIndices, bool memoryBudgetSupported,
+                    const TextureStreamerConfig &config);
+
+    // The device must be idle, images of uploads which did not complete yet are freed as well
+    void destroy();
+
+    TextureHandle load(const std::string &fileName);
+
+    void requestResolution(TextureHandle texture, float screenPixels);
+
+    void update(uint64_t frameNumber);
+
+    // Records the copies of the levels that stay resident and installs the new images, must come before any command
+    // of the frame that samples streamed textures
+    void recordCopies(VkCommandBuffer commandBuffer);
+
+    BindlessHandle getImageHandle(TextureHandle texture) const;
+
+    BindlessHandle getSamplerHandle() const { return samplerHandle; }
+
+    const TextureStreamerStats &getStats() const { return stats; }
+
+private:
+    typedef struct StreamedTexture {
+        std::string fileName;
+        Ktx2File file;
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView imageView;
+        VkDeviceSize residentBytes;
+        // Memory size of an image holding the levels from each top level down, queried when first needed
+        std::vector<VkDeviceSize> allocationSizes;
+        BindlessHandle imageHandle;
+        uint32_t residentLevel;
+        uint32_t desiredLevel;
+        uint32_t pendingLevel;
+        uint64_t lastRequestedFrame;
+    } StreamedTexture;
+
+    typedef struct ReadRequest {
+        TextureHandle texture;
+        uint32_t topLevel;
+        // First level that is already resident and gets copied instead of read
+        uint32_t residentLevel;
+        std::string fileName;
+        uint64_t offset;
+        uint64_t size;
+        std::vector<char> data;
+        bool failed;
+    } ReadRequest;
+
+    typedef struct RetiredImage {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView imageView;
+        VkDeviceSize size;
+        uint64_t frameNumber;
+    } RetiredImage;
+
+    typedef struct PendingImage {
+        TextureHandle texture;
+        uint32_t topLevel;
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView imageView;
+        VkDeviceSize size;
+    } PendingImage;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    UploadQueue *uploadQueue = nullptr;
+    BindlessDescriptors *bindless = nullptr;
+    std::vector<uint32_t> queueFamilyIndices;
+    bool memoryBudgetSupported = false;
+    TextureStreamerConfig config;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    BindlessHandle samplerHandle = INVALID_BINDLESS_HANDLE;
+
+    std::vector<StreamedTexture> textures;
+    std::vector<RetiredImage> retiredImages;
+    // Images of uploads which did not complete yet, their completion callback moves them to copyingImages
+    std::vector<PendingImage> uploadingImages;
+    // Images waiting for recordCopies() to fill in their resident levels and install them
+    std::vector<PendingImage> copyingImages;
+    std::deque<ReadRequest> uploadBacklog;
+    uint64_t frameNumber = 0;
+    TextureStreamerStats stats{};
+
+    std::thread loaderThread;
+    std::mutex loaderMutex;
+    std::condition_variable loaderCondition;
+    std::deque<ReadRequest> readQueue;
+    std::deque<ReadRequest> readResults;
+    bool loaderRunning = false;
+
+    void loaderMain();
+
+    void requestLevels(TextureHandle texture, uint32_t topLevel);
+
+    void uploadLevels(ReadRequest &request, VkDeviceSize &uploadBudget, bool &stagingFull);
+
+    PendingImage createImage(TextureHandle texture, uint32_t topLevel);
+
+    void install(const PendingImage &pending);
+
+    void updateResidency();
+
+    VkDeviceSize queryBudget() const;
+
+    VkImageCreateInfo getImageCreateInfo(const StreamedTexture &texture, uint32_t topLevel) const;
+
+    VkDeviceSize getAllocationSize(StreamedTexture &texture, uint32_t topLevel);
+};
@@ -1,9 +1,52 @@
 #include "vulkan.h"
 #include <vector>
-#include <queue>
 #include <format>
+#include <cstdlib>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <future>
 #include <SDL_vulkan.h>
-#include "core/file.h"
+
+static constexpr VkDeviceSize UNIFORM_RING_FRAME_SIZE = 64 * 1024;
+static constexpr VkDeviceSize STORAGE_RING_FRAME_SIZE = 4 * 1024 * 1024;
+static constexpr uint32_t MAX_OBJECTS_PER_DRAW_BINDING = 16384;
+static constexpr VkDeviceSize UPLOAD_STAGING_SIZE = 64 * 1024 * 1024;
+static constexpr uint64_t STREAMING_REPORT_INTERVAL = 1000;
+static constexpr uint32_t GPU_PROFILER_MAX_SCOPES = 32;
+// Frames spent on each path before switching when comparing specialized pipelines against the uber shader
+static constexpr uint64_t SHADER_COMPARE_INTERVAL = 120;
+static constexpr ShaderFeatures MAIN_PASS_FEATURES = SHADER_FEATURE_VERTEX_COLOR | SHADER_FEATURE_DITHER;
+static const std::string MAIN_PASS_SCOPE_SPECIALIZED = "main pass (specialized)";
+static const std::string MAIN_PASS_SCOPE_UBER = "main pass (uber)";
+static const std::string BASIC_VERTEX_SHADER = "basic.vert";
+static const std::string BASIC_FRAGMENT_SHADER = "basic.frag";
+static const std::string IMMEDIATE_VERTEX_SHADER = "immediate.vert";
+static const std::string IMMEDIATE_FRAGMENT_SHADER = "immediate.frag";
+static const std::string PARTICLE_SCOPE_SIMULATE = "particles simulate";
+static const std::string PARTICLE_SCOPE_SORT = "particles sort";
+static const std::string PARTICLE_SCOPE_DRAW = "particles draw";
+static constexpr uint32_t HEADLESS_IMAGE_COUNT = 3;
+static constexpr VkFormat HEADLESS_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
+static const std::string FRAME_SCOPE = "frame";
+static const std::string FRAME_SPLIT_SCOPE = "frame split";
+static const std::string UPSCALE_SCOPE = "upscale";
+
+#ifdef NDEBUG
+static constexpr bool VALIDATION_BY_DEFAULT = false;
+static constexpr bool HOT_RELOAD_BY_DEFAULT = false;
+#else
+static constexpr bool VALIDATION_BY_DEFAULT = true;
+static constexpr bool HOT_RELOAD_BY_DEFAULT = true;
+#endif
+
+#ifndef DARK_STAR_SHADER_SOURCE_DIR
+#define DARK_STAR_SHADER_SOURCE_DIR "shaders"
+#endif
+
+#ifndef DARK_STAR_SHADER_BINARY_DIR
+#define DARK_STAR_SHADER_BINARY_DIR "."
+#endif
 
 const std::vector<Vertex> vertices = {
         // Bottom left
@@ -17,58 +60,171 @@ const std::vector<Vertex> vertices = {
         {{0.5f,  -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
 };
 
-void Vulkan::initialize(const char *applicationName, SDL_Window *window) {
-    createInstance(applicationName, window);
-    createDebugUtilsMessenger();
-    selectBestPhysicalDevice();
-    createSurface(window);
-    createDevice();
-    createSwapChain();
-    createRenderPass();
-    createPipeline();
-    createFrameBuffers();
-    createVertexBuffer(vertices);
-    createCommandPool();
-    createCommandBuffer();
-    createSyncObjects();
+std::vector<const char *> Vulkan::getWindowInstanceExtensions() {
+    uint32_t count = 0;
+    if (!SDL_Vulkan_GetInstanceExtensions(nullptr, &count, nullptr)) {
+        throw std::runtime_error(std::format("Failed to query Vulkan instance extensions: {}", SDL_GetError()));
+    }
+
+    std::vector<const char *> extensions(count);
+    SDL_Vulkan_GetInstanceExtensions(nullptr, &count, extensions.data());
+    return extensions;
 }
 
-Vulkan::~Vulkan() {
-    vkDeviceWaitIdle(device);
+void Vulkan::initializeInstance(const char *applicationName, const std::vector<const char *> &windowExtensions,
+                                StartupTimer &startupTimer) {
+    // Shaders are only needed by createPipeline(), loading and compiling them overlaps with everything before it
+    createShaderLibrary();
+    shaderLibrary.preload(BASIC_VERTEX_SHADER);
+    shaderLibrary.preload(BASIC_FRAGMENT_SHADER);
+    shaderLibrary.preload(IMMEDIATE_VERTEX_SHADER);
+    shaderLibrary.preload(IMMEDIATE_FRAGMENT_SHADER);
+
+    startupTimer.time("instance", [&] { createInstance(applicationName, windowExtensions); });
+    if (validationEnabled) {
+        startupTimer.time("debug messenger", [&] { createDebugUtilsMessenger(); });
+    }
+    startupTimer.time("physical device", [&] { selectBestPhysicalDevice(); });
+}
+
+void Vulkan::initialize(SDL_Window *window, StartupTimer &startupTimer) {
+    if (!config.headless) {
+        startupTimer.time("surface", [&] {
+            createSurface(window);
+            ensurePresentSupport();
+        });
+    }
+    startupTimer.time("device", [&] { createDevice(); });
+    startupTimer.time("swapchain", [&] {
+        createDynamicResolution();
+        createFrameCapture();
+        createSwapChain();
+    });
+    startupTimer.time("render pass", [&] { createRenderPass(); });
+    startupTimer.time("frame resources", [&] { createFrameResources(); });
+    startupTimer.time("descriptors", [&] { createDescriptors(); });
+
+    // Pipeline compilation is the slowest step and only depends on the layouts and the render pass, the remaining
+    // resources are created while it runs. The worker only touches pipeline state which nothing else reads until
+    // it joined.
+    auto pipelineReady = std::async(std::launch::async, [&] {
+        startupTimer.time("pipeline", [&] { createPipeline(); });
+    });
+
+    startupTimer.time("streaming", [&] {
+        createStreaming();
+        createSceneInstances();
+    });
+    startupTimer.time("framebuffers", [&] { createFrameBuffers(); });
+    startupTimer.time("vertex buffer", [&] { createVertexBuffer(vertices); });
+    startupTimer.time("command buffers", [&] {
+        createCommandPool();
+        createCommandBuffers();
+    });
+    startupTimer.time("async compute", [&] { createAsyncCompute(); });
+    startupTimer.time("sync objects", [&] { createSyncObjects(); });
+    startupTimer.time("pipeline wait", [&] { pipelineReady.get(); });
+    startupTimer.time("immediate renderer", [&] { createImmediateRenderer(); });
+    startupTimer.time("particle system", [&] { createParticleSystem(); });
+
+    // Reloads reach every subsystem with shaders, so the watcher only starts once all of them exist
+    shaderLibrary.startWatching([this](const std::string &shaderName) { onShaderReloaded(shaderName); });
+}
+
+static PFN_vkVoidFunction loadDeviceFunction(VkDevice device, const char *coreName, const char *extensionName) {
+    auto function = vkGetDeviceProcAddr(device, coreName);
+    if (function == nullptr) {
+        function = vkGetDeviceProcAddr(device, extensionName);
+    }
 
-    vkDestroyBuffer(device, vertexBuffer, allocationCallbacks);
-    vkFreeMemory(device, vertexBufferMemory, allocationCallbacks);
+    if (function == nullptr) {
+        throw std::runtime_error(std::format("Unable to load device function: {}", coreName));
+    }
+
+    return function;
+}
 
-    vkDestroyFence(device, inFlightFence, allocationCallbacks);
-    vkDestroySemaphore(device, imageAvailableSemaphore, allocationCallbacks);
-    vkDestroySemaphore(device, renderFinishedSemaphore, allocationCallbacks);
+Vulkan::~Vulkan() {
+    // Stops the watcher first, it may be building a pipeline on another thread
+    shaderLibrary.destroy();
+    vkDeviceWaitIdle(device);
+    // Writes out the frames still being encoded before the report
+    frameCapture.destroy();
+
+    if (renderPathStats.recordCount > 0) {
+        std::cout << std::format("Render path {}: recording {:.1f} us avg over {} frames, swapchain recreation "
+                                 "{:.1f} us avg over {} recreations",
+                                 dynamicRenderingEnabled ? "dynamic rendering + synchronization2"
+                                                         : "render pass + framebuffers",
+                                 renderPathStats.recordMicroseconds / renderPathStats.recordCount,
+                                 renderPathStats.recordCount,
+                                 renderPathStats.recreateCount > 0 ? renderPathStats.recreateMicroseconds /
+                                                                     renderPathStats.recreateCount : 0.0,
+                                 renderPathStats.recreateCount) << std::endl;
+    }
+    printShaderVariantReport();
+    printParticleReport();
+    printDynamicResolutionReport();
+    printAsyncComputeReport();
+    printFrameCaptureReport();
+
+    destroyBuffer(device, allocationCallbacks, vertexBuffer);
+
+    for (auto &frame: frames) {
+        vkDestroyFence(device, frame.inFlightFence, allocationCallbacks);
+        vkDestroySemaphore(device, frame.imageAvailableSemaphore, allocationCallbacks);
+        vkDestroySemaphore(device, frame.renderFinishedSemaphore, allocationCallbacks);
+    }
 
     vkDestroyCommandPool(device, commandPool, allocationCallbacks);
 
     cleanupSwapChain();
-
-    vkDestroyPipeline(device, pipeline, allocationCallbacks);
+    for (const auto &retired: retiredFrameBuffers) {
+        vkDestroyFramebuffer(device, retired.frameBuffer, allocationCallbacks);
+    }
+    vkDestroyFramebuffer(device, sceneFrameBuffer, allocationCallbacks);
+
+    immediateRenderer.destroy();
+    particleSystem.destroy();
+    asyncCompute.destroy();
+    pipelineVariants.destroy();
+    pipelineCache.destroy();
+    gpuProfiler.destroy();
     vkDestroyRenderPass(device, renderPass, allocationCallbacks);
+    vkDestroyRenderPass(device, overlayRenderPass, allocationCallbacks);
     vkDestroyPipelineLayout(device, pipelineLayout, allocationCallbacks);
 
-    for (auto &shaderModule: shaderModules) {
-        vkDestroyShaderModule(device, shaderModule, allocationCallbacks);
+    renderGraph.destroy();
+    sceneInstances.destroy();
+    textureStreamer.destroy();
+    uploadQueue.destroy();
+    bindless.destroy();
+    descriptorAllocator.destroy();
+    vkDestroyDescriptorPool(device, globalDescriptorPool, allocationCallbacks);
+    descriptorLayoutCache.destroy();
+    uniformRing.destroy(device, allocationCallbacks);
+    storageRing.destroy(device, allocationCallbacks);
+
+    if (debugUtilsMessenger != VK_NULL_HANDLE) {
+        auto debugUtilsDestroyFunc = (PFN_vkDestroyDebugUtilsMessengerEXT)
+                vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+        debugUtilsDestroyFunc(instance, debugUtilsMessenger, allocationCallbacks);
     }
 
-    auto debugUtilsDestroyFunc = (PFN_vkDestroyDebugUtilsMessengerEXT)
-            vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    debugUtilsDestroyFunc(instance, debugUtilsMessenger, allocationCallbacks);
-
     vkDestroyDevice(device, allocationCallbacks);
-    vkDestroySurfaceKHR(instance, surface, allocationCallbacks);
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface, allocationCallbacks);
+    }
     vkDestroyInstance(instance, allocationCallbacks);
 }
 
 bool Vulkan::isInstanceLayerAvailable(const char *layerName) {
-    uint32_t availableLayerCount;
-    VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, nullptr))
-    std::vector<VkLayerProperties> availableLayers(availableLayerCount);
-    VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, availableLayers.data()))
+    if (availableLayers.empty()) {
+        uint32_t availableLayerCount;
+        VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, nullptr))
+        availableLayers.resize(availableLayerCount);
+        VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, availableLayers.data()))
+    }
 
     auto found = std::find_if(availableLayers.begin(), availableLayers.end(),
                               [layerName](VkLayerProperties properties) -> bool {
@@ -87,29 +243,37 @@ uint32_t Vulkan::getApiVersion() const {
     return apiVersion;
 }
 
-void Vulkan::createInstance(const char *applicationName, SDL_Window *window) {
-    uint32_t apiVersion = getApiVersion();
-    uint32_t availableLayerCount;
-    VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, nullptr))
-    std::vector<VkLayerProperties> availableLayers(availableLayerCount);
-    VK_CHECK(vkEnumerateInstanceLayerProperties(&availableLayerCount, availableLayers.data()))
+bool Vulkan::isValidationRequested() {
+    if (auto validation = getenv("DARK_STAR_VALIDATION")) {
+        return std::string(validation) != "0";
+    }
+
+    return VALIDATION_BY_DEFAULT;
+}
+
+void Vulkan::createInstance(const char *applicationName, const std::vector<const char *> &windowExtensions) {
+    apiVersion = getApiVersion();
+    validationEnabled = isValidationRequested();
 
-    std::vector<const char *> requestedLayers = {"VK_LAYER_KHRONOS_validation", "VK_LAYER_KHRONOS_profiles"};
     std::vector<const char *> layers;
-    for (const char *layerName: requestedLayers) {
-        if (isInstanceLayerAvailable(layerName)) {
-            std::cout << "Enabling layer: " << layerName << std::endl;
-            layers.push_back(layerName);
+    if (validationEnabled) {
+        std::vector<const char *> requestedLayers = {"VK_LAYER_KHRONOS_validation", "VK_LAYER_KHRONOS_profiles"};
+        for (const char *layerName: requestedLayers) {
+            if (isInstanceLayerAvailable(layerName)) {
+                std::cout << "Enabling layer: " << layerName << std::endl;
+                layers.push_back(layerName);
+            }
         }
     }
 
-    uint32_t windowExtensionCount = 0;
-    SDL_Vulkan_GetInstanceExtensions(window, &windowExtensionCount, nullptr);
-    std::vector<const char *> extensions(windowExtensionCount);
-    SDL_Vulkan_GetInstanceExtensions(window, &windowExtensionCount, extensions.data());
+    std::vector<const char *> extensions = windowExtensions;
+    if (!config.headless) {
+        extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+    }
     extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-    extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+    if (validationEnabled) {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
 
     VkApplicationInfo applicationInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
     applicationInfo.apiVersion = apiVersion;
@@ -133,6 +297,13 @@ void Vulkan::createDebugUtilsMessenger() {
     VkDebugUtilsMessengerCreateInfoEXT createInfo = {VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
     createInfo.messageSeverity =
             VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    // The layers only produce the chatty severities when something will write them
+    if (Logger::get().isEnabled(LOG_LEVEL_DEBUG)) {
+        createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    if (Logger::get().isEnabled(LOG_LEVEL_VERBOSE)) {
+        createInfo.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
     createInfo.messageType =
             VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT |
             VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
@@ -148,57 +319,66 @@ void Vulkan::createDebugUtilsMessenger() {
 VkBool32
 Vulkan::debugLog(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageTypes,
                  const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData) {
-    std::cout << pCallbackData->pMessage << std::endl;
+    // Called on whatever thread made the offending call, the message is only queued here
+    auto level = LOG_LEVEL_VERBOSE;
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        level = LOG_LEVEL_ERROR;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        level = LOG_LEVEL_WARNING;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        level = LOG_LEVEL_DEBUG;
+    }
+
+    const char *category = "general";
+    if (messageTypes & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) {
+        category = "validation";
+    } else if (messageTypes & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) {
+        category = "performance";
+    }
+
+    Logger::get().write(level, category, pCallbackData->pMessage, pCallbackData->messageIdNumber);
     return VK_FALSE;
 }
 
-void Vulkan::selectBestPhysicalDevice() {
-    uint32_t count;
-    VK_CHECK(vkEnumeratePhysicalDevices(instance, &count, nullptr))
-    std::vector<VkPhysicalDevice> devices(count);
-    VK_CHECK(vkEnumeratePhysicalDevices(instance, &count, devices.data()))
+PhysicalDeviceSelectorConfig Vulkan::getPhysicalDeviceSelectorConfig() const {
+    auto selectorConfig = config.physicalDevice;
+    selectorConfig.requireSwapChain = !config.headless;
+    selectorConfig.instanceApiVersion = apiVersion;
+    if (auto preferred = getenv("DARK_STAR_PHYSICAL_DEVICE")) {
+        selectorConfig.preferredDevice = preferred;
+    }
+    // Empty to disable the cache
+    if (auto cacheFile = getenv("DARK_STAR_PHYSICAL_DEVICE_CACHE")) {
+        selectorConfig.cacheFile = cacheFile;
+    }
 
-    auto cmp = [](PhysicalDevice a, PhysicalDevice b) -> int {
-        return a.priority > b.priority;
-    };
+    return selectorConfig;
+}
 
-    std::priority_queue<PhysicalDevice, std::vector<PhysicalDevice>, decltype(cmp)> devicePriorities(cmp);
-
-    for (const auto &it: devices) {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(it, &properties);
-
-        uint32_t priority = 0;
-        switch (properties.deviceType) {
-            case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-                priority = 0;
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-                priority = 3;
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-                priority = 4;
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-                priority = 2;
-                break;
-            case VK_PHYSICAL_DEVICE_TYPE_CPU:
-                priority = 1;
-                break;
-            default:
-                priority = 0;
-                break;
-        }
+void Vulkan::selectBestPhysicalDevice() {
+    setPhysicalDevice(physicalDeviceSelector.select(instance, VK_NULL_HANDLE, getPhysicalDeviceSelectorConfig()));
+}
 
-        devicePriorities.push({
-                                      .vkPhysicalDevice = it,
-                                      .properties = properties,
-                                      .priority = priority,
-                              });
+void Vulkan::ensurePresentSupport() {
+    if (PhysicalDeviceSelector::isPresentSupported(physicalDevice.vkPhysicalDevice, surface)) {
+        return;
     }
 
-    physicalDevice = devicePriorities.top();
-    std::cout << "Selected physical device: " << physicalDevice.properties.deviceName << std::endl;
+    std::cout << std::format("{} can not present to the window, selecting again",
+                             physicalDevice.properties.deviceName) << std::endl;
+    setPhysicalDevice(physicalDeviceSelector.select(instance, surface, getPhysicalDeviceSelectorConfig()));
+}
+
+void Vulkan::setPhysicalDevice(const PhysicalDevice &selected) {
+    physicalDevice = selected;
+    std::cout << "Selected physical device: " << physicalDevice.properties.deviceName
+              << (physicalDeviceSelector.isFromCache() ? " (cached)" : "") << std::endl;
+
+    uint32_t extensionCount = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice.vkPhysicalDevice, nullptr, &extensionCount, nullptr))
+    availableDeviceExtensions.resize(extensionCount);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice.vkPhysicalDevice, nullptr, &extensionCount,
+                                                  availableDeviceExtensions.data()))
 }
 
 std::vector<QueueFamily> Vulkan::fetchAvailableQueueFamilies() {
@@ -228,8 +408,12 @@ std::vector<QueueFamily> Vulkan::fetchAvailableQueueFamilies() {
             family.features.push_back(QUEUE_FEATURE_TRANSFER);
         }
 
-        VkBool32 presentSupported = VK_FALSE;
-        VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice.vkPhysicalDevice, i, surface, &presentSupported));
+        // Headless frames are "presented" by the queue that rendered them
+        VkBool32 presentSupported = config.headless && (properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        if (!config.headless) {
+            VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice.vkPhysicalDevice, i, surface,
+                                                          &presentSupported));
+        }
         if (presentSupported) {
             family.features.push_back(QUEUE_FEATURE_PRESENT);
         }
@@ -241,13 +425,7 @@ std::vector<QueueFamily> Vulkan::fetchAvailableQueueFamilies() {
 }
 
 bool Vulkan::isDeviceExtensionAvailable(const std::string &extensionName) const {
-    uint32_t count = 0;
-    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice.vkPhysicalDevice, nullptr, &count, nullptr));
-    std::vector<VkExtensionProperties> availableExtensions(count);
-    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice.vkPhysicalDevice, nullptr, &count,
-                                                  availableExtensions.data()));
-
-    for (const auto &extension: availableExtensions) {
+    for (const auto &extension: availableDeviceExtensions) {
         if (extensionName == std::string(extension.extensionName)) {
             return true;
         }
@@ -256,6 +434,84 @@ bool Vulkan::isDeviceExtensionAvailable(const std::string &extensionName) const
     return false;
 }
 
+bool Vulkan::isDescriptorIndexingSupported() const {
+    if (getenv("DARK_STAR_DISABLE_BINDLESS")) {
+        return false;
+    }
+
+    if (std::min(apiVersion, physicalDevice.properties.apiVersion) < VK_API_VERSION_1_2 &&
+        !isDeviceExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice.vkPhysicalDevice, &features);
+
+    return PhysicalDeviceSelector::isDescriptorIndexingSupported(features.features, indexingFeatures);
+}
+
+bool Vulkan::isDynamicRenderingSupported() const {
+    if (getenv("DARK_STAR_LEGACY_RENDER_PASS")) {
+        return false;
+    }
+
+    uint32_t version = std::min(apiVersion, physicalDevice.properties.apiVersion);
+    if (version < VK_API_VERSION_1_3 &&
+        (version < VK_API_VERSION_1_2 || !isDeviceExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ||
+         !isDeviceExtensionAvailable(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))) {
+        return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES};
+    VkPhysicalDeviceSynchronization2Features synchronization2Features{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
+    dynamicRenderingFeatures.pNext = &synchronization2Features;
+
+    VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice.vkPhysicalDevice, &features);
+
+    return dynamicRenderingFeatures.dynamicRendering && synchronization2Features.synchronization2;
+}
+
+bool Vulkan::isAsyncComputeRequested() const {
+    if (auto enabled = getenv("DARK_STAR_ASYNC_COMPUTE")) {
+        return std::string(enabled) != "0";
+    }
+
+    return config.asyncCompute;
+}
+
+bool Vulkan::isTimelineSemaphoreSupported() const {
+    if (std::min(apiVersion, physicalDevice.properties.apiVersion) < VK_API_VERSION_1_2 &&
+        !isDeviceExtensionAvailable(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &timelineSemaphoreFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice.vkPhysicalDevice, &features);
+
+    return timelineSemaphoreFeatures.timelineSemaphore;
+}
+
+void Vulkan::loadDynamicRenderingFunctions() {
+    cmdBeginRendering = (PFN_vkCmdBeginRendering)
+            loadDeviceFunction(device, "vkCmdBeginRendering", "vkCmdBeginRenderingKHR");
+    cmdEndRendering = (PFN_vkCmdEndRendering)
+            loadDeviceFunction(device, "vkCmdEndRendering", "vkCmdEndRenderingKHR");
+    cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)
+            loadDeviceFunction(device, "vkCmdPipelineBarrier2", "vkCmdPipelineBarrier2KHR");
+    queueSubmit2 = (PFN_vkQueueSubmit2)
+            loadDeviceFunction(device, "vkQueueSubmit2", "vkQueueSubmit2KHR");
+}
+
 void Vulkan::createSurface(SDL_Window *window) {
     if (!SDL_Vulkan_CreateSurface(window, instance, &surface)) {
         std::cerr << "Failed to create Vulkan surface with SDL: " << SDL_GetError() << std::endl;
@@ -278,16 +534,81 @@ void Vulkan::createDevice() {
     }
 
     std::vector<const char *> extensions;
-    if (!isDeviceExtensionAvailable(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
-        throw std::runtime_error(std::format("Extension unavailable: {}", VK_KHR_SWAPCHAIN_EXTENSION_NAME));
+    if (!config.headless) {
+        if (!isDeviceExtensionAvailable(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+            throw std::runtime_error(std::format("Extension unavailable: {}", VK_KHR_SWAPCHAIN_EXTENSION_NAME));
+        }
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
 
-    extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     if (isDeviceExtensionAvailable("VK_KHR_portability_subset")) {
         extensions.push_back("VK_KHR_portability_subset");
     }
 
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES};
+    VkPhysicalDeviceSynchronization2Features synchronization2Features{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    VkPhysicalDeviceFeatures2 enabledFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+
+    descriptorIndexingSupported = isDescriptorIndexingSupported();
+    if (descriptorIndexingSupported) {
+        if (std::min(apiVersion, physicalDevice.properties.apiVersion) < VK_API_VERSION_1_2) {
+            extensions.push_back(VK_KHR_MAINTENANCE_3_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+
+        enabledFeatures.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.pNext = enabledFeatures.pNext;
+        enabledFeatures.pNext = &indexingFeatures;
+    }
+    std::cout << "Bindless descriptors: " << (descriptorIndexingSupported ? "enabled" : "unavailable") << std::endl;
+
+    dynamicRenderingEnabled = isDynamicRenderingSupported();
+    if (dynamicRenderingEnabled) {
+        if (std::min(apiVersion, physicalDevice.properties.apiVersion) < VK_API_VERSION_1_3) {
+            extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        }
+
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        synchronization2Features.synchronization2 = VK_TRUE;
+        synchronization2Features.pNext = enabledFeatures.pNext;
+        dynamicRenderingFeatures.pNext = &synchronization2Features;
+        enabledFeatures.pNext = &dynamicRenderingFeatures;
+    }
+    std::cout << "Render path: " << (dynamicRenderingEnabled ? "dynamic rendering" : "render pass objects")
+              << std::endl;
+
+    // Only async compute synchronizes with timeline semaphores
+    timelineSemaphoreEnabled = isAsyncComputeRequested() && isTimelineSemaphoreSupported();
+    if (timelineSemaphoreEnabled) {
+        if (std::min(apiVersion, physicalDevice.properties.apiVersion) < VK_API_VERSION_1_2) {
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
+
+        timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        timelineSemaphoreFeatures.pNext = enabledFeatures.pNext;
+        enabledFeatures.pNext = &timelineSemaphoreFeatures;
+    }
+
+    memoryBudgetSupported = isDeviceExtensionAvailable(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo createInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    createInfo.pNext = &enabledFeatures;
     createInfo.enabledExtensionCount = extensions.size();
     createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.queueCreateInfoCount = queueCreateInfos.size();
@@ -296,6 +617,10 @@ void Vulkan::createDevice() {
 
     VK_CHECK(vkCreateDevice(physicalDevice.vkPhysicalDevice, &createInfo, allocationCallbacks, &device))
 
+    if (dynamicRenderingEnabled) {
+        loadDynamicRenderingFunctions();
+    }
+
     for (auto &queueFamily: queueFamilies) {
         vkGetDeviceQueue(device, queueFamily.index, 0, &queueFamily.queue);
 
@@ -305,37 +630,67 @@ void Vulkan::createDevice() {
     }
 }
 
-VkSurfaceFormatKHR Vulkan::selectSurfaceFormat() {
-    uint32_t formatCount = 0;
-    VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice.vkPhysicalDevice, surface, &formatCount, nullptr))
-    std::vector<VkSurfaceFormatKHR> formats(formatCount);
-    VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice.vkPhysicalDevice, surface, &formatCount,
-                                                  formats.data()))
+const QueueFamily &Vulkan::findQueueFamily(VkQueueFlags required, VkQueueFlags avoided) const {
+    const QueueFamily *result = nullptr;
+    int resultOverlap = 0;
+
+    for (const auto &queueFamily: queueFamilies) {
+        auto flags = queueFamily.properties.queueFlags;
+        if ((flags & required) != required) {
+            continue;
+        }
+
+        int overlap = std::popcount(flags & avoided);
+        if (result == nullptr || overlap < resultOverlap) {
+            result = &queueFamily;
+            resultOverlap = overlap;
+        }
+    }
+
+    if (result == nullptr) {
+        throw std::runtime_error(std::format("No queue family with flags: {}", string_VkQueueFlags(required)));
+    }
 
-    for (const auto &format: formats) {
-        std::cout << "Found surface format: " << string_VkColorSpaceKHR(format.colorSpace) << " - "
-                  << string_VkFormat(format.format) << std::endl;
+    return *result;
+}
+
+VkSurfaceFormatKHR Vulkan::selectSurfaceFormat() {
+    // The formats of a surface do not change, the swapchain recreation on resize reuses the first query
+    if (surfaceFormats.empty()) {
+        uint32_t formatCount = 0;
+        VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice.vkPhysicalDevice, surface, &formatCount,
+                                                      nullptr))
+        surfaceFormats.resize(formatCount);
+        VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice.vkPhysicalDevice, surface, &formatCount,
+                                                      surfaceFormats.data()))
+        for (const auto &format: surfaceFormats) {
+            logVerbose("vulkan", "Available surface format: {} - {}", string_VkColorSpaceKHR(format.colorSpace),
+                       string_VkFormat(format.format));
+        }
+    }
 
+    for (const auto &format: surfaceFormats) {
         // TODO is this the right choice?
         if (format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && format.format == VK_FORMAT_B8G8R8A8_SRGB) {
             return format;
         }
     }
 
-    return formats.front();
+    logDebug("vulkan", "No sRGB B8G8R8A8 surface format, falling back to the first one");
+    return surfaceFormats.front();
 }
 
 VkPresentModeKHR Vulkan::selectPresentMode() {
-    uint32_t presentModeCount = 0;
-    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice.vkPhysicalDevice, surface, &presentModeCount,
-                                                       nullptr))
-    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
-    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice.vkPhysicalDevice, surface, &presentModeCount,
-                                                       presentModes.data()))
+    if (presentModes.empty()) {
+        uint32_t presentModeCount = 0;
+        VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice.vkPhysicalDevice, surface,
+                                                           &presentModeCount, nullptr))
+        presentModes.resize(presentModeCount);
+        VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice.vkPhysicalDevice, surface,
+                                                           &presentModeCount, presentModes.data()))
+    }
 
     for (const auto &presentMode: presentModes) {
-        std::cout << "Found present mode: " << string_VkPresentModeKHR(presentMode) << std::endl;
-
         if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
             return presentMode;
         } else if (presentMode == VK_PRESENT_MODE_FIFO_KHR) {
@@ -347,7 +702,18 @@ VkPresentModeKHR Vulkan::selectPresentMode() {
 }
 
 void Vulkan::createSwapChain() {
+    if (config.headless) {
+        createHeadlessImages();
+        return;
+    }
+
+    bool firstSwapChain = surfaceFormats.empty();
     surfaceFormat = selectSurfaceFormat();
+    auto presentMode = selectPresentMode();
+    if (firstSwapChain) {
+        logInfo("vulkan", "Surface format: {} - {}, present mode: {}", string_VkColorSpaceKHR(surfaceFormat.colorSpace),
+                string_VkFormat(surfaceFormat.format), string_VkPresentModeKHR(presentMode));
+    }
 
     auto presentQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_PRESENT)->second;
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
@@ -359,8 +725,14 @@ void Vulkan::createSwapChain() {
     createInfo.oldSwapchain = nullptr;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.clipped = false;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    createInfo.presentMode = selectPresentMode();
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                            getUpscaleImageUsage(surfaceCapabilities.supportedUsageFlags) |
+                            getCaptureImageUsage(surfaceCapabilities.supportedUsageFlags);
+    if (firstSwapChain && !frameCaptureSupported) {
+        std::cout << std::format("Frame capture: unavailable, {} swapchain images can not be read back",
+                                 string_VkFormat(surfaceFormat.format)) << std::endl;
+    }
+    createInfo.presentMode = presentMode;
     createInfo.imageFormat = surfaceFormat.format;
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageArrayLayers = 1;
@@ -397,6 +769,84 @@ void Vulkan::createSwapChain() {
     }
 }
 
+VkImageUsageFlags Vulkan::getUpscaleImageUsage(VkImageUsageFlags supportedUsage) {
+    if (!dynamicResolution.isEnabled()) {
+        return 0;
+    }
+
+    // The scene target has the output's format, so both ends of the blit need the same support
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice.vkPhysicalDevice, surfaceFormat.format, &formatProperties);
+    auto features = formatProperties.optimalTilingFeatures;
+    auto blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if (!(supportedUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || (features & blitFeatures) != blitFeatures) {
+        std::cout << std::format("Dynamic resolution: unavailable, {} images can not be blitted",
+                                 string_VkFormat(surfaceFormat.format)) << std::endl;
+        dynamicResolution.disable();
+        return 0;
+    }
+
+    upscaleFilter = features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? VK_FILTER_LINEAR
+                                                                                 : VK_FILTER_NEAREST;
+    return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+}
+
+VkImageUsageFlags Vulkan::getCaptureImageUsage(VkImageUsageFlags supportedUsage) {
+    frameCaptureSupported = (supportedUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) &&
+                            FrameCapture::isFormatSupported(surfaceFormat.format);
+    return frameCaptureSupported ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
+}
+
+void Vulkan::createHeadlessImages() {
+    surfaceFormat = {HEADLESS_FORMAT, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    swapChainExtent = config.headlessExtent;
+
+    for (uint32_t i = 0; i < HEADLESS_IMAGE_COUNT; ++i) {
+        VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = surfaceFormat.format;
+        imageCreateInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                getUpscaleImageUsage(VK_IMAGE_USAGE_TRANSFER_DST_BIT) |
+                                getCaptureImageUsage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image;
+        VK_CHECK(vkCreateImage(device, &imageCreateInfo, allocationCallbacks, &image))
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+        VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocateInfo.allocationSize = memoryRequirements.size;
+        allocateInfo.memoryTypeIndex = findMemoryType(physicalDevice.vkPhysicalDevice,
+                                                      memoryRequirements.memoryTypeBits,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkDeviceMemory memory;
+        VK_CHECK(vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &memory))
+        VK_CHECK(vkBindImageMemory(device, image, memory, 0))
+
+        VkImageViewCreateInfo imageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        imageViewCreateInfo.image = image;
+        imageViewCreateInfo.format = surfaceFormat.format;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        VkImageView imageView;
+        VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, allocationCallbacks, &imageView))
+
+        images.push_back(image);
+        imageViews.push_back(imageView);
+        headlessImageMemory.push_back(memory);
+    }
+}
+
 void Vulkan::cleanupSwapChain() {
     for (auto &frameBuffer: frameBuffers) {
         vkDestroyFramebuffer(device, frameBuffer, allocationCallbacks);
@@ -408,39 +858,118 @@ void Vulkan::cleanupSwapChain() {
     }
     imageViews.clear();
 
+    if (config.headless) {
+        for (size_t i = 0; i < images.size(); ++i) {
+            vkDestroyImage(device, images[i], allocationCallbacks);
+            vkFreeMemory(device, headlessImageMemory[i], allocationCallbacks);
+        }
+        images.clear();
+        headlessImageMemory.clear();
+        return;
+    }
+
     vkDestroySwapchainKHR(device, swapChain, allocationCallbacks);
 }
 
 void Vulkan::recreateSwapChain() {
     VK_CHECK(vkDeviceWaitIdle(device))
 
+    auto start = std::chrono::steady_clock::now();
     cleanupSwapChain();
 
     createSwapChain();
     createFrameBuffers();
+
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    renderPathStats.recreateMicroseconds += elapsed.count();
+    renderPathStats.recreateCount++;
+}
+
+void Vulkan::createShaderLibrary() {
+    ShaderLibraryConfig config{};
+    if (auto searchPath = getenv("DARK_STAR_SHADER_PATH")) {
+        std::stringstream paths(searchPath);
+        std::string path;
+        while (std::getline(paths, path, ':')) {
+            if (!path.empty()) {
+                config.searchPaths.push_back(path);
+            }
+        }
+    }
+    config.searchPaths.push_back(DARK_STAR_SHADER_SOURCE_DIR);
+    config.searchPaths.push_back(DARK_STAR_SHADER_BINARY_DIR);
+    config.searchPaths.push_back("..");
+    config.searchPaths.push_back(".");
+
+    if (auto cacheDirectory = getenv("DARK_STAR_SHADER_CACHE")) {
+        config.cacheDirectory = cacheDirectory;
+    }
+
+    config.hotReload = HOT_RELOAD_BY_DEFAULT;
+    if (auto hotReload = getenv("DARK_STAR_SHADER_HOT_RELOAD")) {
+        config.hotReload = std::string(hotReload) != "0";
+    }
+
+    shaderLibrary.initialize(config);
 }
 
-VkShaderModule Vulkan::createShaderModule(const std::string &shaderFilePath) {
-    auto shaderCode = readBinaryFile(shaderFilePath);
+VkShaderModule Vulkan::createShaderModule(const std::string &shaderName) {
+    auto shaderCode = shaderLibrary.getCode(shaderName);
+
     VkShaderModuleCreateInfo createInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    createInfo.codeSize = shaderCode.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
+    createInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+    createInfo.pCode = shaderCode.data();
 
     VkShaderModule result;
     VK_CHECK(vkCreateShaderModule(device, &createInfo, allocationCallbacks, &result));
     return result;
 }
 
+void Vulkan::createDynamicResolution() {
+    auto resolutionConfig = config.dynamicResolution;
+    if (auto enabled = getenv("DARK_STAR_DYNAMIC_RESOLUTION")) {
+        resolutionConfig.enabled = std::string(enabled) != "0";
+    }
+    if (auto budget = getenv("DARK_STAR_GPU_BUDGET_MS")) {
+        resolutionConfig.budgetMilliseconds = std::stof(budget);
+    }
+
+    dynamicResolution.initialize(resolutionConfig);
+}
+
+void Vulkan::createFrameCapture() {
+    auto captureConfig = config.capture;
+    if (auto directory = getenv("DARK_STAR_CAPTURE_DIR")) {
+        captureConfig.directory = directory;
+    }
+    if (auto format = getenv("DARK_STAR_CAPTURE_FORMAT")) {
+        captureConfig.format = std::string(format) == "raw" ? CAPTURE_FORMAT_RAW : CAPTURE_FORMAT_PNG;
+    }
+
+    frameCapture.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, captureConfig);
+}
+
 void Vulkan::createRenderPass() {
+    if (dynamicRenderingEnabled) {
+        return;
+    }
+
+    renderPass = createColorRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+    // Continues drawing into the scene after the upscale or the async compute wait
+    overlayRenderPass = createColorRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+}
+
+VkRenderPass Vulkan::createColorRenderPass(VkAttachmentLoadOp loadOp) {
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = surfaceFormat.format;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.loadOp = loadOp;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Layout transitions in and out of the pass are done by the render graph
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -468,25 +997,70 @@ void Vulkan::createRenderPass() {
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &subpassDependency;
 
-    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, allocationCallbacks, &renderPass));
-
+    VkRenderPass result;
+    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, allocationCallbacks, &result));
+    return result;
 }
 
 void Vulkan::createPipeline() {
-    auto vertShaderModule = createShaderModule("../basic.vert.spv");
-    auto fragShaderModule = createShaderModule("../basic.frag.spv");
-    shaderModules.push_back(vertShaderModule);
-    shaderModules.push_back(fragShaderModule);
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    VkDescriptorSetLayout setLayouts[] = {globalSetLayout, bindless.getLayout()};
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocationCallbacks, &pipelineLayout));
+
+    std::string pipelineCacheFile = "pipeline_cache.bin";
+    if (auto fileName = getenv("DARK_STAR_PIPELINE_CACHE")) {
+        pipelineCacheFile = fileName;
+    }
+    pipelineCache.initialize(physicalDevice.properties, device, allocationCallbacks, pipelineCacheFile);
+
+    shaderVariantMode = SHADER_VARIANT_MODE_SPECIALIZED;
+    if (auto mode = getenv("DARK_STAR_SHADER_VARIANTS")) {
+        if (std::string(mode) == "uber") {
+            shaderVariantMode = SHADER_VARIANT_MODE_UBER;
+        } else if (std::string(mode) == "compare") {
+            shaderVariantMode = SHADER_VARIANT_MODE_COMPARE;
+        }
+    }
+
+    pipelineVariants.initialize(device, allocationCallbacks, SHADER_FEATURE_ALL,
+                                [this](const VkSpecializationInfo &specialization) {
+                                    return buildPipeline(specialization);
+                                });
+
+    // Variants are built on first use, the ones the first frame needs are built here during startup
+    if (shaderVariantMode != SHADER_VARIANT_MODE_UBER) {
+        pipelineVariants.get(MAIN_PASS_FEATURES);
+    }
+    if (shaderVariantMode != SHADER_VARIANT_MODE_SPECIALIZED) {
+        pipelineVariants.getUber();
+    }
+}
+
+VkPipeline Vulkan::buildPipeline(const VkSpecializationInfo &specialization) {
+    auto vertShaderModule = createShaderModule(BASIC_VERTEX_SHADER);
+    auto fragShaderModule = createShaderModule(BASIC_FRAGMENT_SHADER);
 
     VkPipelineShaderStageCreateInfo vertStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
     vertStageCreateInfo.module = vertShaderModule;
     vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertStageCreateInfo.pName = "main";
+    vertStageCreateInfo.pSpecializationInfo = &specialization;
 
     VkPipelineShaderStageCreateInfo fragStageCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
     fragStageCreateInfo.module = fragShaderModule;
     fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragStageCreateInfo.pName = "main";
+    fragStageCreateInfo.pSpecializationInfo = &specialization;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertStageCreateInfo, fragStageCreateInfo};
 
@@ -534,10 +1108,6 @@ void Vulkan::createPipeline() {
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-
-    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocationCallbacks, &pipelineLayout));
-
     VkGraphicsPipelineCreateInfo pipelineInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = sizeof(shaderStages) / sizeof(VkPipelineShaderStageCreateInfo);
@@ -553,10 +1123,121 @@ void Vulkan::createPipeline() {
     pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
 
-    VK_CHECK(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, allocationCallbacks, &pipeline))
+    VkPipelineRenderingCreateInfo renderingCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+    renderingCreateInfo.colorAttachmentCount = 1;
+    renderingCreateInfo.pColorAttachmentFormats = &surfaceFormat.format;
+    if (dynamicRenderingEnabled) {
+        pipelineInfo.pNext = &renderingCreateInfo;
+    }
+
+    VkPipeline result;
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache.get(), 1, &pipelineInfo, allocationCallbacks, &result))
+
+    // Modules are only needed while the pipeline is created
+    vkDestroyShaderModule(device, vertShaderModule, allocationCallbacks);
+    vkDestroyShaderModule(device, fragShaderModule, allocationCallbacks);
+    return result;
+}
+
+void Vulkan::onShaderReloaded(const std::string &shaderName) {
+    immediateRenderer.onShaderReloaded(shaderName);
+    particleSystem.onShaderReloaded(shaderName);
+    if (shaderName != BASIC_VERTEX_SHADER && shaderName != BASIC_FRAGMENT_SHADER) {
+        return;
+    }
+
+    // Runs on the shader watcher thread, the render loop keeps using the current variants until the next frame
+    // boundary installs the rebuilt ones
+    pipelineVariants.rebuild();
+}
+
+bool Vulkan::isUberShaderFrame() const {
+    switch (shaderVariantMode) {
+        case SHADER_VARIANT_MODE_UBER:
+            return true;
+        case SHADER_VARIANT_MODE_COMPARE:
+            return (frameNumber / SHADER_COMPARE_INTERVAL) % 2 == 1;
+        default:
+            return false;
+    }
+}
+
+void Vulkan::printShaderVariantReport() const {
+    auto variantStats = pipelineVariants.getStats();
+    std::cout << std::format("Shader variants: {} pipelines, {} requests, {} builds in {:.1f} ms",
+                             variantStats.variantCount, variantStats.requests, variantStats.builds,
+                             variantStats.buildMilliseconds) << std::endl;
+
+    double specialized = gpuProfiler.getAverageMilliseconds(MAIN_PASS_SCOPE_SPECIALIZED);
+    double uber = gpuProfiler.getAverageMilliseconds(MAIN_PASS_SCOPE_UBER);
+    if (specialized > 0.0 && uber > 0.0) {
+        std::cout << std::format("Main pass GPU time: specialized {:.3f} ms, uber {:.3f} ms ({:+.1f}% specialized)",
+                                 specialized, uber, (specialized - uber) / uber * 100.0) << std::endl;
+    } else if (specialized > 0.0 || uber > 0.0) {
+        std::cout << std::format("Main pass GPU time: {:.3f} ms ({})", specialized > 0.0 ? specialized : uber,
+                                 specialized > 0.0 ? "specialized" : "uber") << std::endl;
+    }
+}
+
+void Vulkan::printParticleReport() const {
+    if (!particleSystem.isActive()) {
+        return;
+    }
+
+    const auto &stats = particleSystem.getStats();
+    const auto &computeProfiler = asyncCompute.isEnabled() ? asyncCompute.getProfiler() : gpuProfiler;
+    std::cout << std::format("Particles: {} alive of {}, {} emitters, {} requested, GPU simulate {:.3f} ms, "
+                             "sort {:.3f} ms, draw {:.3f} ms", stats.aliveCount, stats.capacity, stats.emitterCount,
+                             stats.requestedParticles, computeProfiler.getAverageMilliseconds(PARTICLE_SCOPE_SIMULATE),
+                             computeProfiler.getAverageMilliseconds(PARTICLE_SCOPE_SORT),
+                             gpuProfiler.getAverageMilliseconds(PARTICLE_SCOPE_DRAW)) << std::endl;
+}
+
+void Vulkan::printDynamicResolutionReport() const {
+    const auto &stats = dynamicResolution.getStats();
+    if (!dynamicResolution.isEnabled() || stats.sampleCount == 0) {
+        return;
+    }
+
+    std::cout << std::format("Dynamic resolution: scale {:.2f}, GPU frame {:.2f} ms smoothed, {:.1f}% of {} frames "
+                             "within the {:.1f} ms budget, {} decreases, {} increases", stats.scale,
+                             stats.smoothedMilliseconds, dynamicResolution.getBudgetAdherence() * 100.0,
+                             stats.sampleCount, dynamicResolution.getBudgetMilliseconds(), stats.decreaseCount,
+                             stats.increaseCount) << std::endl;
+}
+
+void Vulkan::printAsyncComputeReport() const {
+    const auto &stats = asyncCompute.getStats();
+    if (stats.frameCount == 0) {
+        return;
+    }
+
+    std::cout << std::format("Async compute: {:.3f} ms per frame on queue family {}, {:.3f} ms ({:.1f}%) overlapped "
+                             "with graphics over {} frames", stats.computeMilliseconds / stats.frameCount,
+                             asyncCompute.getQueueFamilyIndex(), stats.overlapMilliseconds / stats.frameCount,
+                             stats.computeMilliseconds > 0.0
+                             ? stats.overlapMilliseconds / stats.computeMilliseconds * 100.0 : 0.0,
+                             stats.frameCount) << std::endl;
+}
+
+void Vulkan::printFrameCaptureReport() const {
+    auto stats = frameCapture.getStats();
+    if (stats.capturedFrames + stats.failedFrames + stats.droppedFrames == 0) {
+        return;
+    }
+
+    std::cout << std::format("Frame capture: {} frames in {:.2f} s ({:.1f} fps), {:.2f} ms encode avg, {} dropped, "
+                             "{} failed", stats.capturedFrames, stats.elapsedSeconds,
+                             stats.elapsedSeconds > 0.0 ? stats.capturedFrames / stats.elapsedSeconds : 0.0,
+                             stats.capturedFrames > 0 ? stats.encodeMilliseconds / stats.capturedFrames : 0.0,
+                             stats.droppedFrames, stats.failedFrames) << std::endl;
 }
 
 void Vulkan::createFrameBuffers() {
+    if (dynamicRenderingEnabled) {
+        return;
+    }
+
     frameBuffers.resize(imageViews.size());
 
     for (int i = 0; i < imageViews.size(); ++i) {
@@ -574,36 +1255,247 @@ void Vulkan::createFrameBuffers() {
 }
 
 void Vulkan::createVertexBuffer(const std::vector<Vertex> &vertices) {
-    VkBufferCreateInfo createInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
-    createInfo.size = vertices.size() * sizeof(Vertex);
-    createInfo.usage = VK_BUFFER_USAGE_2_VERTEX_BUFFER_BIT_KHR;
-    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vertexBuffer = createBuffer(physicalDevice.vkPhysicalDevice, device, allocationCallbacks,
+                                vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void Vulkan::createFrameResources() {
+    const auto &limits = physicalDevice.properties.limits;
+
+    uniformRing.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, UNIFORM_RING_FRAME_SIZE,
+                           sizeof(CameraData), limits.minUniformBufferOffsetAlignment,
+                           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    storageRing.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, STORAGE_RING_FRAME_SIZE,
+                           sizeof(ObjectData) * MAX_OBJECTS_PER_DRAW_BINDING,
+                           limits.minStorageBufferOffsetAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    cameraData.viewProjection = glm::mat4(1.0f);
+
+    renderGraph.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks);
+    if (dynamicRenderingEnabled) {
+        renderGraph.enableSynchronization2(cmdPipelineBarrier2);
+    }
+    dumpRenderGraph = getenv("DARK_STAR_DUMP_RENDER_GRAPH") != nullptr;
+
+    const auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
+    gpuProfiler.initialize(device, allocationCallbacks, limits.timestampPeriod,
+                           graphicsQueue.properties.timestampValidBits, GPU_PROFILER_MAX_SCOPES);
+}
+
+void Vulkan::createDescriptors() {
+    descriptorLayoutCache.initialize(device, allocationCallbacks);
+    descriptorAllocator.initialize(device, allocationCallbacks);
+
+    VkDescriptorSetLayoutBinding cameraBinding{};
+    cameraBinding.binding = 0;
+    cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    cameraBinding.descriptorCount = 1;
+    cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding objectBinding{};
+    objectBinding.binding = 1;
+    objectBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    objectBinding.descriptorCount = 1;
+    objectBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    globalSetLayout = descriptorLayoutCache.getLayout({.bindings = {cameraBinding, objectBinding}});
+    bindless.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, descriptorLayoutCache,
+                        descriptorAllocator, descriptorIndexingSupported);
+
+    // The global set points at the ring buffers and is written once, per frame data only moves the dynamic offsets
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+    };
 
-    VK_CHECK(vkCreateBuffer(device, &createInfo, allocationCallbacks, &vertexBuffer))
-    vkGetBufferMemoryRequirements(device, vertexBuffer, &vertexBufferMemoryRequirements);
+    VkDescriptorPoolCreateInfo poolCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = poolSizes.size();
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, allocationCallbacks, &globalDescriptorPool))
+
+    VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = globalDescriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &globalSetLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &globalDescriptorSet))
+
+    VkDescriptorBufferInfo cameraBufferInfo{};
+    cameraBufferInfo.buffer = uniformRing.getBuffer();
+    cameraBufferInfo.offset = 0;
+    cameraBufferInfo.range = uniformRing.getBindingRange();
+
+    VkDescriptorBufferInfo objectBufferInfo{};
+    objectBufferInfo.buffer = storageRing.getBuffer();
+    objectBufferInfo.offset = 0;
+    objectBufferInfo.range = storageRing.getBindingRange();
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[0].dstSet = globalDescriptorSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writes[0].pBufferInfo = &cameraBufferInfo;
+
+    writes[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[1].dstSet = globalDescriptorSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    writes[1].pBufferInfo = &objectBufferInfo;
+
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+}
+
+void Vulkan::createStreaming() {
+    // Graphics families can always transfer even when they do not advertise it
+    const auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
+    const auto &transferQueue = findQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    uploadQueue.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, transferQueue.index,
+                           transferQueue.queue, UPLOAD_STAGING_SIZE);
+
+    std::vector<uint32_t> queueFamilyIndices = {graphicsQueue.index};
+    if (transferQueue.index != graphicsQueue.index) {
+        queueFamilyIndices.push_back(transferQueue.index);
+    }
+
+    TextureStreamerConfig config{};
+    if (auto budget = getenv("DARK_STAR_TEXTURE_BUDGET_MB")) {
+        config.budgetBytes = std::stoull(budget) * 1024 * 1024;
+    }
+
+    textureStreamer.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, uploadQueue, bindless,
+                               queueFamilyIndices, memoryBudgetSupported, config);
+}
+
+void Vulkan::createSceneInstances() {
+    const auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
+    std::vector<uint32_t> queueFamilyIndices = {graphicsQueue.index};
+    if (uploadQueue.getQueueFamilyIndex() != graphicsQueue.index) {
+        queueFamilyIndices.push_back(uploadQueue.getQueueFamilyIndex());
+    }
+
+    sceneInstances.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, uploadQueue,
+                              globalSetLayout, uniformRing.getBuffer(), uniformRing.getBindingRange(),
+                              MAX_OBJECTS_PER_DRAW_BINDING, queueFamilyIndices);
+}
+
+void Vulkan::setScene(const SceneSnapshot *snapshot) {
+    // The instance buffer and its descriptor set may still be used by frames in flight or pending uploads
+    VK_CHECK(vkDeviceWaitIdle(device))
+    uploadQueue.poll();
+    sceneInstances.setScene(snapshot);
+}
+
+const SceneInstancesStats &Vulkan::getSceneStats() const {
+    return sceneInstances.getStats();
+}
+
+TextureHandle Vulkan::loadTexture(const std::string &fileName) {
+    return textureStreamer.load(fileName);
+}
+
+void Vulkan::requestTextureResolution(TextureHandle texture, float screenPixels) {
+    textureStreamer.requestResolution(texture, screenPixels);
+}
+
+const TextureStreamerStats &Vulkan::getTextureStreamingStats() const {
+    return textureStreamer.getStats();
+}
+
+BindlessHandle Vulkan::getTextureImageHandle(TextureHandle texture) const {
+    return textureStreamer.getImageHandle(texture);
+}
+
+void Vulkan::createImmediateRenderer() {
+    ImmediateRendererConfig config{};
+    config.colorFormat = surfaceFormat.format;
+    config.renderPass = renderPass;
+
+    const auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
+    config.queueFamilyIndices = {graphicsQueue.index};
+    if (uploadQueue.getQueueFamilyIndex() != graphicsQueue.index) {
+        config.queueFamilyIndices.push_back(uploadQueue.getQueueFamilyIndex());
+    }
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = vertexBufferMemoryRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(vertexBufferMemoryRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &vertexBufferMemory))
+    immediateRenderer.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, shaderLibrary,
+                                 pipelineCache, bindless, uploadQueue, globalSetLayout, config);
+}
 
-    VK_CHECK(vkBindBufferMemory(device, vertexBuffer, vertexBufferMemory, 0))
+ImmediateBatch &Vulkan::getImmediateBatch() {
+    return immediateRenderer.getBatch();
 }
 
-uint32_t Vulkan::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice.vkPhysicalDevice, &memProperties);
+void Vulkan::setImmediateFont(const GlyphAtlas &atlas) {
+    immediateRenderer.setFont(atlas);
+}
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+void Vulkan::createParticleSystem() {
+    auto particleConfig = config.particles;
+    if (auto capacity = getenv("DARK_STAR_PARTICLE_CAPACITY")) {
+        std::string_view value(capacity);
+        uint32_t parsed = 0;
+        auto [last, error] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+        if (error == std::errc() && last == value.data() + value.size() && parsed > 0) {
+            particleConfig.capacity = parsed;
+        } else {
+            logWarning("vulkan", "Ignoring invalid DARK_STAR_PARTICLE_CAPACITY {}, keeping {} particles", value,
+                       particleConfig.capacity);
         }
     }
+    if (auto sort = getenv("DARK_STAR_PARTICLE_SORT")) {
+        particleConfig.sort = std::string(sort) != "0";
+    }
+
+    const auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
+    std::vector<uint32_t> queueFamilyIndices = {graphicsQueue.index};
+    if (asyncCompute.isEnabled()) {
+        queueFamilyIndices.push_back(asyncCompute.getQueueFamilyIndex());
+    }
+
+    particleSystem.initialize(physicalDevice.vkPhysicalDevice, device, allocationCallbacks, shaderLibrary,
+                              pipelineCache, descriptorLayoutCache, surfaceFormat.format, renderPass,
+                              queueFamilyIndices, particleConfig);
+}
+
+bool Vulkan::isParticleComputeAsync() const {
+    return particleSystem.isActive() && asyncCompute.isEnabled();
+}
+
+ParticleSystem &Vulkan::getParticleSystem() {
+    return particleSystem;
+}
 
-    throw std::runtime_error("Failed to find suitable memory type!");
+const DynamicResolution &Vulkan::getDynamicResolution() const {
+    return dynamicResolution;
+}
+
+FrameCapture &Vulkan::getFrameCapture() {
+    return frameCapture;
+}
+
+void Vulkan::createAsyncCompute() {
+    if (!isAsyncComputeRequested()) {
+        std::cout << "Async compute: disabled" << std::endl;
+        return;
+    }
+    if (!timelineSemaphoreEnabled) {
+        std::cout << "Async compute: unavailable, timeline semaphores are unsupported" << std::endl;
+        return;
+    }
+
+    const auto &computeQueue = findQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (computeQueue.properties.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        std::cout << "Async compute: unavailable, no compute queue family without graphics" << std::endl;
+        return;
+    }
+
+    asyncCompute.initialize(device, allocationCallbacks, computeQueue.index, computeQueue.queue,
+                            physicalDevice.properties.limits.timestampPeriod,
+                            computeQueue.properties.timestampValidBits, GPU_PROFILER_MAX_SCOPES);
+    std::cout << std::format("Async compute: queue family {}", computeQueue.index) << std::endl;
 }
 
 void Vulkan::createCommandPool() {
@@ -616,13 +1508,19 @@ void Vulkan::createCommandPool() {
     VK_CHECK(vkCreateCommandPool(device, &createInfo, allocationCallbacks, &commandPool));
 }
 
-void Vulkan::createCommandBuffer() {
+void Vulkan::createCommandBuffers() {
+    std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT * 2> commandBuffers{};
     VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
     allocateInfo.commandPool = commandPool;
-    allocateInfo.commandBufferCount = 1;
+    allocateInfo.commandBufferCount = commandBuffers.size();
     allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer))
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, commandBuffers.data()))
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        frames[i].commandBuffer = commandBuffers[i * 2];
+        frames[i].splitCommandBuffer = commandBuffers[i * 2 + 1];
+    }
 }
 
 void Vulkan::createSyncObjects() {
@@ -630,101 +1528,524 @@ void Vulkan::createSyncObjects() {
     VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &imageAvailableSemaphore))
-    VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &renderFinishedSemaphore))
-    VK_CHECK(vkCreateFence(device, &fenceCreateInfo, allocationCallbacks, &inFlightFence))
+    for (auto &frame: frames) {
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &frame.imageAvailableSemaphore))
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &frame.renderFinishedSemaphore))
+        VK_CHECK(vkCreateFence(device, &fenceCreateInfo, allocationCallbacks, &frame.inFlightFence))
+    }
+}
+
+// GPU time of the graphics work of the last measured frame. The second batch of a split frame only counts from the
+// end of the wait for the compute queue, neither that wait nor a gap between the batches is work.
+static GpuScopeStats getGraphicsFrameStats(const GpuScopeStats &frame, const GpuScopeStats *split) {
+    // A split sample older than the frame sample is left over from a frame that was submitted as one batch
+    if (split == nullptr || split->lastBeginMilliseconds < frame.lastBeginMilliseconds) {
+        return frame;
+    }
+
+    auto result = frame;
+    result.lastMilliseconds += std::max(0.0, split->lastEndMilliseconds -
+                                             std::max(split->lastBeginMilliseconds, frame.lastEndMilliseconds));
+    result.lastEndMilliseconds = split->lastEndMilliseconds;
+    return result;
 }
 
-void Vulkan::recordCommands(VkCommandBuffer &commandBuffer, uint32_t imageIndex) {
+void Vulkan::recordCommands(const FrameData &frame, uint32_t imageIndex) {
+    auto commandBuffer = frame.commandBuffer;
     VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo))
 
+    bool asyncParticles = isParticleComputeAsync();
+    if (asyncParticles) {
+        VK_CHECK(vkBeginCommandBuffer(frame.splitCommandBuffer, &commandBufferBeginInfo))
+    }
+
+    gpuProfiler.beginFrame(commandBuffer, currentFrame);
+    // The frame scope of a split frame only covers the first batch, which is what overlaps the compute work
+    auto frameStats = gpuProfiler.getScope(FRAME_SCOPE);
+    if (frameStats != nullptr) {
+        auto graphicsStats = getGraphicsFrameStats(*frameStats, gpuProfiler.getScope(FRAME_SPLIT_SCOPE));
+        dynamicResolution.update(&graphicsStats);
+    }
+    asyncCompute.updateOverlap(frameStats);
+    textureStreamer.recordCopies(commandBuffer);
+    renderGraph.reset();
+    auto backBuffer = renderGraph.importImage("swapchain", images[imageIndex], imageViews[imageIndex],
+                                              surfaceFormat.format, swapChainExtent, VK_IMAGE_LAYOUT_UNDEFINED,
+                                              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              config.headless ? RENDER_RESOURCE_USAGE_TRANSFER_SRC
+                                                              : RENDER_RESOURCE_USAGE_PRESENT);
+
+    // The graph only tracks images, the particle buffers are synchronized by the particle system itself. Declared
+    // first so that the compute work is recorded before the main pass draws its results.
+    if (particleSystem.isActive() && !asyncParticles) {
+        renderGraph.addPass("particles", [this](VkCommandBuffer commandBuffer, const RenderGraph &graph) {
+            recordParticleSimulation(commandBuffer, gpuProfiler);
+        }).sideEffects();
+    }
+
+    // The scene is drawn straight into the backbuffer, or into a target that keeps the output size so that scale
+    // changes do not reallocate it and only covers its top left renderExtent. At full scale the target and the blit
+    // are skipped, only dropping below and returning to full scale changes the graph's shape.
+    auto renderExtent = dynamicResolution.getRenderExtent(swapChainExtent);
+    bool scaled = renderExtent.width != swapChainExtent.width || renderExtent.height != swapChainExtent.height;
+    auto sceneColor = backBuffer;
+    if (scaled) {
+        sceneColor = renderGraph.createImage("scene color", {
+                .format = surfaceFormat.format,
+                .extent = swapChainExtent,
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+        });
+    }
+
+    VkFramebuffer backBufferFrameBuffer = dynamicRenderingEnabled ? VK_NULL_HANDLE : frameBuffers[imageIndex];
+    auto beginScene = [this, scaled, sceneColor, renderExtent, imageIndex, backBufferFrameBuffer](
+            VkCommandBuffer commandBuffer, const RenderGraph &graph, VkRenderPass pass, bool clear) {
+        if (scaled) {
+            auto target = graph.getImageView(sceneColor);
+            beginRendering(commandBuffer, target, getSceneFrameBuffer(target), pass, renderExtent, clear);
+        } else {
+            beginRendering(commandBuffer, imageViews[imageIndex], backBufferFrameBuffer, pass, renderExtent, clear);
+        }
+    };
+
+    // Debug geometry and text go on top of the last pass drawing into the backbuffer at the output resolution
+    bool drawImmediateInScene = !scaled;
+    renderGraph.addPass("main", [this, beginScene, asyncParticles, drawImmediateInScene](
+            VkCommandBuffer commandBuffer, const RenderGraph &graph) {
+        bool uber = isUberShaderFrame();
+        auto scope = gpuProfiler.beginScope(commandBuffer, uber ? MAIN_PASS_SCOPE_UBER : MAIN_PASS_SCOPE_SPECIALIZED);
+        beginScene(commandBuffer, graph, renderPass, true);
+        recordMainPass(commandBuffer, uber, !asyncParticles);
+        if (drawImmediateInScene && !asyncParticles) {
+            immediateRenderer.record(commandBuffer, currentFrame, cameraData.viewProjection, swapChainExtent);
+        }
+        endRendering(commandBuffer);
+        gpuProfiler.endScope(commandBuffer, scope);
+    }).write(sceneColor, RENDER_RESOURCE_USAGE_COLOR_ATTACHMENT);
+
+    // Everything before this pass overlaps with the particle simulation on the compute queue
+    if (asyncParticles) {
+        renderGraph.addPass("particles draw", [this, beginScene, drawImmediateInScene](VkCommandBuffer commandBuffer,
+                                                                                        const RenderGraph &graph) {
+            beginScene(commandBuffer, graph, overlayRenderPass, false);
+            auto scope = gpuProfiler.beginScope(commandBuffer, PARTICLE_SCOPE_DRAW);
+            particleSystem.recordDraw(commandBuffer);
+            gpuProfiler.endScope(commandBuffer, scope);
+            if (drawImmediateInScene) {
+                immediateRenderer.record(commandBuffer, currentFrame, cameraData.viewProjection, swapChainExtent);
+            }
+            endRendering(commandBuffer);
+        }).write(sceneColor, RENDER_RESOURCE_USAGE_COLOR_ATTACHMENT).splitSubmission();
+    }
+
+    if (scaled) {
+        renderGraph.addPass("upscale", [this, sceneColor, renderExtent, imageIndex](VkCommandBuffer commandBuffer,
+                                                                                    const RenderGraph &graph) {
+            auto scope = gpuProfiler.beginScope(commandBuffer, UPSCALE_SCOPE);
+            recordUpscale(commandBuffer, graph.getImage(sceneColor), renderExtent, images[imageIndex]);
+            gpuProfiler.endScope(commandBuffer, scope);
+        }).read(sceneColor, RENDER_RESOURCE_USAGE_TRANSFER_SRC).write(backBuffer, RENDER_RESOURCE_USAGE_TRANSFER_DST);
+
+        renderGraph.addPass("overlay", [this, imageIndex, backBufferFrameBuffer](VkCommandBuffer commandBuffer,
+                                                                                 const RenderGraph &graph) {
+            beginRendering(commandBuffer, imageViews[imageIndex], backBufferFrameBuffer, overlayRenderPass,
+                           swapChainExtent, false);
+            immediateRenderer.record(commandBuffer, currentFrame, cameraData.viewProjection, swapChainExtent);
+            endRendering(commandBuffer);
+        }).write(backBuffer, RENDER_RESOURCE_USAGE_COLOR_ATTACHMENT);
+    }
+
+    // Copied after everything else drew into the backbuffer, before it is presented
+    if (frameCaptureSupported && frameCapture.isRequested()) {
+        auto fence = frame.inFlightFence;
+        renderGraph.addPass("capture", [this, backBuffer, fence](VkCommandBuffer commandBuffer,
+                                                                 const RenderGraph &graph) {
+            frameCapture.recordCopy(commandBuffer, graph.getImage(backBuffer), surfaceFormat.format,
+                                    swapChainExtent, fence, frameNumber);
+        }).read(backBuffer, RENDER_RESOURCE_USAGE_TRANSFER_SRC).sideEffects();
+    }
+
+    renderGraph.compile(frameNumber);
+    if (dumpRenderGraph && renderGraph.hasShapeChanged()) {
+        std::cout << renderGraph.dump();
+    }
+
+    auto lastCommandBuffer = asyncParticles ? frame.splitCommandBuffer : commandBuffer;
+    // Each batch of a split frame has its own scope. The second one starts at the stage the compute wait of
+    // submitCommands() blocks, so that the time spent waiting for the compute queue is not measured as frame time.
+    auto frameScope = gpuProfiler.beginScope(commandBuffer, FRAME_SCOPE);
+    auto splitScope = INVALID_GPU_SCOPE;
+    if (asyncParticles) {
+        splitScope = gpuProfiler.beginScope(frame.splitCommandBuffer, FRAME_SPLIT_SCOPE,
+                                            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    }
+    renderGraph.execute(commandBuffer, lastCommandBuffer);
+    gpuProfiler.endScope(commandBuffer, frameScope);
+    gpuProfiler.endScope(frame.splitCommandBuffer, splitScope);
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer))
+    if (asyncParticles) {
+        VK_CHECK(vkEndCommandBuffer(frame.splitCommandBuffer))
+    }
+}
+
+void Vulkan::recordParticleSimulation(VkCommandBuffer commandBuffer, GpuProfiler &profiler) {
+    auto simulate = profiler.beginScope(commandBuffer, PARTICLE_SCOPE_SIMULATE);
+    particleSystem.recordSimulation(commandBuffer, currentFrame, cameraData.viewProjection);
+    profiler.endScope(commandBuffer, simulate);
+
+    if (particleSystem.isSortEnabled()) {
+        auto sort = profiler.beginScope(commandBuffer, PARTICLE_SCOPE_SORT);
+        particleSystem.recordSort(commandBuffer);
+        profiler.endScope(commandBuffer, sort);
+    }
+}
+
+VkFramebuffer Vulkan::getSceneFrameBuffer(VkImageView imageView) {
+    if (dynamicRenderingEnabled) {
+        return VK_NULL_HANDLE;
+    }
+
+    if (imageView == sceneFrameBufferView) {
+        return sceneFrameBuffer;
+    }
+
+    // Frames in flight may still use the framebuffer of the previous scene target
+    if (sceneFrameBuffer != VK_NULL_HANDLE) {
+        retiredFrameBuffers.push_back({sceneFrameBuffer, frameNumber});
+    }
+
+    VkFramebufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    createInfo.renderPass = renderPass;
+    createInfo.pAttachments = &imageView;
+    createInfo.attachmentCount = 1;
+    createInfo.width = swapChainExtent.width;
+    createInfo.height = swapChainExtent.height;
+    createInfo.layers = 1;
+    VK_CHECK(vkCreateFramebuffer(device, &createInfo, allocationCallbacks, &sceneFrameBuffer))
+
+    sceneFrameBufferView = imageView;
+    return sceneFrameBuffer;
+}
+
+void Vulkan::destroyRetiredFrameBuffers() {
+    std::erase_if(retiredFrameBuffers, [this](const RetiredFrameBuffer &retired) {
+        if (retired.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+            return false;
+        }
+
+        vkDestroyFramebuffer(device, retired.frameBuffer, allocationCallbacks);
+        return true;
+    });
+}
+
+void Vulkan::beginRendering(VkCommandBuffer commandBuffer, VkImageView target, VkFramebuffer frameBuffer,
+                            VkRenderPass pass, VkExtent2D extent, bool clear) {
     VkClearValue clearValue = {
             .color = {{0.01f, 0.01f, 0.01f, 1.0f}},
     };
 
-    VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-    renderPassBeginInfo.renderPass = renderPass;
-    renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = &clearValue;
-    renderPassBeginInfo.renderArea.offset = {0, 0};
-    renderPassBeginInfo.renderArea.extent = swapChainExtent;
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    if (dynamicRenderingEnabled) {
+        VkRenderingAttachmentInfo colorAttachment{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+        colorAttachment.imageView = target;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearValue;
+
+        VkRenderingInfo renderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO};
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+
+        cmdBeginRendering(commandBuffer, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        renderPassBeginInfo.renderPass = pass;
+        renderPassBeginInfo.framebuffer = frameBuffer;
+        renderPassBeginInfo.clearValueCount = clear ? 1 : 0;
+        renderPassBeginInfo.pClearValues = &clearValue;
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = extent;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
 
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapChainExtent.width);
-    viewport.height = static_cast<float>(swapChainExtent.height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent;
+    scissor.extent = extent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void Vulkan::endRendering(VkCommandBuffer commandBuffer) {
+    if (dynamicRenderingEnabled) {
+        cmdEndRendering(commandBuffer);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void Vulkan::recordMainPass(VkCommandBuffer commandBuffer, bool uberShader, bool drawParticles) {
+    auto pipeline = uberShader ? pipelineVariants.getUber() : pipelineVariants.get(MAIN_PASS_FEATURES);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    auto camera = uniformRing.push(cameraData);
+    auto objects = storageRing.allocate(sizeof(ObjectData));
+    static_cast<ObjectData *>(objects.data)->model = glm::mat4(1.0f);
+
+    uint32_t dynamicOffsets[] = {camera.offset, objects.offset};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                            &globalDescriptorSet, 2, dynamicOffsets);
+    bindless.bindSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
 
-    VkBuffer vertexBuffers[] = {vertexBuffer};
+    PushConstants pushConstants = {.objectIndex = 0, .features = MAIN_PASS_FEATURES};
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                       sizeof(PushConstants), &pushConstants);
+
+    VkBuffer vertexBuffers[] = {vertexBuffer.buffer};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
     vkCmdDraw(commandBuffer, vertices.size(), 1, 0, 0);
 
-    vkCmdEndRenderPass(commandBuffer);
+    // Every mesh of the scene uses the built-in vertex buffer until meshes can be loaded, the pushed object index
+    // of 0 stays valid for the scene's instances
+    sceneInstances.recordDraw(commandBuffer, pipelineLayout, camera.offset, vertices.size());
 
-    VK_CHECK(vkEndCommandBuffer(commandBuffer))
+    if (drawParticles && particleSystem.isActive()) {
+        auto scope = gpuProfiler.beginScope(commandBuffer, PARTICLE_SCOPE_DRAW);
+        particleSystem.recordDraw(commandBuffer);
+        gpuProfiler.endScope(commandBuffer, scope);
+    }
 }
 
-void Vulkan::update() {
-    void *data = nullptr;
-    VK_CHECK(vkMapMemory(device, vertexBufferMemory, 0, sizeof(Vertex) * vertices.size(), 0, &data))
-    memcpy(data, vertices.data(), sizeof(Vertex) * vertices.size());
-    vkUnmapMemory(device, vertexBufferMemory);
+void Vulkan::recordUpscale(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage target) {
+    VkImageBlit region{};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffsets[1] = {static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffsets[1] = {static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height),
+                            1};
+
+    vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, upscaleFilter);
 }
 
-void Vulkan::renderFrame() {
-    VK_CHECK(vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX))
+void Vulkan::submitCommands(const FrameData &frame, VkQueue queue, bool split) {
+    // Headless frames neither wait for an acquired image nor signal a present
+    uint32_t semaphoreCount = config.headless ? 0 : 1;
+    // A split frame is submitted as two batches, the second one waits for the frame's compute work. The graphics
+    // timeline tells the compute queue when the frame stopped reading the previous results.
+    uint64_t frameValue = frameNumber + 1;
+    bool signalTimeline = asyncCompute.isEnabled();
+    auto computeTimeline = asyncCompute.getComputeTimeline();
+    auto graphicsTimeline = asyncCompute.getGraphicsTimeline();
+    uint32_t batchCount = split ? 2 : 1;
+
+    if (dynamicRenderingEnabled) {
+        VkSemaphoreSubmitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+        waitInfo.semaphore = frame.imageAvailableSemaphore;
+        waitInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        VkSemaphoreSubmitInfo computeWaitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+        computeWaitInfo.semaphore = computeTimeline;
+        computeWaitInfo.value = frameValue;
+        computeWaitInfo.stageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+
+        std::array<VkSemaphoreSubmitInfo, 2> signalInfos{};
+        uint32_t signalCount = 0;
+        if (semaphoreCount > 0) {
+            signalInfos[signalCount] = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+            signalInfos[signalCount].semaphore = frame.renderFinishedSemaphore;
+            signalInfos[signalCount++].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        }
+        if (signalTimeline) {
+            signalInfos[signalCount] = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+            signalInfos[signalCount].semaphore = graphicsTimeline;
+            signalInfos[signalCount].value = frameValue;
+            signalInfos[signalCount++].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        }
 
-    uint32_t imageIndex = 0;
-    auto result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE,
-                                        &imageIndex);
+        std::array<VkCommandBufferSubmitInfo, 2> commandBufferInfos{};
+        commandBufferInfos[0] = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+        commandBufferInfos[0].commandBuffer = frame.commandBuffer;
+        commandBufferInfos[1] = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+        commandBufferInfos[1].commandBuffer = frame.splitCommandBuffer;
+
+        std::array<VkSubmitInfo2, 2> submitInfos{};
+        submitInfos[0] = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+        submitInfos[0].waitSemaphoreInfoCount = semaphoreCount;
+        submitInfos[0].pWaitSemaphoreInfos = &waitInfo;
+        submitInfos[0].commandBufferInfoCount = 1;
+        submitInfos[0].pCommandBufferInfos = &commandBufferInfos[0];
+        submitInfos[1] = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+        submitInfos[1].waitSemaphoreInfoCount = 1;
+        submitInfos[1].pWaitSemaphoreInfos = &computeWaitInfo;
+        submitInfos[1].commandBufferInfoCount = 1;
+        submitInfos[1].pCommandBufferInfos = &commandBufferInfos[1];
+
+        auto &last = submitInfos[batchCount - 1];
+        last.signalSemaphoreInfoCount = signalCount;
+        last.pSignalSemaphoreInfos = signalInfos.data();
+
+        VK_CHECK(queueSubmit2(queue, batchCount, submitInfos.data(), frame.inFlightFence))
+        return;
+    }
+
+    std::array<VkSemaphore, 2> signalSemaphores{};
+    // Values of binary semaphores are ignored
+    std::array<uint64_t, 2> signalValues{};
+    uint32_t signalCount = 0;
+    if (semaphoreCount > 0) {
+        signalSemaphores[signalCount++] = frame.renderFinishedSemaphore;
+    }
+    if (signalTimeline) {
+        signalValues[signalCount] = frameValue;
+        signalSemaphores[signalCount++] = graphicsTimeline;
+    }
+
+    VkTimelineSemaphoreSubmitInfo computeWaitValues{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    computeWaitValues.waitSemaphoreValueCount = 1;
+    computeWaitValues.pWaitSemaphoreValues = &frameValue;
+
+    VkTimelineSemaphoreSubmitInfo signalTimelineValues{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    signalTimelineValues.signalSemaphoreValueCount = signalCount;
+    signalTimelineValues.pSignalSemaphoreValues = signalValues.data();
+
+    std::array<VkSubmitInfo, 2> submitInfos{};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    submitInfos[0] = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfos[0].commandBufferCount = 1;
+    submitInfos[0].pCommandBuffers = &frame.commandBuffer;
+    submitInfos[0].pWaitSemaphores = &frame.imageAvailableSemaphore;
+    submitInfos[0].waitSemaphoreCount = semaphoreCount;
+    submitInfos[0].pWaitDstStageMask = waitStages;
+
+    VkPipelineStageFlags computeWaitStages[] = {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT};
+    submitInfos[1] = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfos[1].pNext = &computeWaitValues;
+    submitInfos[1].commandBufferCount = 1;
+    submitInfos[1].pCommandBuffers = &frame.splitCommandBuffer;
+    submitInfos[1].pWaitSemaphores = &computeTimeline;
+    submitInfos[1].waitSemaphoreCount = 1;
+    submitInfos[1].pWaitDstStageMask = computeWaitStages;
+
+    auto &last = submitInfos[batchCount - 1];
+    last.signalSemaphoreCount = signalCount;
+    last.pSignalSemaphores = signalSemaphores.data();
+    if (signalTimeline) {
+        // Both chains are only read by the driver during the submit
+        if (split) {
+            computeWaitValues.signalSemaphoreValueCount = signalCount;
+            computeWaitValues.pSignalSemaphoreValues = signalValues.data();
+        } else {
+            last.pNext = &signalTimelineValues;
+        }
+    }
+
+    VK_CHECK(vkQueueSubmit(queue, batchCount, submitInfos.data(), frame.inFlightFence))
+}
+
+void Vulkan::update(float deltaSeconds) {
+    memcpy(vertexBuffer.mapped, vertices.data(), sizeof(Vertex) * vertices.size());
+    particleSystem.update(deltaSeconds);
+}
+
+void Vulkan::renderFrame() {
+    auto &frame = frames[currentFrame];
+    VK_CHECK(vkWaitForFences(device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX))
+    // Before the fence is reset, copies of the other frames in flight may have finished as well
+    frameCapture.poll();
+
+    // Offscreen images are used round robin, a frame reuses an image only after its fence was waited on
+    uint32_t imageIndex = frameNumber % images.size();
+    auto result = VK_SUCCESS;
+    if (!config.headless) {
+        result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame.imageAvailableSemaphore,
+                                       VK_NULL_HANDLE, &imageIndex);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreateSwapChain();
+        // The primitives were meant for the skipped frame
+        immediateRenderer.getBatch().clear();
         return;
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error(string_VkResult(result));
     }
 
-    vkResetFences(device, 1, &inFlightFence);
-    vkResetCommandBuffer(commandBuffer, 0);
-    recordCommands(commandBuffer, imageIndex);
+    vkResetFences(device, 1, &frame.inFlightFence);
+
+    pipelineVariants.beginFrame(frameNumber);
+
+    uniformRing.beginFrame(currentFrame);
+    storageRing.beginFrame(currentFrame);
+    descriptorAllocator.resetFrame(currentFrame);
+    bindless.beginFrame(frameNumber);
+    immediateRenderer.beginFrame(currentFrame, frameNumber);
+    particleSystem.beginFrame(frameNumber);
+    destroyRetiredFrameBuffers();
+
+    uploadQueue.poll();
+    textureStreamer.update(frameNumber);
+    sceneInstances.update();
+    uploadQueue.flush();
+
+    const auto &streamingStats = textureStreamer.getStats();
+    if (streamingStats.textureCount > 0 && frameNumber % STREAMING_REPORT_INTERVAL == 0) {
+        logInfo("streaming", "Texture streaming: {} textures, {:.1f}/{:.1f} MiB resident, {} pending, {} promotions, "
+                "{} evictions", streamingStats.textureCount, streamingStats.residentBytes / (1024.0 * 1024.0),
+                streamingStats.budgetBytes / (1024.0 * 1024.0), streamingStats.pendingRequests,
+                streamingStats.promotions, streamingStats.evictions);
+    }
 
-    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+    vkResetCommandBuffer(frame.commandBuffer, 0);
+    vkResetCommandBuffer(frame.splitCommandBuffer, 0);
+
+    // The simulation is submitted ahead of the graphics work so that the compute queue can start right away
+    bool asyncParticles = isParticleComputeAsync();
+    if (asyncParticles) {
+        auto computeCommandBuffer = asyncCompute.begin(currentFrame);
+        recordParticleSimulation(computeCommandBuffer, asyncCompute.getProfiler());
+        asyncCompute.submit(frameNumber + 1);
+    }
+
+    auto recordStart = std::chrono::steady_clock::now();
+    recordCommands(frame, imageIndex);
+    std::chrono::duration<double, std::micro> recordTime = std::chrono::steady_clock::now() - recordStart;
+    renderPathStats.recordMicroseconds += recordTime.count();
+    renderPathStats.recordCount++;
 
     auto &presentQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_PRESENT)->second;
     auto &graphicsQueue = queueFamilyMap.find(QueueFeature::QUEUE_FEATURE_GRAPHICS)->second;
 
-    VK_CHECK(vkQueueSubmit(graphicsQueue.queue, 1, &submitInfo, inFlightFence))
+    submitCommands(frame, graphicsQueue.queue, asyncParticles);
 
-    VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = &swapChain;
-    presentInfo.pImageIndices = &imageIndex;
+    if (!config.headless) {
+        VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &frame.renderFinishedSemaphore;
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &swapChain;
+        presentInfo.pImageIndices = &imageIndex;
+
+        VK_CHECK(vkQueuePresentKHR(presentQueue.queue, &presentInfo));
+    }
 
-    VK_CHECK(vkQueuePresentKHR(presentQueue.queue, &presentInfo));
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
 }
\ No newline at end of file
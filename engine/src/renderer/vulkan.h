@@ -3,6 +3,7 @@
 #include <SDL.h>
 #include <iostream>
 #include <string>
+#include <array>
 #include <sstream>
 #include <vector>
 #include <map>
@@ -10,24 +11,38 @@
 #include <vulkan/vk_enum_string_helper.h>
 
 #include "vulkan_types.h"
-
-#define VK_CHECK(expr) {                            \
-    VkResult _result = expr;                         \
-    if (_result != VK_SUCCESS) {                     \
-        std::stringstream message;                  \
-        message << "Vulkan error: ";                \
-        message << string_VkResult(_result);         \
-        std::cerr << message.str() << std::endl;    \
-        throw std::runtime_error(message.str());    \
-    }\
+#include "vulkan_buffer.h"
+#include "vulkan_ring_buffer.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_bindless.h"
+#include "vulkan_upload.h"
+#include "texture_streamer.h"
+#include "render_graph.h"
+#include "shader_library.h"
+#include "vulkan_pipeline_cache.h"
+#include "pipeline_variants.h"
+#include "gpu_profiler.h"
+#include "immediate_renderer.h"
+#include "particle_system.h"
+#include "dynamic_resolution.h"
+#include "physical_device_selector.h"
+#include "async_compute.h"
+#include "frame_capture.h"
+#include "scene_instances.h"
+#include "core/startup_timer.h"
+#include "core/log.h"
+
+// Errors are flushed from the log queue before the exception may terminate the process
+#define VK_CHECK(expr) {                                                              \
+    VkResult _result = expr;                                                          \
+    if (_result != VK_SUCCESS) {                                                      \
+        auto _message = std::format("Vulkan error: {}", string_VkResult(_result));    \
+        Logger::get().write(LOG_LEVEL_ERROR, "vulkan", _message);                     \
+        Logger::get().flush();                                                        \
+        throw std::runtime_error(_message);                                           \
+    }                                                                                 \
 }\
 
-typedef struct PhysicalDevice {
-    VkPhysicalDevice vkPhysicalDevice;
-    VkPhysicalDeviceProperties properties;
-    uint32_t priority;
-} PhysicalDevice;
-
 enum QueueFeature {
     QUEUE_FEATURE_GRAPHICS,
     QUEUE_FEATURE_PRESENT,
@@ -42,28 +57,117 @@ typedef struct QueueFamily {
     VkQueue queue;
 } QueueFamily;
 
+typedef struct FrameData {
+    VkCommandBuffer commandBuffer;
+    // Passes behind the wait for the frame's async compute work
+    VkCommandBuffer splitCommandBuffer;
+    VkSemaphore imageAvailableSemaphore;
+    VkSemaphore renderFinishedSemaphore;
+    VkFence inFlightFence;
+} FrameData;
+
+enum ShaderVariantMode {
+    SHADER_VARIANT_MODE_SPECIALIZED,
+    SHADER_VARIANT_MODE_UBER,
+    // Alternates between both paths to measure the GPU time difference
+    SHADER_VARIANT_MODE_COMPARE
+};
+
+// CPU cost of the active render path, used to compare dynamic rendering against render pass objects
+typedef struct RenderPathStats {
+    uint64_t recordCount;
+    double recordMicroseconds;
+    uint64_t recreateCount;
+    double recreateMicroseconds;
+} RenderPathStats;
+
+typedef struct RendererConfig {
+    // Renders into offscreen images instead of a window's swapchain, nothing is presented
+    bool headless = false;
+    VkExtent2D headlessExtent = {1280, 720};
+    ParticleSystemConfig particles;
+    DynamicResolutionConfig dynamicResolution;
+    PhysicalDeviceSelectorConfig physicalDevice;
+    // Runs the particle simulation on a compute queue family without graphics support, if the device has one
+    bool asyncCompute = true;
+    FrameCaptureConfig capture;
+} RendererConfig;
+
 class Vulkan {
 public:
     Vulkan() = default;
 
-    void initialize(const char *applicationName, SDL_Window *window);
+    explicit Vulkan(const RendererConfig &config) : config(config) {}
+
+    // Instance extensions SDL needs for window surfaces, which does not depend on a window. Like all SDL video calls
+    // it belongs on the main thread, after SDL_Vulkan_LoadLibrary().
+    static std::vector<const char *> getWindowInstanceExtensions();
+
+    // Creates the instance and selects the physical device. No window is needed yet and SDL is not called, so this
+    // can run on a worker thread while the window is being created on the main thread. windowExtensions is empty in
+    // headless mode.
+    void initializeInstance(const char *applicationName, const std::vector<const char *> &windowExtensions,
+                            StartupTimer &startupTimer);
+
+    // window is nullptr in headless mode
+    void initialize(SDL_Window *window, StartupTimer &startupTimer);
 
     ~Vulkan();
 
-    void update();
+    void update(float deltaSeconds);
 
     void renderFrame();
 
+    TextureHandle loadTexture(const std::string &fileName);
+
+    void requestTextureResolution(TextureHandle texture, float screenPixels);
+
+    const TextureStreamerStats &getTextureStreamingStats() const;
+
+    BindlessHandle getTextureImageHandle(TextureHandle texture) const;
+
+    // Debug lines, sprites and text for the next rendered frame
+    ImmediateBatch &getImmediateBatch();
+
+    void setImmediateFont(const GlyphAtlas &atlas);
+
+    ParticleSystem &getParticleSystem();
+
+    // Scale of the scene resolution and how well the GPU frame time kept to its budget
+    const DynamicResolution &getDynamicResolution() const;
+
+    // Screenshots and continuous capture of the presented or offscreen images
+    FrameCapture &getFrameCapture();
+
+    // Draws the instances of a mapped snapshot in the main pass, nullptr removes the scene. The snapshot must stay
+    // open until it is replaced. Waits for the device to be idle.
+    void setScene(const SceneSnapshot *snapshot);
+
+    const SceneInstancesStats &getSceneStats() const;
+
 private:
+    typedef struct RetiredFrameBuffer {
+        VkFramebuffer frameBuffer;
+        uint64_t frameNumber;
+    } RetiredFrameBuffer;
+
+    RendererConfig config;
     VkAllocationCallbacks *allocationCallbacks = nullptr;
-    VkDebugUtilsMessengerEXT debugUtilsMessenger;
+    VkDebugUtilsMessengerEXT debugUtilsMessenger = VK_NULL_HANDLE;
     VkInstance instance;
+    uint32_t apiVersion;
+    bool validationEnabled = false;
+    std::vector<VkLayerProperties> availableLayers;
+    std::vector<VkExtensionProperties> availableDeviceExtensions;
+    std::vector<VkSurfaceFormatKHR> surfaceFormats;
+    std::vector<VkPresentModeKHR> presentModes;
+    PhysicalDeviceSelector physicalDeviceSelector;
     PhysicalDevice physicalDevice;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkDevice device;
 
     VkSurfaceFormatKHR surfaceFormat;
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     VkExtent2D swapChainExtent;
 
     std::vector<QueueFamily> queueFamilies;
@@ -71,21 +175,67 @@ private:
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
     std::vector<VkFramebuffer> frameBuffers;
+    // Backing memory of the offscreen images that replace the swapchain in headless mode
+    std::vector<VkDeviceMemory> headlessImageMemory;
 
-    std::vector<VkShaderModule> shaderModules;
-    VkRenderPass renderPass;
-    VkPipeline pipeline;
+    ShaderLibrary shaderLibrary;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // Same attachment as renderPass but loads it, for drawing over the upscaled scene
+    VkRenderPass overlayRenderPass = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout;
+    PipelineCache pipelineCache;
+    PipelineVariants pipelineVariants;
+    ShaderVariantMode shaderVariantMode = SHADER_VARIANT_MODE_SPECIALIZED;
+    GpuProfiler gpuProfiler;
+    ImmediateRenderer immediateRenderer;
+    ParticleSystem particleSystem;
+
+    bool timelineSemaphoreEnabled = false;
+    AsyncCompute asyncCompute;
+
+    FrameCapture frameCapture;
+    // The images can be copied from and have a format the capture can convert
+    bool frameCaptureSupported = false;
+
+    DynamicResolution dynamicResolution;
+    VkFilter upscaleFilter = VK_FILTER_LINEAR;
+    // Render pass objects need a framebuffer for the scene target, which changes whenever the graph recreates it
+    VkImageView sceneFrameBufferView = VK_NULL_HANDLE;
+    VkFramebuffer sceneFrameBuffer = VK_NULL_HANDLE;
+    std::vector<RetiredFrameBuffer> retiredFrameBuffers;
 
     VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
-
-    VkBuffer vertexBuffer;
-    VkMemoryRequirements vertexBufferMemoryRequirements;
-    VkDeviceMemory vertexBufferMemory;
+    std::array<FrameData, MAX_FRAMES_IN_FLIGHT> frames;
+    uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+
+    Buffer vertexBuffer;
+
+    RingBuffer uniformRing;
+    RingBuffer storageRing;
+    DescriptorLayoutCache descriptorLayoutCache;
+    DescriptorAllocator descriptorAllocator;
+    VkDescriptorPool globalDescriptorPool;
+    VkDescriptorSetLayout globalSetLayout;
+    VkDescriptorSet globalDescriptorSet;
+    bool descriptorIndexingSupported = false;
+    BindlessDescriptors bindless;
+
+    bool memoryBudgetSupported = false;
+    UploadQueue uploadQueue;
+    TextureStreamer textureStreamer;
+    SceneInstances sceneInstances;
+
+    RenderGraph renderGraph;
+    bool dumpRenderGraph = false;
+
+    bool dynamicRenderingEnabled = false;
+    PFN_vkCmdBeginRendering cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRendering cmdEndRendering = nullptr;
+    PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2 = nullptr;
+    PFN_vkQueueSubmit2 queueSubmit2 = nullptr;
+    RenderPathStats renderPathStats{};
+    CameraData cameraData;
 
     static VkBool32 debugLog(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
                              VkDebugUtilsMessageTypeFlagsEXT messageTypes,
@@ -98,45 +248,128 @@ private:
 
     uint32_t getApiVersion() const;
 
-    void createInstance(const char *applicationName, SDL_Window *window);
+    static bool isValidationRequested();
+
+    void createInstance(const char *applicationName, const std::vector<const char *> &windowExtensions);
 
     void createDebugUtilsMessenger();
 
+    PhysicalDeviceSelectorConfig getPhysicalDeviceSelectorConfig() const;
+
     void selectBestPhysicalDevice();
 
+    // The window surface does not exist yet during selectBestPhysicalDevice()
+    void ensurePresentSupport();
+
+    void setPhysicalDevice(const PhysicalDevice &selected);
+
     void createSurface(SDL_Window *window);
 
     std::vector<QueueFamily> fetchAvailableQueueFamilies();
 
+    bool isDescriptorIndexingSupported() const;
+
+    bool isDynamicRenderingSupported() const;
+
+    bool isAsyncComputeRequested() const;
+
+    bool isTimelineSemaphoreSupported() const;
+
+    void loadDynamicRenderingFunctions();
+
     void createDevice();
 
+    const QueueFamily &findQueueFamily(VkQueueFlags required, VkQueueFlags avoided) const;
+
     VkSurfaceFormatKHR selectSurfaceFormat();
 
     VkPresentModeKHR selectPresentMode();
 
     void createSwapChain();
 
+    VkImageUsageFlags getUpscaleImageUsage(VkImageUsageFlags supportedUsage);
+
+    VkImageUsageFlags getCaptureImageUsage(VkImageUsageFlags supportedUsage);
+
+    void createHeadlessImages();
+
     void cleanupSwapChain();
 
     void recreateSwapChain();
 
-    VkShaderModule createShaderModule(const std::string &shaderFilePath);
+    void createShaderLibrary();
+
+    VkShaderModule createShaderModule(const std::string &shaderName);
+
+    void createDynamicResolution();
+
+    void createFrameCapture();
 
     void createRenderPass();
 
+    VkRenderPass createColorRenderPass(VkAttachmentLoadOp loadOp);
+
     void createPipeline();
 
+    VkPipeline buildPipeline(const VkSpecializationInfo &specialization);
+
+    void onShaderReloaded(const std::string &shaderName);
+
+    bool isUberShaderFrame() const;
+
+    void printShaderVariantReport() const;
+
+    void printParticleReport() const;
+
+    void printDynamicResolutionReport() const;
+
+    void printAsyncComputeReport() const;
+
+    void printFrameCaptureReport() const;
+
     void createFrameBuffers();
 
     void createVertexBuffer(const std::vector<Vertex> &vertices);
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    void createFrameResources();
+
+    void createDescriptors();
+
+    void createStreaming();
+
+    void createSceneInstances();
+
+    void createImmediateRenderer();
+
+    void createAsyncCompute();
+
+    void createParticleSystem();
+
+    bool isParticleComputeAsync() const;
 
     void createCommandPool();
 
-    void createCommandBuffer();
+    void createCommandBuffers();
 
     void createSyncObjects();
 
-    void recordCommands(VkCommandBuffer &commandBuffer, uint32_t imageIndex);
+    void recordCommands(const FrameData &frame, uint32_t imageIndex);
+
+    void recordParticleSimulation(VkCommandBuffer commandBuffer, GpuProfiler &profiler);
+
+    VkFramebuffer getSceneFrameBuffer(VkImageView imageView);
+
+    void destroyRetiredFrameBuffers();
+
+    void beginRendering(VkCommandBuffer commandBuffer, VkImageView target, VkFramebuffer frameBuffer,
+                        VkRenderPass pass, VkExtent2D extent, bool clear);
+
+    void endRendering(VkCommandBuffer commandBuffer);
+
+    void recordMainPass(VkCommandBuffer commandBuffer, bool uberShader, bool drawParticles);
+
+    void recordUpscale(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage target);
+
+    // With split the second command buffer waits for the frame's async compute work
+    void submitCommands(const FrameData &frame, VkQueue queue, bool split);
 };
\ No newline at end of file
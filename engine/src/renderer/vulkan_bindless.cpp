@@ -0,0 +1,289 @@
+#include "vulkan_bindless.h"
+#include <algorithm>
+#include <format>
+#include "vulkan.h"
+
+static constexpr uint32_t MAX_BINDLESS_SAMPLED_IMAGES = 16384;
+static constexpr uint32_t MAX_BINDLESS_STORAGE_BUFFERS = 4096;
+static constexpr uint32_t MAX_BINDLESS_SAMPLERS = 256;
+// Per stage resources left to the other sets of the pipeline layouts and to the color attachments
+static constexpr uint32_t RESERVED_STAGE_RESOURCES = 64;
+
+static const VkDescriptorType descriptorTypes[BINDLESS_RESOURCE_TYPE_COUNT] = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+void BindlessSlotAllocator::initialize(uint32_t capacity) {
+    this->capacity = capacity;
+    next = 0;
+    freeSlots.clear();
+    pendingSlots.clear();
+}
+
+BindlessHandle BindlessSlotAllocator::allocate() {
+    if (!freeSlots.empty()) {
+        auto handle = freeSlots.back();
+        freeSlots.pop_back();
+        return handle;
+    }
+
+    if (next >= capacity) {
+        throw std::runtime_error(std::format("Bindless slot allocator exhausted, capacity: {}", capacity));
+    }
+
+    return next++;
+}
+
+void BindlessSlotAllocator::release(BindlessHandle handle, uint64_t frameNumber) {
+    pendingSlots.push_back({.handle = handle, .releasedFrame = frameNumber});
+}
+
+void BindlessSlotAllocator::collect(uint64_t frameNumber) {
+    while (!pendingSlots.empty() && pendingSlots.front().releasedFrame + MAX_FRAMES_IN_FLIGHT <= frameNumber) {
+        freeSlots.push_back(pendingSlots.front().handle);
+        pendingSlots.pop_front();
+    }
+}
+
+void BindlessDescriptors::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                     const VkAllocationCallbacks *allocationCallbacks,
+                                     DescriptorLayoutCache &layoutCache, DescriptorAllocator &frameAllocator,
+                                     bool enabled) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->frameAllocator = &frameAllocator;
+    this->enabled = enabled;
+
+    std::array<uint32_t, BINDLESS_RESOURCE_TYPE_COUNT> capacities = {
+            MAX_BINDLESS_SAMPLED_IMAGES, MAX_BINDLESS_STORAGE_BUFFERS, MAX_BINDLESS_SAMPLERS
+    };
+
+    if (enabled) {
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+        VkPhysicalDeviceProperties2 properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        properties.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        // The bindings are visible to all stages, so the per stage limits apply next to the per set ones
+        capacities[BINDLESS_RESOURCE_SAMPLED_IMAGE] = std::min({
+                capacities[BINDLESS_RESOURCE_SAMPLED_IMAGE],
+                indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+        capacities[BINDLESS_RESOURCE_STORAGE_BUFFER] = std::min({
+                capacities[BINDLESS_RESOURCE_STORAGE_BUFFER],
+                indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+        capacities[BINDLESS_RESOURCE_SAMPLER] = std::min({
+                capacities[BINDLESS_RESOURCE_SAMPLER],
+                indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+        // All of them together also count against the stage's total, which is shared in proportion
+        auto stageResources = indexingProperties.maxPerStageUpdateAfterBindResources;
+        uint64_t available = stageResources > RESERVED_STAGE_RESOURCES + BINDLESS_RESOURCE_TYPE_COUNT
+                             ? stageResources - RESERVED_STAGE_RESOURCES : BINDLESS_RESOURCE_TYPE_COUNT;
+        uint64_t total = 0;
+        for (auto capacity: capacities) {
+            total += capacity;
+        }
+        if (total > available) {
+            for (auto &capacity: capacities) {
+                capacity = std::max<uint32_t>(1, capacity * available / total);
+            }
+        }
+    }
+
+    DescriptorLayoutInfo layoutInfo{};
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (uint32_t type = 0; type < BINDLESS_RESOURCE_TYPE_COUNT; ++type) {
+        slots[type].initialize(capacities[type]);
+
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = type;
+        binding.descriptorType = descriptorTypes[type];
+        binding.descriptorCount = enabled ? capacities[type] : 1;
+        binding.stageFlags = VK_SHADER_STAGE_ALL;
+        layoutInfo.bindings.push_back(binding);
+
+        if (enabled) {
+            layoutInfo.bindingFlags.push_back(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+            poolSizes.push_back({descriptorTypes[type], capacities[type]});
+        }
+    }
+
+    if (!enabled) {
+        layout = layoutCache.getLayout(layoutInfo);
+        return;
+    }
+
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout = layoutCache.getLayout(layoutInfo);
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = poolSizes.size();
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, allocationCallbacks, &pool))
+
+    VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = pool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &set))
+}
+
+void BindlessDescriptors::destroy() {
+    if (pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, pool, allocationCallbacks);
+        pool = VK_NULL_HANDLE;
+    }
+}
+
+BindlessHandle BindlessDescriptors::registerSampledImage(VkImageView imageView, VkImageLayout imageLayout) {
+    return allocateSlot(BINDLESS_RESOURCE_SAMPLED_IMAGE, {.imageView = imageView, .imageLayout = imageLayout});
+}
+
+BindlessHandle BindlessDescriptors::registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    return allocateSlot(BINDLESS_RESOURCE_STORAGE_BUFFER, {.buffer = buffer, .offset = offset, .range = range});
+}
+
+BindlessHandle BindlessDescriptors::registerSampler(VkSampler sampler) {
+    return allocateSlot(BINDLESS_RESOURCE_SAMPLER, {.sampler = sampler});
+}
+
+void BindlessDescriptors::updateSampledImage(BindlessHandle handle, VkImageView imageView,
+                                             VkImageLayout imageLayout) {
+    auto &resource = resources[BINDLESS_RESOURCE_SAMPLED_IMAGE][handle];
+    resource.imageView = imageView;
+    resource.imageLayout = imageLayout;
+    writeDescriptor(BINDLESS_RESOURCE_SAMPLED_IMAGE, handle);
+}
+
+void BindlessDescriptors::release(BindlessResourceType type, BindlessHandle handle) {
+    resources[type][handle] = BindlessResource{};
+    slots[type].release(handle, frameNumber);
+}
+
+void BindlessDescriptors::beginFrame(uint64_t frameNumber) {
+    this->frameNumber = frameNumber;
+    for (auto &allocator: slots) {
+        allocator.collect(frameNumber);
+    }
+}
+
+void BindlessDescriptors::bindSet(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                                  VkPipelineLayout pipelineLayout) {
+    if (enabled) {
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 1, 1, &set, 0, nullptr);
+    }
+}
+
+void BindlessDescriptors::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                               VkPipelineLayout pipelineLayout, uint32_t frameIndex, PushConstants &pushConstants,
+                               BindlessHandle image, BindlessHandle sampler, BindlessHandle storageBuffer) {
+    if (enabled) {
+        pushConstants.textureIndex = image;
+        pushConstants.samplerIndex = sampler;
+        pushConstants.storageBufferIndex = storageBuffer == INVALID_BINDLESS_HANDLE ? 0 : storageBuffer;
+        return;
+    }
+
+    pushConstants.textureIndex = 0;
+    pushConstants.samplerIndex = 0;
+    pushConstants.storageBufferIndex = 0;
+
+    auto classicSet = frameAllocator->allocate(frameIndex, layout);
+    const auto &imageResource = resources[BINDLESS_RESOURCE_SAMPLED_IMAGE][image];
+    const auto &samplerResource = resources[BINDLESS_RESOURCE_SAMPLER][sampler];
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = imageResource.imageView;
+    imageInfo.imageLayout = imageResource.imageLayout;
+
+    VkDescriptorImageInfo samplerInfo{};
+    samplerInfo.sampler = samplerResource.sampler;
+
+    std::array<VkWriteDescriptorSet, 3> writes{};
+    writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[0].dstSet = classicSet;
+    writes[0].dstBinding = BINDLESS_RESOURCE_SAMPLED_IMAGE;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    writes[0].pImageInfo = &imageInfo;
+
+    writes[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writes[1].dstSet = classicSet;
+    writes[1].dstBinding = BINDLESS_RESOURCE_SAMPLER;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    writes[1].pImageInfo = &samplerInfo;
+
+    uint32_t writeCount = 2;
+    VkDescriptorBufferInfo bufferInfo{};
+    if (storageBuffer != INVALID_BINDLESS_HANDLE) {
+        const auto &bufferResource = resources[BINDLESS_RESOURCE_STORAGE_BUFFER][storageBuffer];
+        bufferInfo.buffer = bufferResource.buffer;
+        bufferInfo.offset = bufferResource.offset;
+        bufferInfo.range = bufferResource.range;
+
+        writes[2] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[2].dstSet = classicSet;
+        writes[2].dstBinding = BINDLESS_RESOURCE_STORAGE_BUFFER;
+        writes[2].descriptorCount = 1;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[2].pBufferInfo = &bufferInfo;
+        writeCount++;
+    }
+
+    vkUpdateDescriptorSets(device, writeCount, writes.data(), 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 1, 1, &classicSet, 0, nullptr);
+}
+
+BindlessHandle BindlessDescriptors::allocateSlot(BindlessResourceType type, const BindlessResource &resource) {
+    auto handle = slots[type].allocate();
+    if (handle >= resources[type].size()) {
+        resources[type].resize(handle + 1);
+    }
+
+    resources[type][handle] = resource;
+    writeDescriptor(type, handle);
+    return handle;
+}
+
+void BindlessDescriptors::writeDescriptor(BindlessResourceType type, BindlessHandle handle) {
+    if (!enabled) {
+        return;
+    }
+
+    const auto &resource = resources[type][handle];
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = resource.imageView;
+    imageInfo.imageLayout = resource.imageLayout;
+    imageInfo.sampler = resource.sampler;
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = resource.buffer;
+    bufferInfo.offset = resource.offset;
+    bufferInfo.range = resource.range;
+
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = set;
+    write.dstBinding = type;
+    write.dstArrayElement = handle;
+    write.descriptorCount = 1;
+    write.descriptorType = descriptorTypes[type];
+    if (type == BINDLESS_RESOURCE_STORAGE_BUFFER) {
+        write.pBufferInfo = &bufferInfo;
+    } else {
+        write.pImageInfo = &imageInfo;
+    }
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_types.h"
+#include "vulkan_descriptors.h"
+
+typedef uint32_t BindlessHandle;
+
+constexpr BindlessHandle INVALID_BINDLESS_HANDLE = UINT32_MAX;
+
+// The values double as the binding numbers inside the bindless set
+enum BindlessResourceType {
+    BINDLESS_RESOURCE_SAMPLED_IMAGE = 0,
+    BINDLESS_RESOURCE_STORAGE_BUFFER = 1,
+    BINDLESS_RESOURCE_SAMPLER = 2,
+    BINDLESS_RESOURCE_TYPE_COUNT
+};
+
+// Hands out array slots. Released slots are only reused once every frame that could still reference them
+// has finished on the GPU.
+class BindlessSlotAllocator {
+public:
+    void initialize(uint32_t capacity);
+
+    BindlessHandle allocate();
+
+    void release(BindlessHandle handle, uint64_t frameNumber);
+
+    void collect(uint64_t frameNumber);
+
+    uint32_t getCapacity() const { return capacity; }
+
+    uint32_t getUsedCount() const { return next - freeSlots.size() - pendingSlots.size(); }
+
+private:
+    typedef struct PendingSlot {
+        BindlessHandle handle;
+        uint64_t releasedFrame;
+    } PendingSlot;
+
+    uint32_t capacity = 0;
+    uint32_t next = 0;
+    std::vector<BindlessHandle> freeSlots;
+    std::deque<PendingSlot> pendingSlots;
+};
+
+typedef struct BindlessResource {
+    VkImageView imageView;
+    VkImageLayout imageLayout;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+    VkSampler sampler;
+} BindlessResource;
+
+// Set 1 of every pipeline layout. When descriptor indexing is available it holds large update-after-bind arrays
+// of sampled images, storage buffers and samplers, and draws only push the indices. Without it the same handles
+// are kept in a CPU side table and bind() writes a classic per-frame set with a single descriptor per binding.
+class BindlessDescriptors {
+public:
+    BindlessDescriptors() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    DescriptorLayoutCache &layoutCache, DescriptorAllocator &frameAllocator, bool enabled);
+
+    void destroy();
+
+    bool isEnabled() const { return enabled; }
+
+    VkDescriptorSetLayout getLayout() const { return layout; }
+
+    // Array size of the binding in the set layout, shaders size their descriptor arrays with it
+    uint32_t getDescriptorCount(BindlessResourceType type) const { return enabled ? slots[type].getCapacity() : 1; }
+
+    BindlessHandle registerSampledImage(VkImageView imageView, VkImageLayout imageLayout);
+
+    BindlessHandle registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+    BindlessHandle registerSampler(VkSampler sampler);
+
+    void updateSampledImage(BindlessHandle handle, VkImageView imageView, VkImageLayout imageLayout);
+
+    void release(BindlessResourceType type, BindlessHandle handle);
+
+    void beginFrame(uint64_t frameNumber);
+
+    void bindSet(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout);
+
+    // Fills the indices of the resources into pushConstants. Without descriptor indexing every index is 0 and the
+    // resources are written into a per-frame set, storageBuffer may be INVALID_BINDLESS_HANDLE for draws without one.
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+              uint32_t frameIndex, PushConstants &pushConstants, BindlessHandle image, BindlessHandle sampler,
+              BindlessHandle storageBuffer = INVALID_BINDLESS_HANDLE);
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    DescriptorAllocator *frameAllocator = nullptr;
+    bool enabled = false;
+    uint64_t frameNumber = 0;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+
+    std::array<BindlessSlotAllocator, BINDLESS_RESOURCE_TYPE_COUNT> slots;
+    std::array<std::vector<BindlessResource>, BINDLESS_RESOURCE_TYPE_COUNT> resources;
+
+    BindlessHandle allocateSlot(BindlessResourceType type, const BindlessResource &resource);
+
+    void writeDescriptor(BindlessResourceType type, BindlessHandle handle);
+};
@@ -0,0 +1,60 @@
+#include "vulkan_buffer.h"
+#include "vulkan.h"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    const std::vector<uint32_t> &queueFamilyIndices) {
+    Buffer result{};
+    result.size = size;
+
+    VkBufferCreateInfo createInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    createInfo.size = size;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queueFamilyIndices.size() > 1) {
+        createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = queueFamilyIndices.size();
+        createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    }
+
+    VK_CHECK(vkCreateBuffer(device, &createInfo, allocationCallbacks, &result.buffer))
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, result.buffer, &memoryRequirements);
+
+    VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocInfo.allocationSize = memoryRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits, properties);
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, allocationCallbacks, &result.memory))
+
+    VK_CHECK(vkBindBufferMemory(device, result.buffer, result.memory, 0))
+
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped))
+    }
+
+    return result;
+}
+
+void destroyBuffer(VkDevice device, const VkAllocationCallbacks *allocationCallbacks, Buffer &buffer) {
+    if (buffer.mapped) {
+        vkUnmapMemory(device, buffer.memory);
+    }
+
+    vkDestroyBuffer(device, buffer.buffer, allocationCallbacks);
+    vkFreeMemory(device, buffer.memory, allocationCallbacks);
+    buffer = Buffer{};
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+typedef struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+} Buffer;
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// Host visible buffers are mapped once on creation and stay mapped until destroyBuffer. With more than one queue
+// family the buffer is shared between them concurrently.
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    const std::vector<uint32_t> &queueFamilyIndices = {});
+
+void destroyBuffer(VkDevice device, const VkAllocationCallbacks *allocationCallbacks, Buffer &buffer);
@@ -0,0 +1,178 @@
+#include "vulkan_descriptors.h"
+#include <algorithm>
+#include "vulkan.h"
+
+static constexpr uint32_t SETS_PER_POOL = 256;
+
+static const std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SETS_PER_POOL * 2},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_SAMPLER,                SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          SETS_PER_POOL},
+};
+
+bool DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo &other) const {
+    if (flags != other.flags || bindingFlags != other.bindingFlags || bindings.size() != other.bindings.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        const auto &a = bindings[i];
+        const auto &b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags ||
+            a.pImmutableSamplers != b.pImmutableSamplers) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t DescriptorLayoutInfoHash::operator()(const DescriptorLayoutInfo &info) const {
+    size_t result = std::hash<uint32_t>()(info.flags);
+    auto combine = [&result](size_t value) {
+        result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+    };
+
+    for (const auto &binding: info.bindings) {
+        combine(binding.binding);
+        combine(binding.descriptorType);
+        combine(binding.descriptorCount);
+        combine(binding.stageFlags);
+    }
+
+    for (const auto &flags: info.bindingFlags) {
+        combine(flags);
+    }
+
+    return result;
+}
+
+void DescriptorLayoutCache::initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+}
+
+void DescriptorLayoutCache::destroy() {
+    for (auto &[info, layout]: layouts) {
+        vkDestroyDescriptorSetLayout(device, layout, allocationCallbacks);
+    }
+    layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::getLayout(DescriptorLayoutInfo info) {
+    // Sort by binding (together with the matching flags) so the same set described in a different order is reused
+    std::vector<size_t> order(info.bindings.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&info](size_t a, size_t b) {
+        return info.bindings[a].binding < info.bindings[b].binding;
+    });
+
+    DescriptorLayoutInfo key{.flags = info.flags};
+    for (size_t i: order) {
+        key.bindings.push_back(info.bindings[i]);
+        if (!info.bindingFlags.empty()) {
+            key.bindingFlags.push_back(info.bindingFlags[i]);
+        }
+    }
+
+    auto found = layouts.find(key);
+    if (found != layouts.end()) {
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    bindingFlagsInfo.bindingCount = key.bindingFlags.size();
+    bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    createInfo.bindingCount = key.bindings.size();
+    createInfo.pBindings = key.bindings.data();
+    createInfo.flags = key.flags;
+    createInfo.pNext = key.bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &createInfo, allocationCallbacks, &layout))
+    layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+void DescriptorAllocator::initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+}
+
+void DescriptorAllocator::destroy() {
+    for (auto &frame: frames) {
+        for (auto &pool: frame.used) {
+            vkDestroyDescriptorPool(device, pool, allocationCallbacks);
+        }
+        frame.used.clear();
+        frame.current = VK_NULL_HANDLE;
+    }
+
+    for (auto &pool: freePools) {
+        vkDestroyDescriptorPool(device, pool, allocationCallbacks);
+    }
+    freePools.clear();
+}
+
+void DescriptorAllocator::resetFrame(uint32_t frameIndex) {
+    auto &frame = frames[frameIndex];
+    for (auto &pool: frame.used) {
+        VK_CHECK(vkResetDescriptorPool(device, pool, 0))
+        freePools.push_back(pool);
+    }
+    frame.used.clear();
+    frame.current = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(uint32_t frameIndex, VkDescriptorSetLayout layout) {
+    auto &frame = frames[frameIndex];
+    if (frame.current == VK_NULL_HANDLE) {
+        frame.current = acquirePool();
+        frame.used.push_back(frame.current);
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocateInfo.descriptorPool = frame.current;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet result;
+    auto status = vkAllocateDescriptorSets(device, &allocateInfo, &result);
+    if (status == VK_ERROR_OUT_OF_POOL_MEMORY || status == VK_ERROR_FRAGMENTED_POOL) {
+        frame.current = acquirePool();
+        frame.used.push_back(frame.current);
+        allocateInfo.descriptorPool = frame.current;
+        status = vkAllocateDescriptorSets(device, &allocateInfo, &result);
+    }
+
+    VK_CHECK(status)
+    return result;
+}
+
+VkDescriptorPool DescriptorAllocator::acquirePool() {
+    if (!freePools.empty()) {
+        auto pool = freePools.back();
+        freePools.pop_back();
+        return pool;
+    }
+
+    VkDescriptorPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    createInfo.maxSets = SETS_PER_POOL;
+    createInfo.poolSizeCount = poolSizes.size();
+    createInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(device, &createInfo, allocationCallbacks, &pool))
+    return pool;
+}
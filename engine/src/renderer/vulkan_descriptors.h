@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_types.h"
+
+typedef struct DescriptorLayoutInfo {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    std::vector<VkDescriptorBindingFlags> bindingFlags;
+    VkDescriptorSetLayoutCreateFlags flags = 0;
+
+    bool operator==(const DescriptorLayoutInfo &other) const;
+} DescriptorLayoutInfo;
+
+struct DescriptorLayoutInfoHash {
+    size_t operator()(const DescriptorLayoutInfo &info) const;
+};
+
+// Deduplicates descriptor set layouts, identical binding descriptions always map to the same VkDescriptorSetLayout.
+class DescriptorLayoutCache {
+public:
+    DescriptorLayoutCache() = default;
+
+    void initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks);
+
+    void destroy();
+
+    VkDescriptorSetLayout getLayout(DescriptorLayoutInfo info);
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, DescriptorLayoutInfoHash> layouts;
+};
+
+// Hands out descriptor sets which are only valid for the frame they were allocated in. The pools of a frame are
+// reset as a whole once the frame's fence has been waited on, so individual sets are never freed.
+class DescriptorAllocator {
+public:
+    DescriptorAllocator() = default;
+
+    void initialize(VkDevice device, const VkAllocationCallbacks *allocationCallbacks);
+
+    void destroy();
+
+    void resetFrame(uint32_t frameIndex);
+
+    VkDescriptorSet allocate(uint32_t frameIndex, VkDescriptorSetLayout layout);
+
+private:
+    typedef struct FramePools {
+        VkDescriptorPool current = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> used;
+    } FramePools;
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    std::array<FramePools, MAX_FRAMES_IN_FLIGHT> frames;
+    std::vector<VkDescriptorPool> freePools;
+
+    VkDescriptorPool acquirePool();
+};
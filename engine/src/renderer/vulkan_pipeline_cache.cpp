@@ -0,0 +1,89 @@
+#include "vulkan_pipeline_cache.h"
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include "core/file.h"
+
+void PipelineCache::initialize(const VkPhysicalDeviceProperties &properties, VkDevice device,
+                               const VkAllocationCallbacks *allocationCallbacks, const std::string &fileName) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->properties = properties;
+    this->fileName = fileName;
+
+    std::vector<char> data;
+    if (std::filesystem::exists(fileName)) {
+        try {
+            data = readBinaryFile(fileName);
+        } catch (const std::exception &e) {
+            std::cerr << "Unable to read pipeline cache: " << e.what() << std::endl;
+        }
+
+        if (!data.empty() && !isCompatible(data)) {
+            std::cout << "Discarding pipeline cache written by a different device or driver" << std::endl;
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.data();
+    if (vkCreatePipelineCache(device, &createInfo, allocationCallbacks, &cache) != VK_SUCCESS) {
+        // Some drivers reject damaged data instead of ignoring it, an empty cache is always valid
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(device, &createInfo, allocationCallbacks, &cache) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline cache");
+        }
+    }
+}
+
+void PipelineCache::destroy() {
+    if (cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    save();
+    vkDestroyPipelineCache(device, cache, allocationCallbacks);
+    cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::isCompatible(const std::vector<char> &data) const {
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+    return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() const {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Written under a temporary name and renamed, an interrupted write must not leave a damaged cache behind
+    auto temporaryPath = fileName + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), size);
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, fileName, error);
+    if (error) {
+        std::cerr << std::format("Unable to write pipeline cache {}: {}", fileName, error.message()) << std::endl;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache persisted to disk between runs. Data written by a different device or driver is discarded on load.
+class PipelineCache {
+public:
+    PipelineCache() = default;
+
+    void initialize(const VkPhysicalDeviceProperties &properties, VkDevice device,
+                    const VkAllocationCallbacks *allocationCallbacks, const std::string &fileName);
+
+    // Writes the cache back to its file before destroying it
+    void destroy();
+
+    VkPipelineCache get() const { return cache; }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    std::string fileName;
+
+    bool isCompatible(const std::vector<char> &data) const;
+
+    void save() const;
+};
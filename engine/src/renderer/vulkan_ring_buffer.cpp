@@ -0,0 +1,44 @@
+#include "vulkan_ring_buffer.h"
+#include <format>
+#include <stdexcept>
+#include "vulkan_types.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void RingBuffer::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                            const VkAllocationCallbacks *allocationCallbacks, VkDeviceSize frameSize,
+                            VkDeviceSize bindingRange, VkDeviceSize alignment, VkBufferUsageFlags usage) {
+    this->alignment = alignment;
+    this->frameSize = alignUp(frameSize, alignment);
+    this->bindingRange = bindingRange;
+
+    buffer = createBuffer(physicalDevice, device, allocationCallbacks,
+                          this->frameSize * MAX_FRAMES_IN_FLIGHT + bindingRange, usage,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    beginFrame(0);
+}
+
+void RingBuffer::destroy(VkDevice device, const VkAllocationCallbacks *allocationCallbacks) {
+    destroyBuffer(device, allocationCallbacks, buffer);
+}
+
+void RingBuffer::beginFrame(uint32_t frameIndex) {
+    frameStart = frameSize * frameIndex;
+    head = frameStart;
+}
+
+RingAllocation RingBuffer::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = alignUp(head, alignment);
+    if (offset + size > frameStart + frameSize) {
+        throw std::runtime_error(std::format("Ring buffer exhausted: requested {} bytes, {} of {} bytes used",
+                                             size, head - frameStart, frameSize));
+    }
+
+    head = offset + size;
+    return {
+            .offset = static_cast<uint32_t>(offset),
+            .data = static_cast<char *>(buffer.mapped) + offset,
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstring>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_buffer.h"
+
+typedef struct RingAllocation {
+    uint32_t offset;
+    void *data;
+} RingAllocation;
+
+// Persistently mapped buffer split into one region per frame in flight. Allocations are a pointer bump inside the
+// region of the current frame, the returned offset is meant to be used as a dynamic descriptor offset.
+class RingBuffer {
+public:
+    RingBuffer() = default;
+
+    // bindingRange is the range written into the dynamic descriptor, the buffer is padded by it so that any
+    // allocation offset inside a frame region stays a valid dynamic offset.
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    VkDeviceSize frameSize, VkDeviceSize bindingRange, VkDeviceSize alignment,
+                    VkBufferUsageFlags usage);
+
+    void destroy(VkDevice device, const VkAllocationCallbacks *allocationCallbacks);
+
+    void beginFrame(uint32_t frameIndex);
+
+    RingAllocation allocate(VkDeviceSize size);
+
+    template<typename T>
+    RingAllocation push(const T &value) {
+        auto allocation = allocate(sizeof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    VkBuffer getBuffer() const { return buffer.buffer; }
+
+    VkDeviceSize getBindingRange() const { return bindingRange; }
+
+    VkDeviceSize getFrameUsage() const { return head - frameStart; }
+
+private:
+    Buffer buffer;
+    VkDeviceSize frameSize = 0;
+    VkDeviceSize bindingRange = 0;
+    VkDeviceSize alignment = 1;
+    VkDeviceSize frameStart = 0;
+    VkDeviceSize head = 0;
+};
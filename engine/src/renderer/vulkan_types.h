@@ -3,6 +3,9 @@
 #include <vulkan/vulkan.h>
 #include <array>
 #include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 
 struct Vertex {
     glm::vec3 position;
@@ -32,3 +35,31 @@ struct Vertex {
         return result;
     }
 };
+
+struct CameraData {
+    glm::mat4 viewProjection;
+};
+
+struct ObjectData {
+    glm::mat4 model;
+};
+
+// Optional shading features of a draw. Specialized pipelines receive them as specialization constants, the uber
+// pipeline reads them from PushConstants::features. Must match the FEATURE_* constants in the shaders.
+enum ShaderFeature : uint32_t {
+    SHADER_FEATURE_VERTEX_COLOR = 1 << 0,
+    SHADER_FEATURE_TONEMAP = 1 << 1,
+    SHADER_FEATURE_DITHER = 1 << 2,
+    SHADER_FEATURE_ALL = SHADER_FEATURE_VERTEX_COLOR | SHADER_FEATURE_TONEMAP | SHADER_FEATURE_DITHER
+};
+
+typedef uint32_t ShaderFeatures;
+
+// Small per-draw data, must stay within the guaranteed 128 bytes of push constant space.
+struct PushConstants {
+    uint32_t objectIndex;
+    uint32_t textureIndex;
+    uint32_t samplerIndex;
+    ShaderFeatures features;
+    uint32_t storageBufferIndex;
+};
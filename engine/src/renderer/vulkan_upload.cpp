@@ -0,0 +1,228 @@
+#include "vulkan_upload.h"
+#include <cstring>
+#include <format>
+#include "vulkan.h"
+
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+void UploadQueue::initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                             const VkAllocationCallbacks *allocationCallbacks, uint32_t queueFamilyIndex,
+                             VkQueue queue, VkDeviceSize stagingSize) {
+    this->device = device;
+    this->allocationCallbacks = allocationCallbacks;
+    this->queueFamilyIndex = queueFamilyIndex;
+    this->queue = queue;
+
+    VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    createInfo.queueFamilyIndex = queueFamilyIndex;
+    VK_CHECK(vkCreateCommandPool(device, &createInfo, allocationCallbacks, &commandPool))
+
+    staging = createBuffer(physicalDevice, device, allocationCallbacks, stagingSize,
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void UploadQueue::destroy() {
+    if (recording.commandBuffer != VK_NULL_HANDLE) {
+        VK_CHECK(vkEndCommandBuffer(recording.commandBuffer))
+        freeBatches.push_back(recording);
+        recording = UploadBatch{};
+    }
+
+    for (auto &batch: inFlight) {
+        freeBatches.push_back(batch);
+    }
+    inFlight.clear();
+
+    for (auto &batch: freeBatches) {
+        vkDestroyFence(device, batch.fence, allocationCallbacks);
+    }
+    freeBatches.clear();
+
+    vkDestroyCommandPool(device, commandPool, allocationCallbacks);
+    destroyBuffer(device, allocationCallbacks, staging);
+}
+
+bool UploadQueue::uploadImage(VkImage image, uint32_t mipLevels, const void *data, VkDeviceSize size,
+                              std::vector<VkBufferImageCopy> regions, std::function<void()> onComplete) {
+    VkDeviceSize offset;
+    if (!allocateStaging(size, offset)) {
+        return false;
+    }
+
+    memcpy(static_cast<char *>(staging.mapped) + offset, data, size);
+    for (auto &region: regions) {
+        region.bufferOffset += offset;
+    }
+
+    beginRecording();
+
+    VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(recording.commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           regions.size(), regions.data());
+
+    // The transfer queue may not know about shader stages, consumers only see the image after the fence signaled
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (onComplete) {
+        recording.callbacks.push_back(std::move(onComplete));
+    }
+    return true;
+}
+
+bool UploadQueue::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                               std::function<void()> onComplete) {
+    VkDeviceSize stagingOffset;
+    if (!allocateStaging(size, stagingOffset)) {
+        return false;
+    }
+
+    memcpy(static_cast<char *>(staging.mapped) + stagingOffset, data, size);
+    beginRecording();
+
+    VkBufferCopy region{};
+    region.srcOffset = stagingOffset;
+    region.dstOffset = offset;
+    region.size = size;
+    vkCmdCopyBuffer(recording.commandBuffer, staging.buffer, buffer, 1, &region);
+
+    if (onComplete) {
+        recording.callbacks.push_back(std::move(onComplete));
+    }
+    return true;
+}
+
+void UploadQueue::flush() {
+    if (recording.commandBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VK_CHECK(vkEndCommandBuffer(recording.commandBuffer))
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &recording.commandBuffer;
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, recording.fence))
+
+    inFlight.push_back(std::move(recording));
+    recording = UploadBatch{};
+}
+
+void UploadQueue::poll() {
+    while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+        auto batch = std::move(inFlight.front());
+        inFlight.pop_front();
+
+        for (auto &callback: batch.callbacks) {
+            callback();
+        }
+
+        batch.callbacks.clear();
+        batch.hasAllocations = false;
+        freeBatches.push_back(std::move(batch));
+    }
+
+    if (inFlight.empty() && !recording.hasAllocations) {
+        head = 0;
+    }
+}
+
+bool UploadQueue::canStage(VkDeviceSize size) const {
+    VkDeviceSize offset;
+    return findStagingOffset(size, offset);
+}
+
+bool UploadQueue::findStagingOffset(VkDeviceSize size, VkDeviceSize &offset) const {
+    if (size > staging.size) {
+        throw std::runtime_error(std::format("Upload of {} bytes exceeds the staging buffer size of {} bytes",
+                                             size, staging.size));
+    }
+
+    if (inFlight.empty() && !recording.hasAllocations) {
+        offset = 0;
+        return true;
+    }
+
+    VkDeviceSize candidate = (head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    VkDeviceSize tail = inFlight.empty() ? recording.stagingBegin : inFlight.front().stagingBegin;
+    if (head >= tail) {
+        if (candidate + size <= staging.size) {
+            offset = candidate;
+        } else if (size < tail) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (candidate + size < tail) {
+        offset = candidate;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool UploadQueue::allocateStaging(VkDeviceSize size, VkDeviceSize &offset) {
+    if (!findStagingOffset(size, offset)) {
+        return false;
+    }
+
+    if (!recording.hasAllocations) {
+        recording.stagingBegin = offset;
+        recording.hasAllocations = true;
+    }
+
+    head = offset + size;
+    return true;
+}
+
+void UploadQueue::beginRecording() {
+    if (recording.commandBuffer != VK_NULL_HANDLE) {
+        return;
+    }
+
+    auto stagingBegin = recording.stagingBegin;
+    auto hasAllocations = recording.hasAllocations;
+
+    if (!freeBatches.empty()) {
+        recording.commandBuffer = freeBatches.back().commandBuffer;
+        recording.fence = freeBatches.back().fence;
+        freeBatches.pop_back();
+        VK_CHECK(vkResetFences(device, 1, &recording.fence))
+        VK_CHECK(vkResetCommandBuffer(recording.commandBuffer, 0))
+    } else {
+        VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocateInfo.commandPool = commandPool;
+        allocateInfo.commandBufferCount = 1;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &recording.commandBuffer))
+
+        VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VK_CHECK(vkCreateFence(device, &fenceCreateInfo, allocationCallbacks, &recording.fence))
+    }
+
+    recording.stagingBegin = stagingBegin;
+    recording.hasAllocations = hasAllocations;
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(recording.commandBuffer, &beginInfo))
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vulkan_buffer.h"
+
+// Asynchronous uploads through a staging ring on the transfer queue. Copies recorded during a frame are submitted
+// together by flush(), poll() retires finished batches, frees their staging space and runs their completion
+// callbacks. Nothing here ever waits on the GPU, a full staging ring simply rejects the upload for this frame.
+class UploadQueue {
+public:
+    UploadQueue() = default;
+
+    void initialize(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks *allocationCallbacks,
+                    uint32_t queueFamilyIndex, VkQueue queue, VkDeviceSize stagingSize);
+
+    void destroy();
+
+    // Region buffer offsets are relative to data. Levels [0, mipLevels) of the image end up in
+    // SHADER_READ_ONLY_OPTIMAL.
+    bool uploadImage(VkImage image, uint32_t mipLevels, const void *data, VkDeviceSize size,
+                     std::vector<VkBufferImageCopy> regions, std::function<void()> onComplete);
+
+    // Whether an upload of size bytes would currently fit into the staging ring, lets callers skip creating the
+    // destination of an upload that would be rejected
+    bool canStage(VkDeviceSize size) const;
+
+    bool uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                      std::function<void()> onComplete);
+
+    void flush();
+
+    void poll();
+
+    uint32_t getQueueFamilyIndex() const { return queueFamilyIndex; }
+
+    size_t getBatchesInFlight() const { return inFlight.size(); }
+
+private:
+    typedef struct UploadBatch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkDeviceSize stagingBegin = 0;
+        bool hasAllocations = false;
+        std::vector<std::function<void()>> callbacks;
+    } UploadBatch;
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocationCallbacks = nullptr;
+    uint32_t queueFamilyIndex = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    Buffer staging;
+    VkDeviceSize head = 0;
+
+    UploadBatch recording;
+    std::deque<UploadBatch> inFlight;
+    std::vector<UploadBatch> freeBatches;
+
+    bool findStagingOffset(VkDeviceSize size, VkDeviceSize &offset) const;
+
+    bool allocateStaging(VkDeviceSize size, VkDeviceSize &offset);
+
+    void beginRecording();
+};
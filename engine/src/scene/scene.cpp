@@ -0,0 +1,236 @@
+#include "scene.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
+#include "core/file.h"
+
+static const std::string SCENE_TEXT_MAGIC = "dark_star_scene";
+static constexpr uint32_t SCENE_TEXT_VERSION = 1;
+// Parent, translation, scale, rotation, mesh and material
+static constexpr size_t SCENE_TEXT_ENTITY_TOKENS = 11;
+// Stands for an empty mesh or material name
+static const std::string SCENE_TEXT_NONE = "-";
+
+glm::mat4 toMatrix(const SceneTransform &transform) {
+    auto matrix = glm::translate(glm::mat4(1.0f), transform.translation) * glm::mat4_cast(transform.rotation);
+    return glm::scale(matrix, glm::vec3(transform.scale));
+}
+
+static uint32_t resolveName(const std::string &name, std::unordered_map<std::string, uint32_t> &indices,
+                            std::vector<std::string> &names) {
+    if (name.empty()) {
+        return SCENE_NO_INDEX;
+    }
+
+    auto [it, inserted] = indices.try_emplace(name, static_cast<uint32_t>(names.size()));
+    if (inserted) {
+        names.push_back(name);
+    }
+    return it->second;
+}
+
+CookedScene cookScene(const Scene &scene) {
+    CookedScene cooked;
+    std::unordered_map<std::string, uint32_t> meshIndices;
+    std::unordered_map<std::string, uint32_t> materialIndices;
+
+    auto entityCount = static_cast<uint32_t>(scene.entities.size());
+    cooked.parents.reserve(entityCount);
+    cooked.localTransforms.reserve(entityCount);
+    cooked.meshIndices.reserve(entityCount);
+    cooked.materialIndices.reserve(entityCount);
+
+    // Parents precede their children, so a single pass sees every parent's world transform before its children
+    std::vector<glm::mat4> worldTransforms(entityCount);
+    std::vector<uint32_t> instances;
+    for (uint32_t i = 0; i < entityCount; ++i) {
+        const auto &entity = scene.entities[i];
+        if (entity.parent != SCENE_NO_INDEX && entity.parent >= i) {
+            throw std::runtime_error(std::format("Scene entity {} has parent {} which does not precede it", i,
+                                                 entity.parent));
+        }
+
+        auto local = toMatrix(entity.local);
+        worldTransforms[i] = entity.parent == SCENE_NO_INDEX ? local : worldTransforms[entity.parent] * local;
+
+        cooked.parents.push_back(entity.parent);
+        cooked.localTransforms.push_back(entity.local);
+        cooked.meshIndices.push_back(resolveName(entity.mesh, meshIndices, cooked.meshes));
+        cooked.materialIndices.push_back(resolveName(entity.material, materialIndices, cooked.materials));
+        if (cooked.meshIndices.back() != SCENE_NO_INDEX) {
+            instances.push_back(i);
+        }
+    }
+
+    // Entities keep their order within a draw range
+    std::stable_sort(instances.begin(), instances.end(), [&cooked](uint32_t a, uint32_t b) {
+        return std::pair(cooked.meshIndices[a], cooked.materialIndices[a]) <
+               std::pair(cooked.meshIndices[b], cooked.materialIndices[b]);
+    });
+
+    cooked.instanceTransforms.reserve(instances.size());
+    cooked.instanceEntities = std::move(instances);
+    for (uint32_t i = 0; i < cooked.instanceEntities.size(); ++i) {
+        auto entity = cooked.instanceEntities[i];
+        auto mesh = cooked.meshIndices[entity];
+        auto material = cooked.materialIndices[entity];
+        cooked.instanceTransforms.push_back(worldTransforms[entity]);
+
+        if (cooked.drawRanges.empty() || cooked.drawRanges.back().mesh != mesh ||
+            cooked.drawRanges.back().material != material) {
+            cooked.drawRanges.push_back({mesh, material, i, 0});
+        }
+        cooked.drawRanges.back().instanceCount++;
+    }
+
+    return cooked;
+}
+
+static void appendName(std::string &output, const std::string &name) {
+    if (name.empty()) {
+        output += SCENE_TEXT_NONE;
+        return;
+    }
+
+    auto whitespace = std::any_of(name.begin(), name.end(), [](char c) {
+        return isspace(static_cast<unsigned char>(c));
+    });
+    if (name == SCENE_TEXT_NONE || whitespace) {
+        throw std::runtime_error(std::format("Scene asset name can not be written as text: '{}'", name));
+    }
+    output += name;
+}
+
+void writeSceneText(const std::string &fileName, const Scene &scene) {
+    std::string output = std::format("{} {}\nentities {}\n", SCENE_TEXT_MAGIC, SCENE_TEXT_VERSION,
+                                     scene.entities.size());
+    auto out = std::back_inserter(output);
+    for (const auto &entity: scene.entities) {
+        const auto &local = entity.local;
+        std::format_to(out, "{} {} {} {} {} {} {} {} {} ",
+                       entity.parent == SCENE_NO_INDEX ? -1 : static_cast<int64_t>(entity.parent),
+                       local.translation.x, local.translation.y, local.translation.z, local.scale,
+                       local.rotation.x, local.rotation.y, local.rotation.z, local.rotation.w);
+        appendName(output, entity.mesh);
+        output += ' ';
+        appendName(output, entity.material);
+        output += '\n';
+    }
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error(std::format("Unable to open file for writing: {}", fileName));
+    }
+
+    file.write(output.data(), output.size());
+    if (!file.good()) {
+        throw std::runtime_error(std::format("Unable to write file: {}", fileName));
+    }
+}
+
+// Whitespace separated tokens of the whole file
+class SceneTextReader {
+public:
+    SceneTextReader(const std::string &fileName, const std::vector<char> &contents)
+            : fileName(fileName), position(contents.data()), end(contents.data() + contents.size()) {}
+
+    std::string_view token() {
+        while (position < end && isspace(static_cast<unsigned char>(*position))) {
+            ++position;
+        }
+
+        auto start = position;
+        while (position < end && !isspace(static_cast<unsigned char>(*position))) {
+            ++position;
+        }
+
+        if (start == position) {
+            fail("unexpected end of file");
+        }
+        return {start, static_cast<size_t>(position - start)};
+    }
+
+    template<typename T>
+    T number() {
+        auto text = token();
+        T value{};
+        auto [last, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc() || last != text.data() + text.size()) {
+            fail(std::format("invalid number '{}'", text));
+        }
+        return value;
+    }
+
+    size_t remaining() const {
+        return end - position;
+    }
+
+    void expect(std::string_view expected) {
+        auto text = token();
+        if (text != expected) {
+            fail(std::format("expected '{}' but found '{}'", expected, text));
+        }
+    }
+
+    [[noreturn]] void fail(const std::string &reason) const {
+        throw std::runtime_error(std::format("Invalid scene file {}: {}", fileName, reason));
+    }
+
+private:
+    const std::string &fileName;
+    const char *position;
+    const char *end;
+};
+
+Scene readSceneText(const std::string &fileName) {
+    auto contents = readBinaryFile(fileName);
+    SceneTextReader reader(fileName, contents);
+
+    reader.expect(SCENE_TEXT_MAGIC);
+    auto version = reader.number<uint32_t>();
+    if (version != SCENE_TEXT_VERSION) {
+        reader.fail(std::format("unsupported version {}", version));
+    }
+
+    reader.expect("entities");
+    auto entityCount = reader.number<uint32_t>();
+    // Every token takes at least one character and a separator, the count must not allocate more than the file holds
+    if (entityCount > reader.remaining() / (SCENE_TEXT_ENTITY_TOKENS * 2)) {
+        reader.fail(std::format("{} entities do not fit into the file", entityCount));
+    }
+
+    Scene scene;
+    scene.entities.resize(entityCount);
+    for (auto &entity: scene.entities) {
+        auto parent = reader.number<int64_t>();
+        if (parent < -1 || parent >= entityCount) {
+            reader.fail(std::format("invalid parent {}", parent));
+        }
+        entity.parent = parent < 0 ? SCENE_NO_INDEX : static_cast<uint32_t>(parent);
+
+        auto &local = entity.local;
+        local.translation.x = reader.number<float>();
+        local.translation.y = reader.number<float>();
+        local.translation.z = reader.number<float>();
+        local.scale = reader.number<float>();
+        local.rotation.x = reader.number<float>();
+        local.rotation.y = reader.number<float>();
+        local.rotation.z = reader.number<float>();
+        local.rotation.w = reader.number<float>();
+
+        auto mesh = reader.token();
+        auto material = reader.token();
+        entity.mesh = mesh == SCENE_TEXT_NONE ? std::string() : std::string(mesh);
+        entity.material = material == SCENE_TEXT_NONE ? std::string() : std::string(material);
+    }
+
+    return scene;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Marks roots in parent arrays and entities without a mesh or material in index arrays
+constexpr uint32_t SCENE_NO_INDEX = UINT32_MAX;
+
+typedef struct SceneTransform {
+    glm::vec3 translation;
+    float scale;
+    glm::quat rotation;
+} SceneTransform;
+
+typedef struct SceneEntity {
+    // Index of an earlier entity, or SCENE_NO_INDEX
+    uint32_t parent;
+    SceneTransform local;
+    // Asset names, empty for entities that only take part in the hierarchy
+    std::string mesh;
+    std::string material;
+} SceneEntity;
+
+// Scene as authored or built at runtime, parents always precede their children
+typedef struct Scene {
+    std::vector<SceneEntity> entities;
+} Scene;
+
+// Instances drawn with the same mesh and material
+typedef struct SceneDrawRange {
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+} SceneDrawRange;
+
+// Everything the renderer needs from a scene: entity component arrays with asset names resolved to indices, world
+// transforms, and the instances of entities with a mesh grouped by draw range.
+typedef struct CookedScene {
+    std::vector<std::string> meshes;
+    std::vector<std::string> materials;
+
+    // Per entity
+    std::vector<uint32_t> parents;
+    std::vector<SceneTransform> localTransforms;
+    std::vector<uint32_t> meshIndices;
+    std::vector<uint32_t> materialIndices;
+
+    // Per instance, in draw range order
+    std::vector<glm::mat4> instanceTransforms;
+    std::vector<uint32_t> instanceEntities;
+
+    std::vector<SceneDrawRange> drawRanges;
+} CookedScene;
+
+glm::mat4 toMatrix(const SceneTransform &transform);
+
+// Resolves names, accumulates world transforms down the hierarchy and sorts the instances by mesh and material
+CookedScene cookScene(const Scene &scene);
+
+// Text format with one entity per line, the conventional interchange format the snapshots are compared against.
+// Floats are written in their shortest exact form, so reading a written scene gives the same bits back.
+void writeSceneText(const std::string &fileName, const Scene &scene);
+
+Scene readSceneText(const std::string &fileName);
@@ -0,0 +1,134 @@
+#include "scene_benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <glm/gtc/constants.hpp>
+
+#include "scene.h"
+#include "scene_snapshot.h"
+
+static constexpr uint32_t BENCHMARK_MESH_COUNT = 64;
+static constexpr uint32_t BENCHMARK_MATERIAL_COUNT = 16;
+// Every group has one root, the other entities of a group are attached to an earlier entity of the same group
+static constexpr uint32_t BENCHMARK_GROUP_SIZE = 256;
+// Every this many entities one only takes part in the hierarchy
+static constexpr uint32_t BENCHMARK_NODE_INTERVAL = 16;
+
+typedef std::function<const glm::mat4 *(size_t &instanceCount)> BenchmarkLoad;
+
+static Scene generateScene(uint32_t entityCount) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    Scene scene;
+    scene.entities.resize(entityCount);
+    for (uint32_t i = 0; i < entityCount; ++i) {
+        auto &entity = scene.entities[i];
+        uint32_t groupStart = i - i % BENCHMARK_GROUP_SIZE;
+        entity.parent = i == groupStart ? SCENE_NO_INDEX : groupStart + random() % (i - groupStart);
+
+        float extent = entity.parent == SCENE_NO_INDEX ? 100.0f : 2.0f;
+        entity.local.translation = glm::vec3(unit(random), unit(random), unit(random)) * extent;
+        entity.local.scale = 0.75f + 0.25f * unit(random);
+        entity.local.rotation = glm::angleAxis(unit(random) * glm::pi<float>(), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        if (i % BENCHMARK_NODE_INTERVAL != 0) {
+            entity.mesh = std::format("mesh_{:02}", random() % BENCHMARK_MESH_COUNT);
+            entity.material = std::format("material_{:02}", random() % BENCHMARK_MATERIAL_COUNT);
+        }
+    }
+
+    return scene;
+}
+
+// Best of all iterations. The transforms are copied into memory that was touched before, so only the reads count.
+static void runCase(const std::string &name, size_t fileSize, uint32_t iterations, std::vector<glm::mat4> &destination,
+                    const BenchmarkLoad &load, const std::function<void()> &unload) {
+    double loadMilliseconds = 0.0;
+    double feedMilliseconds = 0.0;
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        auto start = std::chrono::steady_clock::now();
+        size_t instanceCount = 0;
+        auto transforms = load(instanceCount);
+        auto loaded = std::chrono::steady_clock::now();
+        if (instanceCount > 0) {
+            memcpy(destination.data(), transforms, instanceCount * sizeof(glm::mat4));
+        }
+        auto fed = std::chrono::steady_clock::now();
+        unload();
+
+        std::chrono::duration<double, std::milli> loadTime = loaded - start;
+        std::chrono::duration<double, std::milli> feedTime = fed - loaded;
+        loadMilliseconds = iteration == 0 ? loadTime.count() : std::min(loadMilliseconds, loadTime.count());
+        feedMilliseconds = iteration == 0 ? feedTime.count() : std::min(feedMilliseconds, feedTime.count());
+    }
+
+    std::cout << std::format("{:<24} {:>10.1f} {:>10.2f} {:>10.2f}", name, fileSize / (1024.0 * 1024.0),
+                             loadMilliseconds, feedMilliseconds) << std::endl;
+}
+
+void runSceneBenchmark(uint32_t entityCount, uint32_t iterations) {
+    auto directory = std::filesystem::temp_directory_path();
+    auto textFile = (directory / "dark_star_scene_benchmark.scene").string();
+    auto snapshotFile = (directory / "dark_star_scene_benchmark.snapshot").string();
+
+    CookedScene reference;
+    {
+        auto scene = generateScene(entityCount);
+        reference = cookScene(scene);
+        writeSceneText(textFile, scene);
+        writeSceneSnapshot(snapshotFile, reference);
+    }
+
+    std::cout << std::format("Scene load, {} entities, {} instances in {} draw ranges, best of {}", entityCount,
+                             reference.instanceTransforms.size(), reference.drawRanges.size(), iterations)
+              << std::endl;
+    std::cout << std::format("{:<24} {:>10} {:>10} {:>10}", "path", "file MiB", "load ms", "feed ms") << std::endl;
+
+    std::vector<glm::mat4> destination(reference.instanceTransforms.size());
+    auto textSize = std::filesystem::file_size(textFile);
+    auto snapshotSize = std::filesystem::file_size(snapshotFile);
+
+    CookedScene cooked;
+    runCase("text parse + cook", textSize, iterations, destination, [&](size_t &instanceCount) {
+        cooked = cookScene(readSceneText(textFile));
+        instanceCount = cooked.instanceTransforms.size();
+        return cooked.instanceTransforms.data();
+    }, [&] {
+        cooked = {};
+    });
+
+    // The text round trip has to give exactly the transforms of the snapshot, or the comparison is meaningless
+    if (memcmp(destination.data(), reference.instanceTransforms.data(), destination.size() * sizeof(glm::mat4)) != 0) {
+        throw std::runtime_error("Scene benchmark: text scene does not match the snapshot");
+    }
+
+    SceneSnapshot snapshot;
+    for (bool verifyChecksum: {true, false}) {
+        std::ranges::fill(destination, glm::mat4(0.0f));
+        runCase(verifyChecksum ? "snapshot map + checksum" : "snapshot map", snapshotSize, iterations, destination,
+                [&](size_t &instanceCount) {
+            snapshot.open(snapshotFile, verifyChecksum);
+            instanceCount = snapshot.getInstanceCount();
+            return snapshot.getInstanceTransforms().data();
+        }, [&] {
+            snapshot.close();
+        });
+
+        if (memcmp(destination.data(), reference.instanceTransforms.data(),
+                   destination.size() * sizeof(glm::mat4)) != 0) {
+            throw std::runtime_error("Scene benchmark: snapshot does not match the cooked scene");
+        }
+    }
+
+    std::filesystem::remove(textFile);
+    std::filesystem::remove(snapshotFile);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Compares loading a generated scene from the text format, parsing and cooking it at load time, with mapping a
+// snapshot of the cooked scene. Prints the load time and the time to copy the instance transforms out, which is what
+// the renderer does with them, for each path. Both files are read from a warm page cache.
+void runSceneBenchmark(uint32_t entityCount, uint32_t iterations = 3);
@@ -0,0 +1,288 @@
+#include "scene_snapshot.h"
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+static_assert(std::endian::native == std::endian::little, "Scene snapshots are little endian and used in place");
+static_assert(sizeof(SceneTransform) == 32 && sizeof(glm::mat4) == 64 && sizeof(SceneDrawRange) == 16,
+              "Scene snapshot element layout changed, bump SCENE_SNAPSHOT_VERSION");
+static_assert(sizeof(SceneSnapshotHeader) % SCENE_SNAPSHOT_ALIGNMENT == 0);
+
+static constexpr uint64_t HASH_PRIME_1 = 0x9e3779b185ebca87ull;
+static constexpr uint64_t HASH_PRIME_2 = 0xc2b2ae3d27d4eb4full;
+static constexpr uint64_t HASH_PRIME_3 = 0x165667b19e3779f9ull;
+static constexpr uint64_t HASH_PRIME_4 = 0x85ebca77c2b2ae63ull;
+static constexpr uint64_t HASH_PRIME_5 = 0x27d4eb2f165667c5ull;
+
+static uint64_t read64(const uint8_t *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t hashRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * HASH_PRIME_2;
+    return std::rotl(accumulator, 31) * HASH_PRIME_1;
+}
+
+static uint64_t hashMerge(uint64_t hash, uint64_t accumulator) {
+    hash ^= hashRound(0, accumulator);
+    return hash * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+// XXH64 with seed 0. Four independent lanes keep it at memory speed, verifying a snapshot costs about as much as
+// reading it once.
+static uint64_t hashSnapshotData(const uint8_t *data, size_t size) {
+    auto end = data + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t lanes[4] = {HASH_PRIME_1 + HASH_PRIME_2, HASH_PRIME_2, 0, 0 - HASH_PRIME_1};
+        for (; data + 32 <= end; data += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                lanes[lane] = hashRound(lanes[lane], read64(data + lane * 8));
+            }
+        }
+
+        hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+        for (auto lane: lanes) {
+            hash = hashMerge(hash, lane);
+        }
+    } else {
+        hash = HASH_PRIME_5;
+    }
+
+    hash += size;
+    for (; data + 8 <= end; data += 8) {
+        hash ^= hashRound(0, read64(data));
+        hash = std::rotl(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (data + 4 <= end) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        hash ^= word * HASH_PRIME_1;
+        hash = std::rotl(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        data += 4;
+    }
+    for (; data < end; ++data) {
+        hash ^= *data * HASH_PRIME_5;
+        hash = std::rotl(hash, 11) * HASH_PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Zero filled, so that padding does not leak memory contents into the file and the checksum is deterministic
+static size_t allocate(std::vector<uint8_t> &data, size_t size, size_t alignment) {
+    auto offset = (data.size() + alignment - 1) & ~(alignment - 1);
+    data.resize(offset + size);
+    return offset;
+}
+
+template<typename T>
+static void setArray(std::vector<uint8_t> &data, size_t arrayOffset, size_t dataOffset, size_t count) {
+    SnapshotArray<T> array{static_cast<int64_t>(dataOffset) - static_cast<int64_t>(arrayOffset), count};
+    memcpy(data.data() + arrayOffset, &array, sizeof(array));
+}
+
+template<typename T>
+static void writeArray(std::vector<uint8_t> &data, size_t arrayOffset, const std::vector<T> &values) {
+    auto dataOffset = allocate(data, values.size() * sizeof(T), SCENE_SNAPSHOT_ALIGNMENT);
+    if (!values.empty()) {
+        memcpy(data.data() + dataOffset, values.data(), values.size() * sizeof(T));
+    }
+    setArray<T>(data, arrayOffset, dataOffset, values.size());
+}
+
+static void writeNames(std::vector<uint8_t> &data, size_t arrayOffset, const std::vector<std::string> &names) {
+    auto tableOffset = allocate(data, names.size() * sizeof(SnapshotString), SCENE_SNAPSHOT_ALIGNMENT);
+    setArray<SnapshotString>(data, arrayOffset, tableOffset, names.size());
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto nameOffset = allocate(data, names[i].size(), 1);
+        memcpy(data.data() + nameOffset, names[i].data(), names[i].size());
+        setArray<char>(data, tableOffset + i * sizeof(SnapshotString), nameOffset, names[i].size());
+    }
+}
+
+void writeSceneSnapshot(const std::string &fileName, const CookedScene &scene) {
+    std::vector<uint8_t> data;
+    allocate(data, sizeof(SceneSnapshotHeader), SCENE_SNAPSHOT_ALIGNMENT);
+
+    writeNames(data, offsetof(SceneSnapshotHeader, meshes), scene.meshes);
+    writeNames(data, offsetof(SceneSnapshotHeader, materials), scene.materials);
+    writeArray(data, offsetof(SceneSnapshotHeader, parents), scene.parents);
+    writeArray(data, offsetof(SceneSnapshotHeader, localTransforms), scene.localTransforms);
+    writeArray(data, offsetof(SceneSnapshotHeader, meshIndices), scene.meshIndices);
+    writeArray(data, offsetof(SceneSnapshotHeader, materialIndices), scene.materialIndices);
+    writeArray(data, offsetof(SceneSnapshotHeader, instanceTransforms), scene.instanceTransforms);
+    writeArray(data, offsetof(SceneSnapshotHeader, instanceEntities), scene.instanceEntities);
+    writeArray(data, offsetof(SceneSnapshotHeader, drawRanges), scene.drawRanges);
+    allocate(data, 0, SCENE_SNAPSHOT_ALIGNMENT);
+
+    // The data does not move anymore
+    auto header = reinterpret_cast<SceneSnapshotHeader *>(data.data());
+    header->magic = SCENE_SNAPSHOT_MAGIC;
+    header->version = SCENE_SNAPSHOT_VERSION;
+    header->fileSize = data.size();
+    header->entityCount = static_cast<uint32_t>(scene.parents.size());
+    header->instanceCount = static_cast<uint32_t>(scene.instanceTransforms.size());
+    header->checksum = hashSnapshotData(data.data() + sizeof(SceneSnapshotHeader),
+                                        data.size() - sizeof(SceneSnapshotHeader));
+
+    // Replaces an existing snapshot only once the new one is complete, it may be mapped by a running instance
+    auto temporaryName = fileName + ".tmp";
+    {
+        std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error(std::format("Unable to open file for writing: {}", temporaryName));
+        }
+
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!file.good()) {
+            throw std::runtime_error(std::format("Unable to write file: {}", temporaryName));
+        }
+    }
+    std::filesystem::rename(temporaryName, fileName);
+}
+
+[[noreturn]] static void invalidSnapshot(const std::string &fileName, const std::string &reason) {
+    throw std::runtime_error(std::format("Invalid scene snapshot {}: {}", fileName, reason));
+}
+
+template<typename T>
+static void checkArray(const std::string &fileName, const uint8_t *data, size_t size, const SnapshotArray<T> &array,
+                       const char *name) {
+    auto position = static_cast<int64_t>(reinterpret_cast<const uint8_t *>(&array) - data);
+    // Checked before the addition, a corrupt offset must not overflow
+    if (array.offset < -position || array.offset > static_cast<int64_t>(size) - position) {
+        invalidSnapshot(fileName, std::format("{} starts outside of the file", name));
+    }
+
+    auto start = static_cast<uint64_t>(position + array.offset);
+    if (array.count > (size - start) / sizeof(T)) {
+        invalidSnapshot(fileName, std::format("{} ends outside of the file", name));
+    }
+    if (start % alignof(T) != 0) {
+        invalidSnapshot(fileName, std::format("{} is misaligned", name));
+    }
+}
+
+template<typename T>
+static void checkArray(const std::string &fileName, const uint8_t *data, size_t size, const SnapshotArray<T> &array,
+                       const char *name, uint64_t expectedCount) {
+    checkArray(fileName, data, size, array, name);
+    if (array.count != expectedCount) {
+        invalidSnapshot(fileName, std::format("{} has {} elements instead of {}", name, array.count, expectedCount));
+    }
+}
+
+static void checkNames(const std::string &fileName, const uint8_t *data, size_t size,
+                       const SnapshotArray<SnapshotString> &names, const char *name) {
+    checkArray(fileName, data, size, names, name);
+    for (const auto &entry: names) {
+        checkArray(fileName, data, size, entry, name);
+    }
+}
+
+// Indices either refer to an element of count or are SCENE_NO_INDEX where allowed
+static void checkIndices(const std::string &fileName, const SnapshotArray<uint32_t> &indices, uint32_t count,
+                         bool optional, const char *name) {
+    for (auto index: indices) {
+        if (index >= count && !(optional && index == SCENE_NO_INDEX)) {
+            invalidSnapshot(fileName, std::format("{} contains invalid index {}", name, index));
+        }
+    }
+}
+
+static void validateSnapshot(const std::string &fileName, const uint8_t *data, size_t size, bool verifyChecksum) {
+    if (size < sizeof(SceneSnapshotHeader)) {
+        invalidSnapshot(fileName, "truncated header");
+    }
+    if (reinterpret_cast<uintptr_t>(data) % SCENE_SNAPSHOT_ALIGNMENT != 0) {
+        invalidSnapshot(fileName, "misaligned in memory");
+    }
+
+    const auto &header = *reinterpret_cast<const SceneSnapshotHeader *>(data);
+    if (header.magic != SCENE_SNAPSHOT_MAGIC) {
+        invalidSnapshot(fileName, "not a scene snapshot");
+    }
+    if (header.version != SCENE_SNAPSHOT_VERSION) {
+        invalidSnapshot(fileName, std::format("version {}, expected {}", header.version, SCENE_SNAPSHOT_VERSION));
+    }
+    if (header.fileSize != size) {
+        invalidSnapshot(fileName, std::format("file has {} bytes, expected {}", size, header.fileSize));
+    }
+    if (verifyChecksum) {
+        auto checksum = hashSnapshotData(data + sizeof(SceneSnapshotHeader), size - sizeof(SceneSnapshotHeader));
+        if (checksum != header.checksum) {
+            invalidSnapshot(fileName, "checksum mismatch");
+        }
+    }
+
+    checkNames(fileName, data, size, header.meshes, "mesh names");
+    checkNames(fileName, data, size, header.materials, "material names");
+    checkArray(fileName, data, size, header.parents, "parents", header.entityCount);
+    checkArray(fileName, data, size, header.localTransforms, "local transforms", header.entityCount);
+    checkArray(fileName, data, size, header.meshIndices, "mesh indices", header.entityCount);
+    checkArray(fileName, data, size, header.materialIndices, "material indices", header.entityCount);
+    checkArray(fileName, data, size, header.instanceTransforms, "instance transforms", header.instanceCount);
+    checkArray(fileName, data, size, header.instanceEntities, "instance entities", header.instanceCount);
+    checkArray(fileName, data, size, header.drawRanges, "draw ranges");
+
+    for (uint32_t i = 0; i < header.entityCount; ++i) {
+        auto parent = header.parents[i];
+        if (parent != SCENE_NO_INDEX && parent >= i) {
+            invalidSnapshot(fileName, std::format("entity {} has parent {} which does not precede it", i, parent));
+        }
+    }
+    checkIndices(fileName, header.meshIndices, header.meshes.size(), true, "mesh indices");
+    checkIndices(fileName, header.materialIndices, header.materials.size(), true, "material indices");
+    checkIndices(fileName, header.instanceEntities, header.entityCount, false, "instance entities");
+
+    for (const auto &range: header.drawRanges) {
+        if (range.mesh >= header.meshes.size() ||
+            (range.material >= header.materials.size() && range.material != SCENE_NO_INDEX) ||
+            static_cast<uint64_t>(range.firstInstance) + range.instanceCount > header.instanceCount) {
+            invalidSnapshot(fileName, std::format("invalid draw range of {} instances at {}", range.instanceCount,
+                                                  range.firstInstance));
+        }
+    }
+}
+
+void SceneSnapshot::open(const std::string &fileName, bool verifyChecksum) {
+    close();
+
+    file.open(fileName);
+    try {
+        validateSnapshot(fileName, file.data(), file.size(), verifyChecksum);
+    } catch (...) {
+        file.close();
+        throw;
+    }
+
+    header = reinterpret_cast<const SceneSnapshotHeader *>(file.data());
+}
+
+void SceneSnapshot::close() {
+    header = nullptr;
+    file.close();
+}
+
+std::string_view SceneSnapshot::getMeshName(uint32_t mesh) const {
+    const auto &name = header->meshes[mesh];
+    return {name.data(), name.size()};
+}
+
+std::string_view SceneSnapshot::getMaterialName(uint32_t material) const {
+    const auto &name = header->materials[material];
+    return {name.data(), name.size()};
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "scene.h"
+#include "core/mapped_file.h"
+
+constexpr uint32_t SCENE_SNAPSHOT_MAGIC = 0x4e435344; // "DSCN"
+// Bumped whenever the layout changes, snapshots of other versions are rejected and have to be cooked again
+constexpr uint32_t SCENE_SNAPSHOT_VERSION = 1;
+// Alignment of every array in the file, enough for aligned vector loads of the transforms
+constexpr size_t SCENE_SNAPSHOT_ALIGNMENT = 16;
+
+// Array stored somewhere else in the snapshot. The offset is relative to the position of the array itself, so the
+// snapshot contains no pointers and can be used in place wherever it is mapped.
+template<typename T>
+struct SnapshotArray {
+    int64_t offset;
+    uint64_t count;
+
+    const T *data() const {
+        return reinterpret_cast<const T *>(reinterpret_cast<const uint8_t *>(this) + offset);
+    }
+
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    const T *begin() const { return data(); }
+
+    const T *end() const { return data() + count; }
+
+    const T &operator[](size_t index) const { return data()[index]; }
+};
+
+typedef SnapshotArray<char> SnapshotString;
+
+// Little endian, followed by the arrays it points at
+typedef struct SceneSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    // Over everything after the header
+    uint64_t checksum;
+    uint32_t entityCount;
+    uint32_t instanceCount;
+
+    SnapshotArray<SnapshotString> meshes;
+    SnapshotArray<SnapshotString> materials;
+
+    // Per entity, parents precede their children
+    SnapshotArray<uint32_t> parents;
+    SnapshotArray<SceneTransform> localTransforms;
+    SnapshotArray<uint32_t> meshIndices;
+    SnapshotArray<uint32_t> materialIndices;
+
+    // Per instance, grouped by draw range. The transforms have the layout of the renderer's ObjectData.
+    SnapshotArray<glm::mat4> instanceTransforms;
+    SnapshotArray<uint32_t> instanceEntities;
+
+    SnapshotArray<SceneDrawRange> drawRanges;
+} SceneSnapshotHeader;
+
+// Writes the cooked scene as a snapshot, the cache of runtime scene building
+void writeSceneSnapshot(const std::string &fileName, const CookedScene &scene);
+
+// Scene snapshot mapped into memory. Opening checks the header, the bounds of every array and every index, so the
+// arrays can be used without further checks, and optionally the checksum, which has to read the whole file. Without
+// it only the pages of the index arrays are read, the transforms are read when they are first used.
+class SceneSnapshot {
+public:
+    SceneSnapshot() = default;
+
+    void open(const std::string &fileName, bool verifyChecksum = true);
+
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+
+    const SceneSnapshotHeader &getHeader() const { return *header; }
+
+    uint32_t getEntityCount() const { return header->entityCount; }
+
+    uint32_t getInstanceCount() const { return header->instanceCount; }
+
+    std::string_view getMeshName(uint32_t mesh) const;
+
+    std::string_view getMaterialName(uint32_t material) const;
+
+    const SnapshotArray<glm::mat4> &getInstanceTransforms() const { return header->instanceTransforms; }
+
+    const SnapshotArray<SceneDrawRange> &getDrawRanges() const { return header->drawRanges; }
+
+    size_t getFileSize() const { return file.size(); }
+
+private:
+    MappedFile file;
+    const SceneSnapshotHeader *header = nullptr;
+};
@@ -1,6 +1,106 @@
 #include <application.h>
+#include <renderer/immediate_benchmark.h>
+#include <scene/scene_benchmark.h>
+#include <scene/scene_snapshot.h>
+#include <cstring>
+#include <string>
+
+static constexpr uint64_t BENCHMARK_FRAME_COUNT = 600;
+static constexpr uint32_t BENCHMARK_EMITTER_COUNT = 16;
+
+// Fills the particle buffer from a grid of emitters whose combined rate keeps it saturated
+static void runParticleBenchmark(uint32_t particleCount) {
+    ApplicationConfig config{};
+    config.renderer.headless = true;
+    config.renderer.particles.capacity = particleCount;
+    config.renderer.particles.gravity = glm::vec3(0.0f, 0.5f, 0.0f);
+    config.frameLimit = BENCHMARK_FRAME_COUNT;
+    config.fixedDeltaSeconds = 1.0f / 60.0f;
+
+    Application application("Dark Star Particle Benchmark", config);
+
+    float lifetime = 2.0f;
+    for (uint32_t i = 0; i < BENCHMARK_EMITTER_COUNT; ++i) {
+        float x = static_cast<float>(i % 4) / 2.0f - 0.75f;
+        float y = static_cast<float>(i / 4) / 2.0f - 0.75f;
+        application.getRenderer().getParticleSystem().addEmitter({
+                .position = glm::vec3(x, y, 0.5f),
+                .positionSpread = 0.05f,
+                .velocity = glm::vec3(0.0f, -0.3f, 0.0f),
+                .velocitySpread = 0.2f,
+                .colorStart = glm::vec4(1.0f, 0.8f, 0.3f, 1.0f),
+                .colorEnd = glm::vec4(0.8f, 0.1f, 0.0f, 0.0f),
+                .lifetime = lifetime,
+                .lifetimeSpread = 0.5f,
+                .size = 0.005f,
+                .rate = static_cast<float>(particleCount) / (lifetime * BENCHMARK_EMITTER_COUNT),
+        });
+    }
+
+    application.start();
+}
+
+// Captures every headless frame, the frame capture report next to the frame rate shows whether encoding keeps up
+static void runCaptureBenchmark(uint64_t frameCount, CaptureFormat format) {
+    ApplicationConfig config{};
+    config.renderer.headless = true;
+    config.renderer.capture.directory = "capture";
+    config.renderer.capture.format = format;
+    config.frameLimit = frameCount;
+
+    Application application("Dark Star Capture Benchmark", config);
+    application.start();
+}
+
+int main(int argc, char **argv) {
+    // dark_star_testbed --benchmark immediate [primitive count]
+    if (argc >= 3 && strcmp(argv[1], "--benchmark") == 0 && strcmp(argv[2], "immediate") == 0) {
+        runImmediateBenchmark(argc >= 4 ? std::stoul(argv[3]) : 100000);
+        return 0;
+    }
+
+    // dark_star_testbed --benchmark particles [particle count]
+    if (argc >= 3 && strcmp(argv[1], "--benchmark") == 0 && strcmp(argv[2], "particles") == 0) {
+        runParticleBenchmark(argc >= 4 ? std::stoul(argv[3]) : 1024 * 1024);
+        return 0;
+    }
+
+    // dark_star_testbed --benchmark capture [frame count] [png|raw]
+    if (argc >= 3 && strcmp(argv[1], "--benchmark") == 0 && strcmp(argv[2], "capture") == 0) {
+        bool raw = argc >= 5 && strcmp(argv[4], "raw") == 0;
+        runCaptureBenchmark(argc >= 4 ? std::stoull(argv[3]) : BENCHMARK_FRAME_COUNT,
+                            raw ? CAPTURE_FORMAT_RAW : CAPTURE_FORMAT_PNG);
+        return 0;
+    }
+
+    // dark_star_testbed --benchmark scene [entity count]
+    if (argc >= 3 && strcmp(argv[1], "--benchmark") == 0 && strcmp(argv[2], "scene") == 0) {
+        runSceneBenchmark(argc >= 4 ? std::stoul(argv[3]) : 1000000);
+        return 0;
+    }
+
+    // dark_star_testbed --scene <snapshot file>
+    if (argc >= 3 && strcmp(argv[1], "--scene") == 0) {
+        SceneSnapshot snapshot;
+        snapshot.open(argv[2]);
+
+        Application application("Dark Star Engine");
+        application.getRenderer().setScene(&snapshot);
+        application.start();
+        return 0;
+    }
+
+    // dark_star_testbed --headless [frame count]
+    if (argc >= 2 && strcmp(argv[1], "--headless") == 0) {
+        ApplicationConfig config{};
+        config.renderer.headless = true;
+        config.frameLimit = argc >= 3 ? std::stoull(argv[2]) : BENCHMARK_FRAME_COUNT;
+
+        Application application("Dark Star Engine", config);
+        application.start();
+        return 0;
+    }
 
-int main() {
     Application application("Dark Star Engine");
     application.start();
     return 0;